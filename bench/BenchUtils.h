@@ -0,0 +1,46 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "CpuSet.h"
+#include "ProbeUtils.h"
+
+
+/* Best wall time of repeats runs of f in milliseconds. */
+template <typename F>
+double measureMs(F&& f, int repeats = 5) {
+    auto best = std::numeric_limits<double>::max();
+    for (auto i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+
+/* Keep the optimizer from dropping a computed value. */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(_MSC_VER)
+    static volatile const T* sink;
+    sink = &value;
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+
+/* Run work(t) on one thread per plan entry, pinned to it, after setup(t) finished on every thread.
+   Returns the wall time of the work phase in ms. */
+inline double runPlan(const std::vector<CpuSet>& plan, const std::function<void(size_t)>& setup, const std::function<void(size_t)>& work) {
+    return runPinned(plan, setup, work) * 1e3;
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "BenchUtils.h"
+#include "Channel.h"
+#include "CohortLock.h"
+
+
+using CoreInfo = CpuTopology::TopologyInfo::CoreInfo;
+
+
+static uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+
+// Producer streams messages to the consumer through an SpscRing, returns million messages per second.
+double throughput(ChannelMesh<uint64_t>& mesh, uint64_t messages) {
+    double ms = runPlan({ mesh.cpuSet(0), mesh.cpuSet(1) },
+        [](size_t) {},
+        [&](size_t t) {
+            uint32_t spins = 0;
+            if (t == 0) {
+                auto& ring = mesh.channel(0, 1);
+                for (uint64_t i = 0; i < messages;) {
+                    if (ring.tryPush(i)) {
+                        ++i;
+                    }
+                    else {
+                        spinWait(spins);
+                    }
+                }
+                ring.flush();
+            }
+            else {
+                auto& ring = mesh.channel(0, 1);
+                uint64_t sum = 0;
+                uint64_t value = 0;
+                for (uint64_t received = 0; received < messages;) {
+                    if (ring.tryPop(value)) {
+                        sum += value;
+                        ++received;
+                    }
+                    else {
+                        spinWait(spins);
+                    }
+                }
+                doNotOptimize(sum);
+            }
+        });
+    return static_cast<double>(messages) / ms / 1e3;
+}
+
+
+// Ping-pong through the two SpscRings of the pair, returns the 99th percentile one-way latency in ns.
+double latencyP99(ChannelMesh<uint64_t>& mesh, uint32_t rounds) {
+    std::vector<uint64_t> oneWay(rounds);
+    runPlan({ mesh.cpuSet(0), mesh.cpuSet(1) },
+        [](size_t) {},
+        [&](size_t t) {
+            auto& out = t == 0 ? mesh.channel(0, 1) : mesh.channel(1, 0);
+            auto& in = t == 0 ? mesh.channel(1, 0) : mesh.channel(0, 1);
+            uint64_t value = 0;
+            for (uint32_t round = 0; round < rounds; ++round) {
+                uint32_t spins = 0;
+                if (t == 0) {
+                    auto start = nowNs();
+                    while (!out.tryPush(start)) {
+                        spinWait(spins);
+                    }
+                    out.flush();
+                    while (!in.tryPop(value)) {
+                        spinWait(spins);
+                    }
+                    oneWay[round] = (nowNs() - start) / 2;
+                }
+                else {
+                    while (!in.tryPop(value)) {
+                        spinWait(spins);
+                    }
+                    while (!out.tryPush(value)) {
+                        spinWait(spins);
+                    }
+                    out.flush();
+                }
+            }
+        });
+    std::sort(oneWay.begin(), oneWay.end());
+    return static_cast<double>(oneWay[oneWay.size() * 99 / 100]);
+}
+
+
+int main(int argc, char* argv[]) {
+    const uint64_t messages = argc > 1 ? std::stoull(argv[1]) : uint64_t(1) << 24;
+    const uint32_t rounds = 100000;
+    decltype(auto) cpu = CpuTopology::process();
+    const auto& cores = cpu.Topology.cores;
+
+    // First pair of cores of each relation, nullptr if the machine has none.
+    std::pair<const CoreInfo*, const CoreInfo*> sameComplex{ nullptr, nullptr };
+    std::pair<const CoreInfo*, const CoreInfo*> crossComplex{ nullptr, nullptr };
+    std::pair<const CoreInfo*, const CoreInfo*> crossSocket{ nullptr, nullptr };
+    for (size_t i = 0; i < cores.size(); ++i) {
+        for (size_t j = i + 1; j < cores.size(); ++j) {
+            const auto& a = cores[i];
+            const auto& b = cores[j];
+            auto& pair = a.socket != b.socket ? crossSocket : a.complexGroup == b.complexGroup ? sameComplex : crossComplex;
+            if (!pair.first) {
+                pair = { &a, &b };
+            }
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(1)
+        << std::setw(16) << "SPSC pair" << std::setw(14) << "Mmsg/s" << std::setw(14) << "p99 ns" << std::endl;
+    for (const auto& row : { std::make_pair("same complex", sameComplex), std::make_pair("cross complex", crossComplex),
+        std::make_pair("cross socket", crossSocket) }) {
+        std::cout << std::setw(16) << row.first;
+        if (!row.second.first) {
+            std::cout << std::setw(14) << "-" << std::setw(14) << "-" << std::endl;
+            continue;
+        }
+        ChannelMesh<uint64_t> mesh({ row.second.first, row.second.second });
+        std::cout << std::setw(14) << throughput(mesh, messages);
+        ChannelMesh<uint64_t> latencyMesh({ row.second.first, row.second.second });
+        std::cout << std::setw(14) << latencyP99(latencyMesh, rounds) << std::endl;
+    }
+    return 0;
+}
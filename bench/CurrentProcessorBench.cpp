@@ -0,0 +1,68 @@
+#include <iomanip>
+#include <iostream>
+
+#include "BenchUtils.h"
+#include "CpuTopology.h"
+#include "CpuidTopology.h"
+
+
+// Ask for the current processor calls times through query.
+uint64_t queryLoop(ProcessorQuery query, size_t calls) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < calls; ++i) {
+        sum += currentProcessor(query);
+    }
+    return sum;
+}
+
+
+// Current processor to core, complex group, NUMA node and socket, the lookup a sharded structure does per operation.
+uint64_t locateLoop(const CpuTopology& cpu, size_t calls) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < calls; ++i) {
+        auto location = cpu.FlatTopology.current();
+        if (location) {
+            sum += location->core + location->complexGroup + location->numaNode + location->socket;
+        }
+    }
+    return sum;
+}
+
+
+uint64_t apicIdLoop(size_t calls) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < calls; ++i) {
+        sum += CpuidTopology::currentApicId();
+    }
+    return sum;
+}
+
+
+int main(int argc, char* argv[]) {
+    size_t calls = argc > 1 ? std::stoul(argv[1]) : size_t(1) << 22;
+    decltype(auto) cpu = CpuTopology::process();
+
+    auto nsPerCall = [&](double ms, size_t count) { return ms * 1e6 / static_cast<double>(count); };
+
+    std::cout << std::fixed << std::setprecision(1)
+        << "Current processor, ns per call (fastest: " << processorQueryName(fastestProcessorQuery()) << ")" << std::endl;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(ProcessorQuery::count); ++i) {
+        auto query = static_cast<ProcessorQuery>(i);
+        std::cout << "    " << std::left << std::setw(16) << processorQueryName(query) << std::right;
+        if (!processorQueryAvailable(query)) {
+            std::cout << std::setw(8) << "-" << std::endl;
+            continue;
+        }
+        auto ms = measureMs([&]() { doNotOptimize(queryLoop(query, calls)); });
+        std::cout << std::setw(8) << nsPerCall(ms, calls) << std::endl;
+    }
+
+    auto locateMs = measureMs([&]() { doNotOptimize(locateLoop(cpu, calls)); });
+    std::cout << "    " << std::left << std::setw(16) << "location" << std::right << std::setw(8) << nsPerCall(locateMs, calls) << std::endl;
+
+    // cpuid is serializing and exits to the hypervisor in a VM, fewer calls keep the run short.
+    auto apicCalls = calls / 64 + 1;
+    auto apicMs = measureMs([&]() { doNotOptimize(apicIdLoop(apicCalls)); });
+    std::cout << "    " << std::left << std::setw(16) << "cpuid apic id" << std::right << std::setw(8) << nsPerCall(apicMs, apicCalls) << std::endl;
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "BenchUtils.h"
+#include "CpuTopology.h"
+
+
+// Live and peak heap bytes, counted by the operator new replacements below.
+static std::atomic<size_t> liveBytes{ 0 };
+static std::atomic<size_t> peakBytes{ 0 };
+
+
+// Every block starts with its size and the distance to the malloc'ed address.
+static void* countedAllocate(size_t size, size_t alignment) {
+    constexpr size_t header = 2 * sizeof(size_t);
+    alignment = std::max(alignment, header);
+    auto raw = static_cast<char*>(std::malloc(size + alignment + header));
+    if (!raw) {
+        throw std::bad_alloc();
+    }
+    auto p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(raw) + header + alignment - 1) & ~(uintptr_t(alignment) - 1));
+    reinterpret_cast<size_t*>(p)[-2] = size;
+    reinterpret_cast<size_t*>(p)[-1] = static_cast<size_t>(p - raw);
+
+    auto live = liveBytes.fetch_add(size) + size;
+    auto peak = peakBytes.load();
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live)) {
+    }
+    return p;
+}
+
+
+static void countedRelease(void* p) {
+    if (p) {
+        auto block = static_cast<char*>(p);
+        liveBytes.fetch_sub(reinterpret_cast<size_t*>(block)[-2]);
+        std::free(block - reinterpret_cast<size_t*>(block)[-1]);
+    }
+}
+
+
+void* operator new(size_t size) { return countedAllocate(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size) { return countedAllocate(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t alignment) { return countedAllocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedAllocate(size, static_cast<size_t>(alignment)); }
+void operator delete(void* p) noexcept { countedRelease(p); }
+void operator delete[](void* p) noexcept { countedRelease(p); }
+void operator delete(void* p, size_t) noexcept { countedRelease(p); }
+void operator delete[](void* p, size_t) noexcept { countedRelease(p); }
+void operator delete(void* p, std::align_val_t) noexcept { countedRelease(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { countedRelease(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { countedRelease(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { countedRelease(p); }
+
+
+// Construction time, peak heap during construction and heap retained by the result. Returns the time in ms.
+template <typename F>
+double report(const std::string& label, F&& construct) {
+    uint32_t processors = 0;
+    auto ms = measureMs([&]() {
+        auto cpu = construct();
+        processors = cpu->logicalProcessors;
+        doNotOptimize(cpu);
+    });
+
+    auto before = liveBytes.load();
+    peakBytes.store(before);
+    auto cpu = construct();
+    auto retained = liveBytes.load() - before;
+    auto peak = peakBytes.load() - before;
+
+    std::cout << std::setw(24) << std::left << label << std::right
+        << std::setw(6) << processors
+        << std::setw(10) << std::fixed << std::setprecision(3) << ms
+        << std::setw(10) << std::setprecision(0) << ms * 1e6 / std::max(processors, 1u)
+        << std::setw(10) << peak / 1024
+        << std::setw(10) << retained / 1024
+        << std::setw(8) << retained / std::max(processors, 1u) << std::endl;
+    return ms;
+}
+
+
+// Discovery of a captured tree should stay below this on a 256 logical processor host.
+constexpr double discoveryTargetMs = 1.0;
+
+
+// Discovery and consolidation cost as the topology grows, the ns/CPU and B/CPU columns stay flat when both scale linearly.
+// On Linux every argument is also timed as a captured sysfs tree, see CpuTopology(const std::string&),
+// the exit code is 1 if one took longer than discoveryTargetMs.
+int main(int argc, char* argv[]) {
+    const CpuTopology::SyntheticLayout layouts[] = {
+        // sockets, NUMA nodes, complex groups, cores, threads
+        { 1, 1, 1, 8, 2 },
+        { 1, 1, 2, 8, 2 },
+        { 1, 2, 2, 8, 2 },
+        { 1, 2, 4, 8, 2 },
+        { 2, 2, 4, 8, 2 },
+        { 2, 4, 4, 8, 2 },
+        { 4, 4, 4, 8, 2 },
+        { 8, 4, 4, 8, 2 },
+        { 8, 4, 8, 8, 1 },
+        { 4, 2, 4, 16, 4 },
+    };
+
+    std::cout << std::setw(24) << std::left << "Layout" << std::right
+        << std::setw(6) << "CPUs"
+        << std::setw(10) << "ms"
+        << std::setw(10) << "ns/CPU"
+        << std::setw(10) << "peak KB"
+        << std::setw(10) << "kept KB"
+        << std::setw(8) << "B/CPU" << std::endl;
+
+    for (const auto& layout : layouts) {
+        report(CpuTopology(layout).name, [&]() { return std::make_unique<CpuTopology>(layout); });
+    }
+
+    int result = 0;
+#if defined(__linux__)
+    for (int i = 1; i < argc; ++i) {
+        std::string root = argv[i];
+        auto ms = report(root, [&]() { return std::make_unique<CpuTopology>(root); });
+        if (ms > discoveryTargetMs) {
+            std::cout << root << ": over the " << discoveryTargetMs << " ms discovery target" << std::endl;
+            result = 1;
+        }
+    }
+#else
+    (void)argc;
+    (void)argv;
+#endif
+    return result;
+}
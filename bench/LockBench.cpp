@@ -0,0 +1,132 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "BenchUtils.h"
+#include "CohortLock.h"
+#include "Placement.h"
+
+
+// FIFO spinlock on two counters, every waiter spins on the same cache line.
+class TicketLock {
+public:
+    void lock() {
+        auto ticket = next.fetch_add(1, std::memory_order_relaxed);
+        uint32_t spins = 0;
+        while (serving.load(std::memory_order_acquire) != ticket) {
+            spinWait(spins);
+        }
+    }
+
+    void unlock() {
+        serving.store(serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    alignas(64) std::atomic<uint32_t> next{ 0 };
+    alignas(64) std::atomic<uint32_t> serving{ 0 };
+};
+
+
+// Every lock behind one interface: run f while holding it.
+struct MutexRunner {
+    std::mutex lock;
+    template <typename F>
+    void run(F&& f) {
+        std::lock_guard<std::mutex> guard(lock);
+        f();
+    }
+};
+
+struct TicketRunner {
+    TicketLock lock;
+    template <typename F>
+    void run(F&& f) {
+        std::lock_guard<TicketLock> guard(lock);
+        f();
+    }
+};
+
+struct McsRunner {
+    McsLock lock;
+    template <typename F>
+    void run(F&& f) {
+        McsNode node;
+        lock.lock(node);
+        f();
+        lock.unlock(node);
+    }
+};
+
+struct CohortRunner {
+    CohortLock lock;
+    template <typename F>
+    void run(F&& f) {
+        CohortLock::Guard guard(lock);
+        f();
+    }
+};
+
+
+// Shared data the critical section updates, a few cache lines that follow the lock around.
+struct alignas(64) SharedData {
+    uint64_t lines[4][8] = {};
+};
+
+
+// Million critical sections per second with threads placed by plan.
+template <typename Runner>
+double throughput(const std::vector<CpuSet>& plan, uint32_t iterations) {
+    Runner runner;
+    SharedData shared;
+    auto ms = runPlan(plan,
+        [](size_t) {},
+        [&](size_t t) {
+            uint64_t x = t + 1;
+            for (uint32_t i = 0; i < iterations; ++i) {
+                runner.run([&]() {
+                    for (auto& line : shared.lines) {
+                        ++line[0];
+                    }
+                });
+                // Some work outside the lock so waiters arrive in bursts, not in lockstep.
+                for (int j = 0; j < 32; ++j) {
+                    x ^= x << 13;
+                    x ^= x >> 7;
+                    x ^= x << 17;
+                }
+                doNotOptimize(x);
+            }
+        });
+    doNotOptimize(shared);
+    return static_cast<double>(iterations) * plan.size() / ms / 1e3;
+}
+
+
+int main(int argc, char* argv[]) {
+    decltype(auto) cpu = CpuTopology::process();
+    uint32_t maxThreads = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : cpu.effectiveParallelism();
+    uint32_t iterations = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 200000;
+
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(std::max(maxThreads, 1u));
+
+    std::cout << "Spread placement over " << cpu.complexGroups << " complex groups and " << cpu.numaNodes
+        << " NUMA nodes, " << iterations << " critical sections per thread, Mops/s" << std::endl
+        << std::setw(8) << "Threads" << std::setw(12) << "std::mutex" << std::setw(12) << "Ticket"
+        << std::setw(12) << "MCS" << std::setw(12) << "Cohort" << std::endl;
+    for (auto threads : threadCounts) {
+        auto plan = planPlacement(threads, PlacementPolicy::spread, cpu);
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(2)
+            << std::setw(12) << throughput<MutexRunner>(plan, iterations)
+            << std::setw(12) << throughput<TicketRunner>(plan, iterations)
+            << std::setw(12) << throughput<McsRunner>(plan, iterations)
+            << std::setw(12) << throughput<CohortRunner>(plan, iterations) << std::endl;
+    }
+    return 0;
+}
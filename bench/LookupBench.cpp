@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+#include "BenchUtils.h"
+#include "CpuTopology.h"
+
+
+// Resolve a logical processor the way callers had to before FlatTopology:
+// find its core in Topology.cores, then follow the pointers.
+uint64_t walkPointerGraph(const CpuTopology& cpu, const std::vector<uint32_t>& queries) {
+    uint64_t sum = 0;
+    for (auto processor : queries) {
+        for (const auto& core : cpu.Topology.cores) {
+            if (std::find(core.sysLogicalProcessors.cbegin(), core.sysLogicalProcessors.cend(), processor) != core.sysLogicalProcessors.cend()) {
+                sum += core.id + core.complexGroup->id + core.numaNode->id + core.socket->id + core.caches.front().size;
+                break;
+            }
+        }
+    }
+    return sum;
+}
+
+
+uint64_t lookupFlat(const CpuTopology& cpu, const std::vector<uint32_t>& queries) {
+    uint64_t sum = 0;
+    for (auto processor : queries) {
+        auto location = cpu.FlatTopology.locate(0, processor);
+        sum += location->core + location->complexGroup + location->numaNode + location->socket +
+            cpu.FlatTopology.caches(location->core)->size;
+    }
+    return sum;
+}
+
+
+int main(int /*argc*/, char* /*argv*/[]) {
+    decltype(auto) cpu = CpuTopology::get();
+
+    std::vector<uint32_t> processors;
+    for (const auto& core : cpu.Topology.cores) {
+        processors.insert(processors.end(), core.sysLogicalProcessors.cbegin(), core.sysLogicalProcessors.cend());
+    }
+
+    constexpr size_t lookups = 1 << 20;
+    std::mt19937 random(42);
+    std::uniform_int_distribution<size_t> pick(0, processors.size() - 1);
+    std::vector<uint32_t> queries(lookups);
+    for (auto& query : queries) {
+        query = processors[pick(random)];
+    }
+
+    auto graphMs = measureMs([&]() { doNotOptimize(walkPointerGraph(cpu, queries)); });
+    auto flatMs = measureMs([&]() { doNotOptimize(lookupFlat(cpu, queries)); });
+
+    std::cout << "Logical processors: " << processors.size() << std::endl
+        << "Processor -> core/complex/NUMA/socket/cache lookup" << std::endl
+        << "    Pointer graph: " << graphMs * 1e6 / lookups << " ns" << std::endl
+        << "    Flat topology: " << flatMs * 1e6 / lookups << " ns" << std::endl;
+    return 0;
+}
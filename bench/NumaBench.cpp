@@ -0,0 +1,68 @@
+#include <iostream>
+#include <thread>
+
+#include "BenchUtils.h"
+#include "NumaAllocator.h"
+
+
+using NumaVector = std::vector<double, NumaAllocator<double>>;
+
+
+// STREAM triad from threads pinned to the cores of one NUMA node, returns GB/s.
+double triad(const CpuTopology::TopologyInfo::NumaNodeInfo& runOn, NumaArena& arena, size_t count) {
+    NumaAllocator<double> allocator(arena);
+    NumaVector a(count, 0.0, allocator);
+    NumaVector b(count, 1.0, allocator);
+    NumaVector c(count, 2.0, allocator);
+
+    auto ms = measureMs([&]() {
+        std::vector<std::thread> threads;
+        auto workers = runOn.cores.size();
+        for (size_t t = 0; t < workers; ++t) {
+            threads.emplace_back([&, t]() {
+                bindCurrentThread(runOn.cores[t]->cpuSet);
+                auto begin = count * t / workers;
+                auto end = count * (t + 1) / workers;
+                for (auto i = begin; i < end; ++i) {
+                    a[i] = b[i] + 3.0 * c[i];
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    });
+    doNotOptimize(a[count / 2]);
+    return 3.0 * sizeof(double) * count / ms / 1e6;
+}
+
+
+int main(int /*argc*/, char* /*argv*/[]) {
+    decltype(auto) cpu = CpuTopology::get();
+    if (cpu.Topology.numaNodes.empty()) {
+        std::cout << "No NUMA node found." << std::endl;
+        return 0;
+    }
+
+    constexpr size_t count = size_t(8) << 20;
+    const auto& local = cpu.Topology.numaNodes.front();
+    auto remote = static_cast<uint32_t>(cpu.Topology.numaNodes.size() - 1);
+
+    std::cout << "NUMA nodes: " << cpu.Topology.numaNodes.size() << std::endl
+        << "Triad from the cores of NUMA " << local.id << ", " << 3 * sizeof(double) * count / 1024 / 1024 << " MB" << std::endl;
+    if (remote == local.id) {
+        std::cout << "    Single NUMA node, remote and interleaved equal local." << std::endl;
+    }
+
+    auto& localArena = NumaArena::node(local.id);
+    auto& remoteArena = NumaArena::node(remote);
+    auto& interleavedArena = NumaArena::interleaved();
+    std::cout << "    Local: " << triad(local, localArena, count) << " GB/s" << std::endl
+        << "    Interleaved: " << triad(local, interleavedArena, count) << " GB/s" << std::endl
+        << "    Remote (NUMA " << remote << "): " << triad(local, remoteArena, count) << " GB/s" << std::endl;
+
+    if (!localArena.bound() || !remoteArena.bound() || !interleavedArena.bound()) {
+        std::cout << "    The system refused NUMA binding, memory follows first-touch." << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "BenchUtils.h"
+#include "ParallelFor.h"
+
+
+// Baseline: equal chunks over fresh unpinned threads, chunk i to thread i, the way a plain std::thread split does it.
+template <typename F>
+void naiveFor(size_t threads, size_t begin, size_t end, F&& body) {
+    std::vector<std::thread> workers;
+    const auto length = end - begin;
+    for (size_t t = 0; t < threads; ++t) {
+        auto first = begin + length * t / threads;
+        auto last = begin + length * (t + 1) / threads;
+        workers.emplace_back([&body, first, last]() { body(first, last); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    const size_t count = argc > 1 ? std::stoul(argv[1]) : size_t(1) << 24;
+    ThreadPool pool;
+    const auto threads = pool.size();
+
+    auto triad = [](double* a, const double* b, const double* c) {
+        return [=](size_t first, size_t last) {
+            for (auto i = first; i < last; ++i) {
+                a[i] = b[i] + 3.0 * c[i];
+            }
+        };
+    };
+    auto sum = [](const double* a) {
+        return [=](size_t first, size_t last) {
+            double result = 0.0;
+            for (auto i = first; i < last; ++i) {
+                result += a[i];
+            }
+            return result;
+        };
+    };
+    auto gbPerSecond = [&](double ms, size_t arrays) { return static_cast<double>(arrays * count * sizeof(double)) / ms / 1e6; };
+
+    // Naive: the main thread touches every page first, so they all land on its NUMA node.
+    double naiveTriad = 0.0;
+    double naiveSum = 0.0;
+    {
+        std::vector<double> a(count, 0.0);
+        std::vector<double> b(count, 1.0);
+        std::vector<double> c(count, 2.0);
+        naiveTriad = measureMs([&]() { naiveFor(threads, 0, count, triad(a.data(), b.data(), c.data())); });
+        std::vector<double> partials(threads);
+        naiveSum = measureMs([&]() {
+            naiveFor(threads, 0, threads, [&](size_t first, size_t last) {
+                for (auto t = first; t < last; ++t) {
+                    partials[t] = sum(a.data())(count * t / threads, count * (t + 1) / threads);
+                }
+            });
+            double total = 0.0;
+            for (auto partial : partials) {
+                total += partial;
+            }
+            doNotOptimize(total);
+        });
+    }
+
+    // Topology: pages are first touched by the worker which owns them in every later call.
+    double topologyTriad = 0.0;
+    double topologySum = 0.0;
+    {
+        std::unique_ptr<double[]> a(new double[count]);
+        std::unique_ptr<double[]> b(new double[count]);
+        std::unique_ptr<double[]> c(new double[count]);
+        parallelFor(pool, 0, count, [&](size_t first, size_t last) {
+            for (auto i = first; i < last; ++i) {
+                a[i] = 0.0;
+                b[i] = 1.0;
+                c[i] = 2.0;
+            }
+        });
+        topologyTriad = measureMs([&]() { parallelFor(pool, 0, count, triad(a.get(), b.get(), c.get())); });
+        topologySum = measureMs([&]() {
+            doNotOptimize(parallelReduce(pool, 0, count, 0.0, sum(a.get()), [](double x, double y) { return x + y; }));
+        });
+    }
+
+    std::cout << std::fixed << std::setprecision(2)
+        << "Threads: " << threads << ", elements: " << count << std::endl
+        << std::setw(12) << "" << std::setw(14) << "Triad GB/s" << std::setw(14) << "Sum GB/s" << std::endl
+        << std::setw(12) << "naive" << std::setw(14) << gbPerSecond(naiveTriad, 3) << std::setw(14) << gbPerSecond(naiveSum, 1) << std::endl
+        << std::setw(12) << "topology" << std::setw(14) << gbPerSecond(topologyTriad, 3) << std::setw(14) << gbPerSecond(topologySum, 1) << std::endl;
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "BenchUtils.h"
+#include "Placement.h"
+
+
+// Every thread streams its own first-touched buffer, returns the aggregate GB/s.
+double memoryBound(const std::vector<CpuSet>& plan, size_t bytesPerThread) {
+    constexpr int passes = 4;
+    const auto count = bytesPerThread / sizeof(double);
+    std::vector<std::vector<double>> buffers(plan.size());
+    std::vector<double> sums(plan.size());
+    auto ms = runPlan(plan,
+        [&](size_t t) { buffers[t].assign(count, 1.0); },
+        [&](size_t t) {
+            double sum = 0.0;
+            for (int pass = 0; pass < passes; ++pass) {
+                for (auto value : buffers[t]) {
+                    sum += value;
+                }
+            }
+            sums[t] = sum;
+        });
+    doNotOptimize(sums);
+    return static_cast<double>(passes) * bytesPerThread * plan.size() / ms / 1e6;
+}
+
+
+// Threads look up a shared table sized to fit one L3 and hand off through a shared counter,
+// returns the aggregate million lookups per second.
+double cacheSharing(const std::vector<CpuSet>& plan, size_t tableBytes) {
+    constexpr size_t lookups = size_t(1) << 22;
+    std::vector<uint64_t> table(tableBytes / sizeof(uint64_t));
+    for (size_t i = 0; i < table.size(); ++i) {
+        table[i] = i * 0x9E3779B97F4A7C15ull;
+    }
+    alignas(64) std::atomic<uint64_t> shared{ 0 };
+    std::vector<uint64_t> sums(plan.size());
+    auto ms = runPlan(plan,
+        [](size_t) {},
+        [&](size_t t) {
+            uint64_t x = t + 1;
+            uint64_t sum = 0;
+            for (size_t i = 0; i < lookups; ++i) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                sum += table[x % table.size()];
+                if ((i & 255) == 0) {
+                    shared.fetch_add(sum, std::memory_order_relaxed);
+                }
+            }
+            sums[t] = sum;
+        });
+    doNotOptimize(sums);
+    return static_cast<double>(lookups) * plan.size() / ms / 1e3;
+}
+
+
+int main(int argc, char* argv[]) {
+    decltype(auto) cpu = CpuTopology::process();
+    uint32_t threads = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : std::max(cpu.effectiveParallelism() / 2, 2u);
+
+    // Half of the L3 of one complex group, shared by every thread.
+    size_t l3 = 8 << 20;
+    if (!cpu.Topology.cores.empty()) {
+        for (const auto& cache : cpu.Topology.cores.front().caches) {
+            if (cache.level == 3) {
+                l3 = cache.size;
+            }
+        }
+    }
+    constexpr size_t bytesPerThread = size_t(64) << 20;
+
+    std::cout << "Threads: " << threads << " on " << cpu.logicalProcessors << " logical processors" << std::endl
+        << "Memory bound: " << (bytesPerThread >> 20) << " MB per thread, cache sharing: " << (l3 >> 21) << " MB table" << std::endl
+        << std::setw(26) << std::left << "Policy" << std::right
+        << std::setw(16) << "Stream GB/s" << std::setw(16) << "Lookup M/s" << std::endl;
+
+    for (auto policy : { PlacementPolicy::compact, PlacementPolicy::spread, PlacementPolicy::onePerComplexGroup,
+        PlacementPolicy::physicalCores, PlacementPolicy::highestSchedulingClass }) {
+        auto plan = planPlacement(threads, policy, cpu);
+        std::cout << std::setw(26) << std::left << placementPolicyName(policy) << std::right << std::fixed << std::setprecision(2)
+            << std::setw(16) << memoryBound(plan, bytesPerThread)
+            << std::setw(16) << cacheSharing(plan, l3 / 2) << std::endl;
+    }
+    return 0;
+}
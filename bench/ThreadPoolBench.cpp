@@ -0,0 +1,169 @@
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+#include "BenchUtils.h"
+#include "ThreadPool.h"
+
+
+// Baseline: one shared queue guarded by one mutex, no pinning.
+class FlatThreadPool {
+public:
+    explicit FlatThreadPool(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            threads.emplace_back([this]() {
+                while (true) {
+                    std::unique_lock<std::mutex> guard(lock);
+                    ready.wait(guard, [this]() { return stop || !tasks.empty(); });
+                    if (tasks.empty()) {
+                        break;
+                    }
+                    auto task = std::move(tasks.front());
+                    tasks.pop_front();
+                    guard.unlock();
+                    task();
+                    unfinished.fetch_sub(1, std::memory_order_release);
+                }
+            });
+        }
+    }
+
+    ~FlatThreadPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stop = true;
+        }
+        ready.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void submit(std::function<void()> task) {
+        unfinished.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            tasks.push_back(std::move(task));
+        }
+        ready.notify_one();
+    }
+
+    bool runPendingTask() {
+        std::unique_lock<std::mutex> guard(lock);
+        if (tasks.empty()) {
+            return false;
+        }
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        guard.unlock();
+        task();
+        unfinished.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void wait() {
+        while (unfinished.load(std::memory_order_acquire)) {
+            if (!runPendingTask()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex lock;
+    std::condition_variable ready;
+    std::atomic<int64_t> unfinished{ 0 };
+    bool stop = false;
+};
+
+
+// Same helping fork-join group as TaskGroup, for any pool.
+template <typename Pool>
+class Group {
+public:
+    explicit Group(Pool& pool) : pool(pool) {}
+    ~Group() { wait(); }
+
+    template <typename F>
+    void run(F&& f) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        pool.submit([this, f = std::forward<F>(f)]() mutable {
+            f();
+            pending.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    void wait() {
+        while (pending.load(std::memory_order_acquire)) {
+            if (!pool.runPendingTask()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    Pool& pool;
+    std::atomic<int64_t> pending{ 0 };
+};
+
+
+// Fork-join: recursive halving sum, children of a split stay in the parent's cache.
+template <typename Pool>
+double forkJoinSum(Pool& pool, const double* data, size_t count) {
+    constexpr size_t grain = 8192;
+    if (count <= grain) {
+        return std::accumulate(data, data + count, 0.0);
+    }
+    double left = 0.0;
+    double right = 0.0;
+    {
+        Group<Pool> group(pool);
+        group.run([&]() { left = forkJoinSum(pool, data, count / 2); });
+        right = forkJoinSum(pool, data + count / 2, count - count / 2);
+    }
+    return left + right;
+}
+
+
+// Unbalanced: one task in 64 is 64 times heavier than the others.
+template <typename Pool>
+void unbalanced(Pool& pool, size_t tasks, std::vector<double>& results) {
+    for (size_t i = 0; i < tasks; ++i) {
+        pool.submit([i, &results]() {
+            auto iterations = (i % 64 == 0) ? 64 * 500 : 500;
+            double x = static_cast<double>(i);
+            for (auto k = 0; k < iterations; ++k) {
+                x = std::sqrt(x + k);
+            }
+            results[i] = x;
+        });
+    }
+    pool.wait();
+}
+
+
+int main(int /*argc*/, char* /*argv*/[]) {
+    std::vector<double> data(size_t(1) << 24, 1.0);
+    constexpr size_t unbalancedTasks = 20000;
+    std::vector<double> results(unbalancedTasks);
+
+    ThreadPool topologyPool;
+    FlatThreadPool flatPool(topologyPool.size());
+    std::cout << "Workers: " << topologyPool.size() << std::endl;
+
+    auto topologyForkJoin = measureMs([&]() { doNotOptimize(forkJoinSum(topologyPool, data.data(), data.size())); });
+    auto flatForkJoin = measureMs([&]() { doNotOptimize(forkJoinSum(flatPool, data.data(), data.size())); });
+    std::cout << "Fork-join sum" << std::endl
+        << "    Topology pool: " << topologyForkJoin << " ms" << std::endl
+        << "    Flat pool: " << flatForkJoin << " ms" << std::endl;
+
+    auto topologyUnbalanced = measureMs([&]() { unbalanced(topologyPool, unbalancedTasks, results); });
+    auto flatUnbalanced = measureMs([&]() { unbalanced(flatPool, unbalancedTasks, results); });
+    std::cout << "Unbalanced tasks" << std::endl
+        << "    Topology pool: " << topologyUnbalanced << " ms" << std::endl
+        << "    Flat pool: " << flatUnbalanced << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "BenchUtils.h"
+#include "Tiling.h"
+
+
+using CoreInfo = CpuTopology::TopologyInfo::CoreInfo;
+
+
+// The cache model hardcoded all over: a private 32 KB 8-way L1D and a private 1 MB 16-way L2, no L3.
+CoreInfo fixedCore() {
+    CoreInfo core;
+    core.caches.push_back({ CpuTopology::CacheType::data, 1, 8, 32 * 1024, 64, 1 });
+    core.caches.push_back({ CpuTopology::CacheType::unified, 2, 16, 1024 * 1024, 64, 1 });
+    return core;
+}
+
+
+double transposeGBs(const TileAdvice& advice, size_t side) {
+    std::vector<double> in(side * side, 1.0);
+    std::vector<double> out(side * side);
+    auto ms = measureMs([&]() { transposeBlocked(in.data(), out.data(), side, side, advice.l1Side); }, 3);
+    doNotOptimize(out);
+    return 2.0 * static_cast<double>(side * side * sizeof(double)) / ms / 1e6;
+}
+
+
+double gemmGflops(const TileAdvice& l1Advice, const TileAdvice& l2Advice, size_t side) {
+    std::vector<double> a(side * side, 1.0);
+    std::vector<double> b(side * side, 0.5);
+    std::vector<double> c(side * side, 0.0);
+    // Square blocks of a and b share L2, a row of the b panel and of c share L1.
+    auto block = std::max<size_t>(l2Advice.l2Side, 1);
+    auto nBlock = std::max<size_t>(l1Advice.l1Elements, 1);
+    auto ms = measureMs([&]() { gemmBlocked(a.data(), b.data(), c.data(), side, side, side, block, nBlock, block); }, 3);
+    doNotOptimize(c);
+    return 2.0 * static_cast<double>(side) * side * side / ms / 1e6;
+}
+
+
+double partitionMKeys(const TileAdvice& advice, const std::vector<uint64_t>& keys) {
+    std::vector<uint64_t> out(keys.size());
+    std::vector<size_t> offsets;
+    auto fanout = std::max<uint32_t>(advice.partitionFanout, 2);
+    auto ms = measureMs([&]() {
+        radixPartition(keys.data(), keys.size(), out.data(), fanout, 0, [](uint64_t key) { return key; }, offsets, advice.l1.line);
+    }, 3);
+    doNotOptimize(out);
+    return static_cast<double>(keys.size()) / ms / 1e3;
+}
+
+
+int main(int argc, char* argv[]) {
+    const size_t transposeSide = argc > 1 ? std::stoul(argv[1]) : 4096;
+    const size_t gemmSide = argc > 2 ? std::stoul(argv[2]) : 512;
+    const size_t keyCount = argc > 3 ? std::stoul(argv[3]) : size_t(1) << 24;
+
+    std::vector<uint64_t> keys(keyCount);
+    std::mt19937_64 random(42);
+    for (auto& key : keys) {
+        key = random();
+    }
+
+    const auto fixed = fixedCore();
+    struct Row {
+        const char* name;
+        TileAdvice two;
+        TileAdvice three;
+    };
+    const Row rows[] = {
+        { "advisor", adviseTiles(sizeof(double), 2), adviseTiles(sizeof(double), 3) },
+        { "32K/1M", adviseTiles(sizeof(double), 2, 0, fixed), adviseTiles(sizeof(double), 3, 0, fixed) },
+    };
+
+    std::cout << std::fixed << std::setprecision(2)
+        << std::setw(10) << "" << std::setw(12) << "Transpose" << std::setw(10) << "block"
+        << std::setw(10) << "GEMM" << std::setw(10) << "block"
+        << std::setw(12) << "Partition" << std::setw(10) << "fanout" << std::endl
+        << std::setw(10) << "" << std::setw(12) << "GB/s" << std::setw(10) << ""
+        << std::setw(10) << "GFLOP/s" << std::setw(10) << ""
+        << std::setw(12) << "Mkeys/s" << std::setw(10) << "" << std::endl;
+    for (const auto& row : rows) {
+        std::cout << std::setw(10) << row.name
+            << std::setw(12) << transposeGBs(row.two, transposeSide) << std::setw(10) << row.two.l1Side
+            << std::setw(10) << gemmGflops(row.two, row.three, gemmSide) << std::setw(10) << row.three.l2Side
+            << std::setw(12) << partitionMKeys(row.two, keys) << std::setw(10) << row.two.partitionFanout << std::endl;
+    }
+    return 0;
+}
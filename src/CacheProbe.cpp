@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <random>
+#include <tuple>
+
+#include "CacheProbe.h"
+#include "NumaAllocator.h"
+#include "ProbeUtils.h"
+
+
+using CoreInfo = CpuTopology::TopologyInfo::CoreInfo;
+
+
+// Probe geometry: chase links are one line apart, pages are the unit the chase stays in before moving on.
+constexpr size_t chaseLine = 64;
+constexpr size_t chasePage = 4096;
+// Blocks of the line size test, each visited at offset 0 and at the stride.
+constexpr size_t lineBlock = 512;
+// Warm-up before the sweep, long enough for the core to leave its idle clock.
+constexpr double warmUpSeconds = 0.2;
+
+
+// Link the first bytes of buffer into one cycle: pages in random order, every line of a page in random order.
+static void linkPages(char* buffer, size_t bytes, std::mt19937_64& random) {
+    const auto linesPerPage = std::min(bytes, chasePage) / chaseLine;
+    const auto pages = bytes / (linesPerPage * chaseLine);
+    std::vector<uint32_t> pageOrder(pages);
+    std::iota(pageOrder.begin(), pageOrder.end(), 0);
+    std::shuffle(pageOrder.begin(), pageOrder.end(), random);
+    std::vector<uint32_t> lineOrder(linesPerPage);
+    std::iota(lineOrder.begin(), lineOrder.end(), 0);
+
+    char* previous = nullptr;
+    char* first = nullptr;
+    for (auto page : pageOrder) {
+        std::shuffle(lineOrder.begin(), lineOrder.end(), random);
+        for (auto line : lineOrder) {
+            auto current = buffer + (static_cast<size_t>(page) * linesPerPage + line) * chaseLine;
+            if (previous) {
+                *reinterpret_cast<void**>(previous) = current;
+            }
+            else {
+                first = current;
+            }
+            previous = current;
+        }
+    }
+    *reinterpret_cast<void**>(previous) = first;
+}
+
+
+// Read bytes of buffer over and over until about total bytes went by, returns GB/s.
+static double readBandwidth(const char* buffer, size_t bytes, size_t total, uint32_t samples) {
+    const auto words = bytes / sizeof(uint64_t);
+    const auto passes = std::max<size_t>(1, total / bytes);
+    auto data = reinterpret_cast<const uint64_t*>(buffer);
+    auto best = std::numeric_limits<double>::max();
+    for (uint32_t sample = 0; sample < samples; ++sample) {
+        uint64_t sum = 0;
+        auto elapsed = elapsedSeconds([&]() {
+            for (size_t pass = 0; pass < passes; ++pass) {
+                for (size_t i = 0; i < words; ++i) {
+                    sum += data[i];
+                }
+            }
+        });
+        // Keeps the loop, the sum of a zero-filled buffer is never 1.
+        if (sum != 1) {
+            best = std::min(best, elapsed);
+        }
+    }
+    return static_cast<double>(passes * words * sizeof(uint64_t)) / best / 1e9;
+}
+
+
+// Blocks in random order, each read at stride and then at offset 0: once the stride leaves the line the second load misses too.
+// Descending loads keep the next-line prefetcher out. bytes should sit just past L1, a block then comes from L2 and
+// the second load is an L1 hit or another L2 access, while from memory the miss latency and TLB misses would bury the step.
+// The step is about 1.5 times: half the loads go from L1 hits to L2 accesses.
+// Returns the first stride whose loads take clearly longer than with the smallest stride, 0 if none.
+static uint32_t measureLine(char* buffer, size_t bytes, const CacheProbeOptions& options, std::mt19937_64& random) {
+    const auto blocks = bytes / lineBlock;
+    std::vector<uint32_t> order(blocks);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), random);
+
+    double smallest = 0.0;
+    for (size_t stride = sizeof(void*); stride < lineBlock; stride *= 2) {
+        for (size_t i = 0; i < blocks; ++i) {
+            auto block = buffer + static_cast<size_t>(order[i]) * lineBlock;
+            auto next = buffer + static_cast<size_t>(order[(i + 1) % blocks]) * lineBlock;
+            *reinterpret_cast<void**>(block + stride) = block;
+            *reinterpret_cast<void**>(block) = next + stride;
+        }
+        auto latency = chaseNanoseconds(buffer + static_cast<size_t>(order[0]) * lineBlock + stride, options.chaseSteps, options.samples);
+        if (stride == sizeof(void*)) {
+            smallest = latency;
+        }
+        else if (latency > 1.25 * smallest) {
+            return static_cast<uint32_t>(stride);
+        }
+    }
+    return 0;
+}
+
+
+// Median of values[first, last].
+static float median(const std::vector<float>& values, size_t first, size_t last) {
+    std::vector<float> range(values.begin() + first, values.begin() + last + 1);
+    std::nth_element(range.begin(), range.begin() + range.size() / 2, range.end());
+    return range[range.size() / 2];
+}
+
+
+// Median of every point and its two neighbours, a lone outlier is dropped while a step stays where it is.
+static std::vector<float> smooth(const std::vector<float>& values) {
+    if (values.size() < 3) {
+        return values;
+    }
+    std::vector<float> smoothed(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        auto first = std::min(i ? i - 1 : 0, values.size() - 3);
+        smoothed[i] = median(values, first, first + 2);
+    }
+    return smoothed;
+}
+
+
+// Working set of the line test: 4 times the L1 data cache, at most half of L2.
+static size_t lineTestBytes(const CoreInfo& core) {
+    size_t l1 = 32 << 10;
+    size_t l2 = 0;
+    for (const auto& cache : core.caches) {
+        if (cache.type != CpuTopology::CacheType::instruction && cache.size != std::numeric_limits<uint32_t>::max()) {
+            if (cache.level == 1) {
+                l1 = cache.size;
+            }
+            else if (cache.level == 2) {
+                l2 = cache.size;
+            }
+        }
+    }
+    auto bytes = 4 * l1;
+    if (l2 && bytes > l2 / 2) {
+        bytes = std::max(2 * l1, l2 / 2);
+    }
+    return bytes / lineBlock * lineBlock;
+}
+
+
+CacheProbeResult probeCaches(const CpuTopology& cpu, uint32_t core, const CacheProbeOptions& requested) {
+    // Without a sample or a step the best time would stay at its initial maximum and read as inf.
+    auto options = requested;
+    options.samples = std::max<uint32_t>(1, options.samples);
+    options.chaseSteps = std::max<uint32_t>(1, options.chaseSteps);
+    CacheProbeResult result;
+    result.core = core;
+    if (core >= cpu.Topology.cores.size()) {
+        return result;
+    }
+    const auto& info = cpu.Topology.cores[core];
+
+    auto maxBytes = options.maxBytes;
+    if (maxBytes == 0) {
+        maxBytes = size_t(64) << 20;
+        for (const auto& cache : info.caches) {
+            maxBytes = std::max(maxBytes, size_t(4) * cache.size);
+        }
+        maxBytes = std::min(maxBytes, size_t(1) << 30);
+    }
+    const auto minBytes = std::max(options.minBytes, chasePage);
+    maxBytes = std::max(maxBytes, minBytes);
+
+    // Working sets on a geometric grid, rounded to whole pages.
+    const auto points = std::max<uint32_t>(1, options.pointsPerOctave);
+    for (uint32_t i = 0;; ++i) {
+        auto bytes = static_cast<size_t>(static_cast<double>(minBytes) * std::pow(2.0, static_cast<double>(i) / points));
+        bytes = bytes / chasePage * chasePage;
+        if (bytes > maxBytes) {
+            break;
+        }
+        if (result.workingSets.empty() || bytes != result.workingSets.back()) {
+            result.workingSets.push_back(bytes);
+        }
+    }
+
+    auto buffer = static_cast<char*>(NumaArena::sysNode(info.sysNumaNode).allocate(maxBytes, chasePage));
+    std::fill(buffer, buffer + maxBytes, char(0));
+
+    CpuSet first;
+    first.set(CpuSet::index(info.sysProcessorGroup, info.sysLogicalProcessors.front()));
+    runPinned({ first }, nullptr, [&](size_t) {
+        std::mt19937_64 random(42);
+
+        // The first working set until the clock settled, its samples would otherwise read slow.
+        const auto warmUpBytes = result.workingSets.front();
+        linkPages(buffer, warmUpBytes, random);
+        for (double warmed = 0.0; warmed < warmUpSeconds;) {
+            warmed += elapsedSeconds([&]() { chaseNanoseconds(buffer, options.chaseSteps, 1); });
+        }
+
+        for (auto bytes : result.workingSets) {
+            std::fill(buffer, buffer + bytes, char(0));
+            result.bandwidths.push_back(static_cast<float>(readBandwidth(buffer, bytes, options.bandwidthBytes, options.samples)));
+            linkPages(buffer, bytes, random);
+            result.latencies.push_back(static_cast<float>(chaseNanoseconds(buffer, options.chaseSteps, options.samples)));
+        }
+        result.line = measureLine(buffer, std::min(maxBytes, lineTestBytes(info)), options, random);
+    });
+    NumaArena::release(buffer);
+
+    // Plateaus on the smoothed curve: a level lasts while the latency stays within 1.25 times the median
+    // of its points so far, the next one starts where the rise flattens out again.
+    const auto latencies = smooth(result.latencies);
+    const auto count = latencies.size();
+    size_t begin = 0;
+    while (begin < count) {
+        auto end = begin;
+        while (end + 1 < count && latencies[end + 1] <= 1.25f * median(latencies, begin, end)) {
+            ++end;
+        }
+        if (end + 1 == count) {
+            result.memoryLatency = median(latencies, begin, end);
+            result.memoryBandwidth = median(result.bandwidths, begin, end);
+            break;
+        }
+        CpuTopology::MeasuredCacheInfo level;
+        level.effectiveSize = static_cast<uint32_t>(std::min<size_t>(result.workingSets[end], std::numeric_limits<uint32_t>::max()));
+        level.latency = median(latencies, begin, end);
+        level.bandwidth = median(result.bandwidths, begin, end);
+        // Cache levels are at least 1.5 times apart, a stretch closer to the level before is its noisy tail.
+        if (!result.levels.empty() && level.latency <= 1.5f * result.levels.back().latency) {
+            result.levels.back().effectiveSize = level.effectiveSize;
+        }
+        else {
+            result.levels.push_back(level);
+        }
+
+        begin = end + 1;
+        while (begin + 1 < count && latencies[begin + 1] > 1.1f * latencies[begin]) {
+            ++begin;
+        }
+    }
+    return result;
+}
+
+
+// Data and unified caches of core from the innermost level, as indices into core.caches.
+static std::vector<size_t> dataCaches(const CoreInfo& core) {
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < core.caches.size(); ++i) {
+        if (core.caches[i].type != CpuTopology::CacheType::instruction) {
+            indices.push_back(i);
+        }
+    }
+    std::stable_sort(indices.begin(), indices.end(), [&](size_t a, size_t b) { return core.caches[a].level < core.caches[b].level; });
+    return indices;
+}
+
+
+void attachCacheProbe(CoreInfo& core, const CacheProbeResult& result) {
+    core.measuredCaches.assign(core.caches.size(), CpuTopology::MeasuredCacheInfo());
+    auto indices = dataCaches(core);
+    for (size_t i = 0; i < indices.size() && i < result.levels.size(); ++i) {
+        core.measuredCaches[indices[i]] = result.levels[i];
+    }
+}
+
+
+std::vector<CacheProbeResult> probeCoreCaches(CpuTopology& cpu, const CacheProbeOptions& options) {
+    std::vector<CacheProbeResult> results;
+    std::map<std::tuple<uint32_t, uint32_t>, size_t> probed;
+    for (auto& core : cpu.Topology.cores) {
+        auto key = std::make_tuple(core.complexGroup ? core.complexGroup->id : std::numeric_limits<uint32_t>::max(), core.efficiencyClass);
+        auto found = probed.find(key);
+        if (found == probed.end()) {
+            found = probed.emplace(key, results.size()).first;
+            results.push_back(probeCaches(cpu, core.id, options));
+        }
+        attachCacheProbe(core, results[found->second]);
+    }
+    return results;
+}
+
+
+static std::string kilobytes(size_t bytes) {
+    return std::to_string(bytes / 1024) + " KB";
+}
+
+
+std::vector<std::string> checkCacheProbe(const CpuTopology& cpu, const CacheProbeResult& result) {
+    std::vector<std::string> differences;
+    if (result.core >= cpu.Topology.cores.size()) {
+        return differences;
+    }
+    const auto& core = cpu.Topology.cores[result.core];
+    const auto prefix = "core " + std::to_string(core.id) + " ";
+    auto indices = dataCaches(core);
+
+    for (size_t i = 0; i < std::max(indices.size(), result.levels.size()); ++i) {
+        if (i >= result.levels.size()) {
+            const auto& cache = core.caches[indices[i]];
+            differences.push_back(prefix + "L" + std::to_string(cache.level) + ": reported " + kilobytes(cache.size) + ", no latency step measured");
+            continue;
+        }
+        const auto& level = result.levels[i];
+        if (i >= indices.size()) {
+            differences.push_back(prefix + "level " + std::to_string(i + 1) + ": measured " + kilobytes(level.effectiveSize) +
+                " at " + std::to_string(level.latency) + " ns, not reported");
+            continue;
+        }
+        const auto& cache = core.caches[indices[i]];
+        if (level.effectiveSize * 2 < cache.size || level.effectiveSize > uint64_t(2) * cache.size) {
+            differences.push_back(prefix + "L" + std::to_string(cache.level) + ": reported " + kilobytes(cache.size) +
+                ", effective " + kilobytes(level.effectiveSize));
+        }
+    }
+
+    if (result.line && !indices.empty() && core.caches[indices.front()].line != result.line) {
+        differences.push_back(prefix + "line: reported " + std::to_string(core.caches[indices.front()].line) +
+            " B, measured " + std::to_string(result.line) + " B");
+    }
+    return differences;
+}
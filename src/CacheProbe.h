@@ -0,0 +1,68 @@
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Options of the cache hierarchy probe. */
+struct CacheProbeOptions {
+    /* Smallest working set. */
+    size_t minBytes = size_t(4) << 10;
+    /* Largest working set, 0 picks 4 times the largest cache of the core, 64 MB ~ 1 GB. */
+    size_t maxBytes = 0;
+    /* Working sets per doubling. */
+    uint32_t pointsPerOctave = 4;
+    /* Dependent loads per latency sample. */
+    uint32_t chaseSteps = 1 << 20;
+    /* Bytes read per bandwidth sample, small working sets are read repeatedly. */
+    size_t bandwidthBytes = size_t(64) << 20;
+    /* Samples per working set, the best one is kept. 0 counts as 1. */
+    uint32_t samples = 3;
+};
+
+
+/* Latency and bandwidth of one core over growing working sets, and the levels read off them. */
+struct CacheProbeResult {
+    /* Core id in TopologyInfo. */
+    uint32_t core = std::numeric_limits<uint32_t>::max();
+
+    /* Working set sizes in bytes, with the dependent load latency in ns and read bandwidth in GB/s of each. */
+    std::vector<size_t> workingSets;
+    std::vector<float> latencies;
+    std::vector<float> bandwidths;
+
+    /* Smallest stride at which two loads of a block stop sharing a line, 0 if no step showed up.
+       Measured on a working set just past L1, so the second load is an L1 hit or an L2 access. */
+    uint32_t line = 0;
+
+    /* Latency plateaus from the innermost data cache outwards, memory excluded. */
+    std::vector<CpuTopology::MeasuredCacheInfo> levels;
+    /* The plateau past the last cache, 0 if the sweep never reached it. */
+    float memoryLatency = 0.0f;
+    float memoryBandwidth = 0.0f;
+};
+
+
+/* Sweep working sets from one thread pinned to the first logical processor of core, with memory on its NUMA node.
+   Latency chases a random cycle that visits every line of a page before it moves to another random page,
+   so TLB misses stay rare while the prefetchers cannot follow. The first working set is chased for a while before
+   the sweep so the clock has settled. A level ends at the last working set within 1.25 times the median of the
+   level so far, on a curve where each point is the median of itself and its neighbours. A plateau less than
+   1.5 times slower than the level before is folded into it.
+   Shared caches are measured as one core sees them, alone. */
+CacheProbeResult probeCaches(const CpuTopology& cpu, uint32_t core, const CacheProbeOptions& options = CacheProbeOptions());
+
+/* Fill core.measuredCaches from result: the n-th plateau goes to the n-th data or unified level of core.caches,
+   instruction caches and levels without a plateau stay unmeasured. */
+void attachCacheProbe(CpuTopology::TopologyInfo::CoreInfo& core, const CacheProbeResult& result);
+
+/* Probe the first core of every complex group and efficiency class, attach each result to every core
+   of its class, and return the results. Takes seconds per probed core. */
+std::vector<CacheProbeResult> probeCoreCaches(CpuTopology& cpu, const CacheProbeOptions& options = CacheProbeOptions());
+
+/* Where a probe disagrees with the caches the OS reports for its core: a missing or extra level,
+   an effective size off by more than half or a different line. An empty result means they agree. */
+std::vector<std::string> checkCacheProbe(const CpuTopology& cpu, const CacheProbeResult& result);
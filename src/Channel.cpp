@@ -0,0 +1,33 @@
+#include <algorithm>
+#include <limits>
+
+#include "Channel.h"
+#include "NumaAllocator.h"
+
+
+RingMemory::RingMemory(const CpuTopology::TopologyInfo::CoreInfo& consumer, uint32_t controlLines, uint32_t capacity, size_t slotSize, size_t slotAlignment)
+    : controlCount(controlLines) {
+    // Largest line of the consumer's caches, the unit the two sides must not share.
+    for (const auto& cache : consumer.caches) {
+        if (cache.line != std::numeric_limits<uint32_t>::max()) {
+            lineSize = std::max<size_t>(lineSize, cache.line);
+        }
+    }
+    if (lineSize == 0) {
+        lineSize = 64;
+    }
+    lineSize = std::max(lineSize, slotAlignment);
+
+    slotCount = 2;
+    while (slotCount < capacity) {
+        slotCount *= 2;
+    }
+
+    auto& arena = consumer.sysNumaNode == std::numeric_limits<uint32_t>::max() ? NumaArena::local() : NumaArena::sysNode(consumer.sysNumaNode);
+    block = static_cast<char*>(arena.allocate(controlCount * lineSize + slotCount * slotSize, lineSize));
+}
+
+
+RingMemory::~RingMemory() {
+    NumaArena::release(block);
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Memory of one ring: control lines and slots in one NumaArena block.
+   Every control line is line bytes apart, slots start on a line of their own. */
+class RingMemory {
+public:
+    RingMemory(const RingMemory&) = delete;
+    RingMemory& operator = (const RingMemory&) = delete;
+
+    /* Slots of the ring, a power of two. */
+    uint32_t capacity() const { return slotCount; }
+
+protected:
+    /* capacity is rounded up to a power of two, at least 2. */
+    RingMemory(const CpuTopology::TopologyInfo::CoreInfo& consumer, uint32_t controlLines, uint32_t capacity, size_t slotSize, size_t slotAlignment);
+    ~RingMemory();
+
+    void* control(uint32_t line) const { return block + line * lineSize; }
+    void* slots() const { return block + controlCount * lineSize; }
+
+    uint64_t mask() const { return slotCount - 1; }
+
+private:
+    char* block = nullptr;
+    size_t lineSize = 0;
+    uint32_t controlCount = 0;
+    uint32_t slotCount = 0;
+};
+
+
+/* Bounded lock-free single producer, single consumer ring of trivially copyable messages, placed on the
+   consumer's NUMA node. The producer publishes its position every batch messages and the consumer returns
+   slots every batch messages, so the two control lines cross between the cores once per batch instead of
+   once per message. flush() and release() publish early, e.g. before the producer or consumer idles. */
+template <typename T>
+class SpscRing : public RingMemory {
+    static_assert(std::is_trivially_copyable<T>::value, "Ring messages are copied with their bytes.");
+
+public:
+    SpscRing(const CpuTopology::TopologyInfo::CoreInfo& consumer, uint32_t capacity, uint32_t batch)
+        : RingMemory(consumer, 4, capacity, sizeof(T), alignof(T)), batch(batch ? batch : 1) {
+        new (control(producerLine)) Producer();
+        new (control(publishedLine)) std::atomic<uint64_t>(0);
+        new (control(releasedLine)) std::atomic<uint64_t>(0);
+        new (control(consumerLine)) Consumer();
+    }
+
+    /* Producer side, false if the ring is full. */
+    bool tryPush(const T& value) {
+        auto& self = producer();
+        if (self.write - self.cachedReleased == capacity()) {
+            self.cachedReleased = released().load(std::memory_order_acquire);
+            if (self.write - self.cachedReleased == capacity()) {
+                flush();
+                return false;
+            }
+        }
+        static_cast<T*>(slots())[self.write & mask()] = value;
+        if (++self.write - self.published >= batch) {
+            flush();
+        }
+        return true;
+    }
+
+    /* Producer side, make every pushed message visible to the consumer. */
+    void flush() {
+        auto& self = producer();
+        if (self.published != self.write) {
+            self.published = self.write;
+            published().store(self.write, std::memory_order_release);
+        }
+    }
+
+    /* Consumer side, false if no published message is left. */
+    bool tryPop(T& value) {
+        auto& self = consumer();
+        if (self.read == self.cachedPublished) {
+            release();
+            self.cachedPublished = published().load(std::memory_order_acquire);
+            if (self.read == self.cachedPublished) {
+                return false;
+            }
+        }
+        value = static_cast<const T*>(slots())[self.read & mask()];
+        if (++self.read - self.released >= batch) {
+            release();
+        }
+        return true;
+    }
+
+    /* Consumer side, hand every consumed slot back to the producer. */
+    void release() {
+        auto& self = consumer();
+        if (self.released != self.read) {
+            self.released = self.read;
+            released().store(self.read, std::memory_order_release);
+        }
+    }
+
+private:
+    static constexpr uint32_t producerLine = 0;
+    static constexpr uint32_t publishedLine = 1;
+    static constexpr uint32_t releasedLine = 2;
+    static constexpr uint32_t consumerLine = 3;
+
+    /* Only touched by the producer. */
+    struct Producer {
+        uint64_t write = 0;
+        uint64_t published = 0;
+        uint64_t cachedReleased = 0;
+    };
+
+    /* Only touched by the consumer. */
+    struct Consumer {
+        uint64_t read = 0;
+        uint64_t released = 0;
+        uint64_t cachedPublished = 0;
+    };
+
+    Producer& producer() { return *static_cast<Producer*>(control(producerLine)); }
+    Consumer& consumer() { return *static_cast<Consumer*>(control(consumerLine)); }
+    std::atomic<uint64_t>& published() { return *static_cast<std::atomic<uint64_t>*>(control(publishedLine)); }
+    std::atomic<uint64_t>& released() { return *static_cast<std::atomic<uint64_t>*>(control(releasedLine)); }
+
+    uint32_t batch;
+};
+
+
+/* Bounded lock-free multi producer, single consumer ring of trivially copyable messages, placed on the
+   consumer's NUMA node. Every slot carries a sequence number (Vyukov's bounded queue); a producer claims
+   a run of slots with one compare-and-swap, the consumer drains consecutive ready slots in one call. */
+template <typename T>
+class MpscRing : public RingMemory {
+    static_assert(std::is_trivially_copyable<T>::value, "Ring messages are copied with their bytes.");
+
+public:
+    MpscRing(const CpuTopology::TopologyInfo::CoreInfo& consumer, uint32_t capacity)
+        : RingMemory(consumer, 2, capacity, sizeof(Cell), alignof(Cell)) {
+        new (control(tailLine)) std::atomic<uint64_t>(0);
+        new (control(readLine)) uint64_t(0);
+        for (uint32_t i = 0; i < this->capacity(); ++i) {
+            new (&cells()[i]) Cell();
+            cells()[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /* Producer side, push up to count messages in order, returns how many fit. */
+    size_t tryPush(const T* values, size_t count) {
+        auto& tail = *static_cast<std::atomic<uint64_t>*>(control(tailLine));
+        auto position = tail.load(std::memory_order_relaxed);
+        uint64_t claimed = std::min<uint64_t>(count, capacity());
+        while (claimed) {
+            // The consumer frees slots in order, the last slot of the run being free means the whole run is.
+            auto sequence = cells()[(position + claimed - 1) & mask()].sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<int64_t>(sequence - (position + claimed - 1));
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + claimed, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (difference < 0) {
+                claimed /= 2;
+            }
+            else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+        for (uint64_t i = 0; i < claimed; ++i) {
+            auto& cell = cells()[(position + i) & mask()];
+            cell.value = values[i];
+            cell.sequence.store(position + i + 1, std::memory_order_release);
+        }
+        return static_cast<size_t>(claimed);
+    }
+
+    bool tryPush(const T& value) { return tryPush(&value, 1) == 1; }
+
+    /* Consumer side, pop up to count consecutive published messages, returns how many. */
+    size_t tryPop(T* values, size_t count) {
+        auto& read = *static_cast<uint64_t*>(control(readLine));
+        size_t popped = 0;
+        while (popped < count) {
+            auto& cell = cells()[(read + popped) & mask()];
+            if (cell.sequence.load(std::memory_order_acquire) != read + popped + 1) {
+                break;
+            }
+            values[popped] = cell.value;
+            ++popped;
+        }
+        for (size_t i = 0; i < popped; ++i) {
+            cells()[(read + i) & mask()].sequence.store(read + i + capacity(), std::memory_order_release);
+        }
+        read += popped;
+        return popped;
+    }
+
+    bool tryPop(T& value) { return tryPop(&value, 1) == 1; }
+
+private:
+    static constexpr uint32_t tailLine = 0;
+    static constexpr uint32_t readLine = 1;
+
+    struct Cell {
+        std::atomic<uint64_t> sequence{ 0 };
+        T value;
+    };
+
+    Cell* cells() { return static_cast<Cell*>(slots()); }
+};
+
+
+/* Rings between a set of cores: an SpscRing for every ordered pair of distinct endpoints and an MpscRing
+   inbox per endpoint, each on the NUMA node of its consumer and padded to the largest line of its caches.
+   Endpoint i is cores[i]; the threads using an endpoint should be pinned to cpuSet(i). */
+template <typename T>
+class ChannelMesh {
+public:
+    using CoreInfo = CpuTopology::TopologyInfo::CoreInfo;
+
+    explicit ChannelMesh(const std::vector<const CoreInfo*>& cores, uint32_t capacity = 1024, uint32_t batch = 16) {
+        const auto count = cores.size();
+        for (size_t consumer = 0; consumer < count; ++consumer) {
+            cpuSets.push_back(cores[consumer]->cpuSet);
+            inboxes.push_back(std::make_unique<MpscRing<T>>(*cores[consumer], capacity));
+        }
+        channels.resize(count * count);
+        for (size_t producer = 0; producer < count; ++producer) {
+            for (size_t consumer = 0; consumer < count; ++consumer) {
+                if (producer != consumer) {
+                    channels[producer * count + consumer] = std::make_unique<SpscRing<T>>(*cores[consumer], capacity, batch);
+                }
+            }
+        }
+    }
+
+    size_t size() const { return cpuSets.size(); }
+
+    /* Ring from producer to consumer, producer != consumer. */
+    SpscRing<T>& channel(size_t producer, size_t consumer) { return *channels[producer * size() + consumer]; }
+
+    /* Ring every endpoint may push to, consumed by consumer. */
+    MpscRing<T>& inbox(size_t consumer) { return *inboxes[consumer]; }
+
+    const CpuSet& cpuSet(size_t endpoint) const { return cpuSets[endpoint]; }
+
+private:
+    std::vector<CpuSet> cpuSets;
+    std::vector<std::unique_ptr<SpscRing<T>>> channels;
+    std::vector<std::unique_ptr<MpscRing<T>>> inboxes;
+};
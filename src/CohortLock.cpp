@@ -0,0 +1,70 @@
+#include "CohortLock.h"
+
+
+CohortLock::CohortLock(const CpuTopology& cpu, uint32_t passLimit) : passLimit(passLimit) {
+    constexpr auto none = CpuTopology::FlatTopologyInfo::none;
+    const auto& flat = cpu.FlatTopology;
+
+    // One spare complex group and NUMA node for processors the topology does not know.
+    complexGroupCount = static_cast<uint32_t>(cpu.Topology.complexGroups.size()) + 1;
+    const auto numaNodeCount = static_cast<uint32_t>(cpu.Topology.numaNodes.size()) + 1;
+    complexGroups.reset(new Domain[complexGroupCount]);
+    numaNodes.reset(new Domain[numaNodeCount]);
+    for (uint32_t i = 0; i + 1 < complexGroupCount; ++i) {
+        auto numaNode = i < flat.complexGroupNumaNodes.size() ? flat.complexGroupNumaNodes[i] : none;
+        complexGroups[i].parent = numaNode != none ? numaNode : numaNodeCount - 1;
+    }
+    complexGroups[complexGroupCount - 1].parent = numaNodeCount - 1;
+
+    processorComplexGroups.resize(flat.processors.size(), complexGroupCount - 1);
+    for (size_t i = 0; i < flat.processors.size(); ++i) {
+        if (flat.processors[i].complexGroup != none) {
+            processorComplexGroups[i] = flat.processors[i].complexGroup;
+        }
+    }
+}
+
+
+uint32_t CohortLock::currentComplexGroup() const {
+    auto processor = currentProcessor();
+    return processor < processorComplexGroups.size() ? processorComplexGroups[processor] : complexGroupCount - 1;
+}
+
+
+void CohortLock::lock(Node& node) {
+    node.complexGroup = currentComplexGroup();
+    auto& complexGroup = complexGroups[node.complexGroup];
+    if (complexGroup.lock.lock(node.node) == inherited) {
+        return;
+    }
+    complexGroup.passes = 0;
+
+    // First of its complex group, the group competes at the NUMA node.
+    auto& numaNode = numaNodes[complexGroup.parent];
+    if (numaNode.lock.lock(complexGroup.upper) == inherited) {
+        return;
+    }
+    numaNode.passes = 0;
+    global.lock(numaNode.upper);
+}
+
+
+void CohortLock::unlock(Node& node) {
+    auto& complexGroup = complexGroups[node.complexGroup];
+    if (complexGroup.passes < passLimit && complexGroup.lock.hasWaiters(node.node)) {
+        ++complexGroup.passes;
+        complexGroup.lock.unlock(node.node, inherited);
+        return;
+    }
+
+    auto& numaNode = numaNodes[complexGroup.parent];
+    if (numaNode.passes < passLimit && numaNode.lock.hasWaiters(complexGroup.upper)) {
+        ++numaNode.passes;
+        numaNode.lock.unlock(complexGroup.upper, inherited);
+    }
+    else {
+        global.unlock(numaNode.upper);
+        numaNode.lock.unlock(complexGroup.upper);
+    }
+    complexGroup.lock.unlock(node.node);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "CpuTopology.h"
+
+
+/* Spin loop hint, yields the thread once spinning went on for a while so an oversubscribed
+   waiter does not burn the time slice of the holder. */
+inline void spinWait(uint32_t& spins) {
+    if (++spins < 128) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+    else {
+        std::this_thread::yield();
+    }
+}
+
+
+/* Queue node of an McsLock, one per waiting thread, it must stay alive until unlock(). */
+struct alignas(64) McsNode {
+    std::atomic<McsNode*> next{ nullptr };
+    /* 0 while waiting, then the value passed to unlock() by the predecessor. */
+    std::atomic<uint32_t> state{ 0 };
+};
+
+
+/* MCS queue lock: every waiter spins on its own node, the holder hands the lock to the next one in FIFO order. */
+class McsLock {
+public:
+    /* lock() result when the lock was free. */
+    static constexpr uint32_t uncontended = 1;
+
+    /* Returns uncontended, or the value the predecessor passed to unlock(). */
+    uint32_t lock(McsNode& node) {
+        node.next.store(nullptr, std::memory_order_relaxed);
+        node.state.store(0, std::memory_order_relaxed);
+        auto predecessor = tail.exchange(&node, std::memory_order_acq_rel);
+        if (!predecessor) {
+            return uncontended;
+        }
+        predecessor->next.store(&node, std::memory_order_release);
+        uint32_t state = 0;
+        uint32_t spins = 0;
+        while ((state = node.state.load(std::memory_order_acquire)) == 0) {
+            spinWait(spins);
+        }
+        return state;
+    }
+
+    /* True if another thread queued behind node. */
+    bool hasWaiters(const McsNode& node) const {
+        return node.next.load(std::memory_order_acquire) || tail.load(std::memory_order_relaxed) != &node;
+    }
+
+    /* Release the lock, the next waiter's lock() returns handoff. */
+    void unlock(McsNode& node, uint32_t handoff = uncontended) {
+        auto next = node.next.load(std::memory_order_acquire);
+        if (!next) {
+            auto expected = &node;
+            if (tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed)) {
+                return;
+            }
+            // A waiter swapped the tail but did not link itself yet.
+            uint32_t spins = 0;
+            while (!(next = node.next.load(std::memory_order_acquire))) {
+                spinWait(spins);
+            }
+        }
+        next->state.store(handoff, std::memory_order_release);
+    }
+
+private:
+    alignas(64) std::atomic<McsNode*> tail{ nullptr };
+};
+
+
+/* Hierarchical cohort lock (C-MCS-MCS): an MCS lock per complex group, one per NUMA node and a global one.
+   The holder hands the lock to a waiter of its own complex group first, then to another complex group of its
+   NUMA node, and only then releases it to the other NUMA nodes, so the lock and the data it guards cross an
+   L3 or socket boundary as rarely as possible. passLimit consecutive hand-overs inside one domain bound how
+   long the other domains wait. A thread's cohort is the complex group it runs on when it calls lock(). */
+class CohortLock {
+public:
+    struct Node {
+        McsNode node;
+        uint32_t complexGroup = 0;
+    };
+
+    explicit CohortLock(const CpuTopology& cpu = CpuTopology::process(), uint32_t passLimit = 64);
+
+    CohortLock(const CohortLock&) = delete;
+    CohortLock& operator = (const CohortLock&) = delete;
+
+    void lock(Node& node);
+    void unlock(Node& node);
+
+    /* Scoped lock with its node on the stack. */
+    class Guard {
+    public:
+        explicit Guard(CohortLock& lock) : owner(lock) { owner.lock(node); }
+        ~Guard() { owner.unlock(node); }
+
+        Guard(const Guard&) = delete;
+        Guard& operator = (const Guard&) = delete;
+
+    private:
+        CohortLock& owner;
+        Node node;
+    };
+
+private:
+    /* McsLock::lock() result when the predecessor passed the upper levels along. */
+    static constexpr uint32_t inherited = 2;
+
+    struct alignas(64) Domain {
+        McsLock lock;
+        /* Node the holder of this domain queues with at the next level. */
+        McsNode upper;
+        /* Consecutive hand-overs inside the domain, only touched by its holder. */
+        uint32_t passes = 0;
+        /* NUMA node of a complex group. */
+        uint32_t parent = 0;
+    };
+
+    /* Complex group of the calling thread, the last complex group stands for unknown processors. */
+    uint32_t currentComplexGroup() const;
+
+    uint32_t passLimit;
+    /* Complex group per CpuSet::index. */
+    std::vector<uint32_t> processorComplexGroups;
+    std::unique_ptr<Domain[]> complexGroups;
+    uint32_t complexGroupCount = 0;
+    std::unique_ptr<Domain[]> numaNodes;
+    McsLock global;
+};
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "CoreLatency.h"
+#include "MeasurementCache.h"
+
+
+// Cache line bounced between the two threads of a pair, padded against adjacent line prefetch.
+struct alignas(128) PingPongLine {
+    std::atomic<uint32_t> value{ 0 };
+};
+
+
+// Spin until done() holds, yield now and then so oversubscribed runs still progress.
+template <typename F>
+inline void spinUntil(F&& done) {
+    for (uint32_t spins = 1; !done(); ++spins) {
+        if ((spins & 1023) == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+
+// Sense-reversing barrier for the measurement threads.
+class SpinBarrier {
+public:
+    explicit SpinBarrier(uint32_t count) : count(count) {}
+
+    void wait() {
+        auto generation = this->generation.load(std::memory_order_acquire);
+        if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == count) {
+            arrived.store(0, std::memory_order_relaxed);
+            this->generation.fetch_add(1, std::memory_order_release);
+        }
+        else {
+            spinUntil([&]() { return this->generation.load(std::memory_order_acquire) != generation; });
+        }
+    }
+
+private:
+    const uint32_t count;
+    std::atomic<uint32_t> arrived{ 0 };
+    std::atomic<uint32_t> generation{ 0 };
+};
+
+
+std::vector<float> measureCoreLatency(const CpuTopology& cpu, const CoreLatencyOptions& options) {
+    const auto cores = static_cast<uint32_t>(cpu.Topology.cores.size());
+    std::vector<float> latencies(static_cast<size_t>(cores) * cores, 0.0f);
+    if (cores < 2 || options.roundTrips == 0) {
+        return latencies;
+    }
+
+    // Round robin tournament (circle method): every round pairs all cores once,
+    // slot cores is a bye when the core count is odd.
+    const auto slots = cores + (cores & 1);
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> batches;
+    for (uint32_t round = 0; round + 1 < slots; ++round) {
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        for (uint32_t i = 0; i < slots / 2; ++i) {
+            auto a = i == 0 ? slots - 1 : (round + i) % (slots - 1);
+            auto b = (round + slots - 1 - i) % (slots - 1);
+            if (a < cores && b < cores) {
+                pairs.emplace_back(std::min(a, b), std::max(a, b));
+            }
+        }
+        if (options.parallel) {
+            batches.push_back(std::move(pairs));
+        }
+        else {
+            for (const auto& pair : pairs) {
+                batches.push_back({ pair });
+            }
+        }
+    }
+
+    // Line of a pair is owned by its lower core.
+    std::unique_ptr<PingPongLine[]> lines(new PingPongLine[cores]);
+    SpinBarrier barrier(cores);
+    std::atomic<bool> pinned{ true };
+
+    auto measure = [&](uint32_t self) {
+        const auto& core = cpu.Topology.cores[self];
+        CpuSet processor;
+        processor.set(core.cpuSet.first());
+        if (!bindCurrentThread(processor)) {
+            pinned = false;
+        }
+
+        // Unpinned threads would share processors and measure the scheduler, every thread gives up together.
+        barrier.wait();
+        if (!pinned) {
+            return;
+        }
+
+        for (const auto& batch : batches) {
+            barrier.wait();
+            for (const auto& pair : batch) {
+                if (pair.first != self && pair.second != self) {
+                    continue;
+                }
+
+                auto& line = lines[pair.first].value;
+                if (pair.second == self) {
+                    // Responder, answer every odd value with the next even one.
+                    uint32_t expected = 1;
+                    for (uint32_t i = 0; i <= options.samples; ++i) {
+                        for (uint32_t trip = 0; trip < options.roundTrips; ++trip) {
+                            spinUntil([&]() { return line.load(std::memory_order_acquire) == expected; });
+                            line.store(expected + 1, std::memory_order_release);
+                            expected += 2;
+                        }
+                    }
+                    continue;
+                }
+
+                // Initiator, the first sample only warms up the line and the frequency.
+                auto best = std::numeric_limits<double>::max();
+                uint32_t value = 1;
+                for (uint32_t i = 0; i <= options.samples; ++i) {
+                    auto start = std::chrono::steady_clock::now();
+                    for (uint32_t trip = 0; trip < options.roundTrips; ++trip) {
+                        line.store(value, std::memory_order_release);
+                        spinUntil([&]() { return line.load(std::memory_order_acquire) == value + 1; });
+                        value += 2;
+                    }
+                    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+                    if (i > 0) {
+                        best = std::min(best, elapsed.count());
+                    }
+                }
+                line.store(0, std::memory_order_relaxed);
+
+                auto latency = static_cast<float>(best / options.roundTrips / 2.0);
+                latencies[static_cast<size_t>(pair.first) * cores + pair.second] = latency;
+                latencies[static_cast<size_t>(pair.second) * cores + pair.first] = latency;
+            }
+        }
+        barrier.wait();
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < cores; ++i) {
+        threads.emplace_back(measure, i);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (!pinned) {
+        latencies.clear();
+    }
+    return latencies;
+}
+
+
+bool saveCoreLatency(const std::string& path, const CpuTopology& cpu, const std::vector<float>& latencies) {
+    return saveMeasurement(path, cpu, static_cast<uint32_t>(cpu.Topology.cores.size()), { &latencies });
+}
+
+
+bool loadCoreLatency(const std::string& path, const CpuTopology& cpu, std::vector<float>& latencies) {
+    return loadMeasurement(path, cpu, static_cast<uint32_t>(cpu.Topology.cores.size()), { &latencies });
+}
+
+
+std::string coreLatencyCachePath(const CpuTopology& cpu) {
+    return measurementCachePath(cpu, "core_latency");
+}
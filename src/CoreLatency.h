@@ -0,0 +1,34 @@
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Options of the core to core latency measurement. */
+struct CoreLatencyOptions {
+    /* Cache line round trips per sample. */
+    uint32_t roundTrips = 1000;
+    /* Samples per pair, the fastest one is kept. */
+    uint32_t samples = 3;
+    /* Measure disjoint pairs at the same time: cores - 1 rounds instead of one pair at a time. */
+    bool parallel = true;
+};
+
+
+/* Ping-pong a cache line between the first logical processor of every pair of cores.
+   Returns the one-way latencies in ns, cores.size() * cores.size() row-major and symmetric,
+   the layout of TopologyInfo::coreLatencies. Empty if a thread could not be pinned to its core,
+   e.g. when the process cpuset lacks cores of cpu, use the process view there. */
+std::vector<float> measureCoreLatency(const CpuTopology& cpu, const CoreLatencyOptions& options = CoreLatencyOptions());
+
+/* Persist a latency matrix, please see MeasurementCache.h. */
+bool saveCoreLatency(const std::string& path, const CpuTopology& cpu, const std::vector<float>& latencies);
+
+/* Load a latency matrix, fails if it was measured on another host or another core count. */
+bool loadCoreLatency(const std::string& path, const CpuTopology& cpu, std::vector<float>& latencies);
+
+/* Default file of the latency matrix in CpuTopology::cacheDirectory(). */
+std::string coreLatencyCachePath(const CpuTopology& cpu);
@@ -0,0 +1,306 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#endif
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#if defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define CPU_SET_RSEQ
+#endif
+#endif
+#endif
+
+#include "CpuSet.h"
+
+
+#if defined(_WIN32)
+bool bindThread(std::thread::native_handle_type thread, const CpuSet& set) {
+    auto first = set.first();
+    if (first == CpuSet::maxProcessors) {
+        return false;
+    }
+    GROUP_AFFINITY affinity = {};
+    affinity.Group = static_cast<WORD>(first / CpuSet::wordBits);
+    affinity.Mask = static_cast<KAFFINITY>(set.bits[affinity.Group]);
+    return SetThreadGroupAffinity(static_cast<HANDLE>(thread), &affinity, nullptr) != FALSE;
+}
+
+
+bool bindCurrentThread(const CpuSet& set) {
+    return bindThread(GetCurrentThread(), set);
+}
+
+
+CpuSet processAffinity() {
+    CpuSet set;
+    USHORT groups[CpuSet::words] = {};
+    USHORT groupCount = CpuSet::words;
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    // A process confined to one group has a classic affinity mask, otherwise it may use every group.
+    if (GetProcessGroupAffinity(GetCurrentProcess(), &groupCount, groups) && groupCount == 1 &&
+        GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        set.bits[groups[0] % CpuSet::words] = static_cast<uint64_t>(processMask);
+        return set;
+    }
+    auto activeGroups = std::min<uint32_t>(GetActiveProcessorGroupCount(), CpuSet::words);
+    for (uint32_t group = 0; group < activeGroups; ++group) {
+        auto count = GetActiveProcessorCount(static_cast<WORD>(group));
+        set.bits[group] = count >= CpuSet::wordBits ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+    }
+    return set;
+}
+
+
+// Windows itself reads TSC_AUX or RDPID here where the CPU has them, but does not document their format.
+static uint32_t systemProcessor() {
+    PROCESSOR_NUMBER number = {};
+    GetCurrentProcessorNumberEx(&number);
+    return CpuSet::index(number.Group, number.Number);
+}
+
+
+static bool rseqAvailable() {
+    return false;
+}
+
+
+static uint32_t rseqProcessor() {
+    return 0;
+}
+
+
+static bool tscAuxAvailable(ProcessorQuery) {
+    return false;
+}
+
+
+static uint32_t rdpidProcessor() {
+    return 0;
+}
+
+
+static uint32_t rdtscpProcessor() {
+    return 0;
+}
+#elif defined(__linux__)
+// Copy set into a dynamically sized cpu_set_t, glibc's fixed cpu_set_t stops at 1024.
+template <typename F>
+inline bool withCpuSet(const CpuSet& set, F&& f) {
+    if (set.empty()) {
+        return false;
+    }
+    auto native = CPU_ALLOC(CpuSet::maxProcessors);
+    auto size = CPU_ALLOC_SIZE(CpuSet::maxProcessors);
+    CPU_ZERO_S(size, native);
+    set.forEach([&](uint32_t processor) { CPU_SET_S(processor, size, native); });
+    auto result = f(size, native);
+    CPU_FREE(native);
+    return result;
+}
+
+
+bool bindThread(std::thread::native_handle_type thread, const CpuSet& set) {
+    return withCpuSet(set, [&](size_t size, cpu_set_t* native) {
+        return pthread_setaffinity_np(thread, size, native) == 0;
+    });
+}
+
+
+bool bindCurrentThread(const CpuSet& set) {
+    return withCpuSet(set, [&](size_t size, cpu_set_t* native) {
+        return sched_setaffinity(0, size, native) == 0;
+    });
+}
+
+
+CpuSet processAffinity() {
+    CpuSet set;
+    auto native = CPU_ALLOC(CpuSet::maxProcessors);
+    auto size = CPU_ALLOC_SIZE(CpuSet::maxProcessors);
+    CPU_ZERO_S(size, native);
+    if (sched_getaffinity(getpid(), size, native) == 0) {
+        for (uint32_t processor = 0; processor < CpuSet::maxProcessors; ++processor) {
+            if (CPU_ISSET_S(processor, size, native)) {
+                set.set(processor);
+            }
+        }
+    }
+    CPU_FREE(native);
+    if (set.empty()) {
+        for (long processor = 0; processor < sysconf(_SC_NPROCESSORS_ONLN); ++processor) {
+            set.set(static_cast<uint32_t>(processor));
+        }
+    }
+    return set;
+}
+
+
+static uint32_t systemProcessor() {
+    auto cpu = sched_getcpu();
+    return cpu < 0 ? 0 : static_cast<uint32_t>(cpu);
+}
+
+
+#if defined(CPU_SET_RSEQ)
+// glibc registers an rseq area for every thread at __rseq_offset from the thread pointer.
+static const volatile struct rseq* rseqArea() {
+#if defined(__x86_64__)
+    const char* threadPointer = nullptr;
+    asm("mov %%fs:0, %0" : "=r"(threadPointer));
+#else
+    auto threadPointer = static_cast<const char*>(__builtin_thread_pointer());
+#endif
+    return reinterpret_cast<const volatile struct rseq*>(threadPointer + __rseq_offset);
+}
+
+
+static bool rseqAvailable() {
+    // Registration failed or was turned off with the glibc.pthread.rseq tunable.
+    return __rseq_size > 0 && static_cast<int32_t>(rseqArea()->cpu_id) >= 0;
+}
+
+
+static uint32_t rseqProcessor() {
+    return rseqArea()->cpu_id;
+}
+#else
+static bool rseqAvailable() {
+    return false;
+}
+
+
+static uint32_t rseqProcessor() {
+    return 0;
+}
+#endif
+
+
+#if defined(__x86_64__) || defined(__i386__)
+// Linux keeps (NUMA node << 12) | processor in TSC_AUX, maxProcessors fits in the low 12 bits.
+constexpr uint32_t tscAuxProcessorMask = 0xFFF;
+
+
+__attribute__((target("rdpid")))
+static uint32_t rdpidProcessor() {
+    return _rdpid_u32() & tscAuxProcessorMask;
+}
+
+
+static uint32_t rdtscpProcessor() {
+    unsigned int aux = 0;
+    __rdtscp(&aux);
+    return aux & tscAuxProcessorMask;
+}
+
+
+static bool tscAuxAvailable(ProcessorQuery query) {
+    unsigned int eax = 0;
+    unsigned int ebx = 0;
+    unsigned int ecx = 0;
+    unsigned int edx = 0;
+    if (query == ProcessorQuery::rdpid) {
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ecx & (1u << 22))) {
+            return false;
+        }
+    }
+    else if (!__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 27))) {
+        return false;
+    }
+
+    // Some hypervisors expose the instructions but leave TSC_AUX at 0, compare with the kernel's answer.
+    // A migration between the reads only costs a retry.
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        auto before = systemProcessor();
+        auto aux = query == ProcessorQuery::rdpid ? rdpidProcessor() : rdtscpProcessor();
+        if (systemProcessor() == before) {
+            return aux == before;
+        }
+    }
+    return false;
+}
+#else
+static bool tscAuxAvailable(ProcessorQuery) {
+    return false;
+}
+
+
+static uint32_t rdpidProcessor() {
+    return 0;
+}
+
+
+static uint32_t rdtscpProcessor() {
+    return 0;
+}
+#endif
+#endif
+
+
+const char* processorQueryName(ProcessorQuery query) {
+    switch (query) {
+    case ProcessorQuery::rseq: return "rseq";
+    case ProcessorQuery::rdpid: return "rdpid";
+    case ProcessorQuery::rdtscp: return "rdtscp";
+    case ProcessorQuery::system: return "system";
+    default: return "unknown";
+    }
+}
+
+
+bool processorQueryAvailable(ProcessorQuery query) {
+    static const auto available = []() {
+        uint32_t bits = 1u << static_cast<uint32_t>(ProcessorQuery::system);
+        if (rseqAvailable()) {
+            bits |= 1u << static_cast<uint32_t>(ProcessorQuery::rseq);
+        }
+        for (auto tscAux : { ProcessorQuery::rdpid, ProcessorQuery::rdtscp }) {
+            if (tscAuxAvailable(tscAux)) {
+                bits |= 1u << static_cast<uint32_t>(tscAux);
+            }
+        }
+        return bits;
+    }();
+    return query < ProcessorQuery::count && ((available >> static_cast<uint32_t>(query)) & 1);
+}
+
+
+ProcessorQuery fastestProcessorQuery() {
+    static const auto fastest = []() {
+        for (uint32_t i = 0; i < static_cast<uint32_t>(ProcessorQuery::count); ++i) {
+            if (processorQueryAvailable(static_cast<ProcessorQuery>(i))) {
+                return static_cast<ProcessorQuery>(i);
+            }
+        }
+        return ProcessorQuery::system;
+    }();
+    return fastest;
+}
+
+
+uint32_t currentProcessor(ProcessorQuery query) {
+    switch (query) {
+    case ProcessorQuery::rseq: return rseqProcessor();
+    case ProcessorQuery::rdpid: return rdpidProcessor();
+    case ProcessorQuery::rdtscp: return rdtscpProcessor();
+    default: return systemProcessor();
+    }
+}
+
+
+uint32_t currentProcessor() {
+    static const auto query = fastestProcessorQuery();
+    return currentProcessor(query);
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+/* Fixed-size logical processor bitmask.
+   Bit index is sysProcessorGroup * 64 + sysLogicalProcessor,
+   on Linux the processor group is always 0 so it is the plain cpu number.
+   Words are plain arrays so the set algebra below vectorizes. */
+struct CpuSet {
+    /* Highest number of logical processors a set can hold. */
+    static constexpr uint32_t maxProcessors = 2048;
+    /* Bits per word, also the size of a Windows processor group. */
+    static constexpr uint32_t wordBits = 64;
+    static constexpr uint32_t words = maxProcessors / wordBits;
+
+    alignas(64) uint64_t bits[words] = {};
+
+    /* Bit index of a system logical processor. */
+    static constexpr uint32_t index(uint32_t sysProcessorGroup, uint32_t sysLogicalProcessor) {
+        return sysProcessorGroup * wordBits + sysLogicalProcessor;
+    }
+
+    /* Build a set from system logical processors of one processor group. */
+    static CpuSet from(uint32_t sysProcessorGroup, const std::vector<uint32_t>& sysLogicalProcessors) {
+        CpuSet set;
+        for (auto processor : sysLogicalProcessors) {
+            set.set(index(sysProcessorGroup, processor));
+        }
+        return set;
+    }
+
+    /* Build a set from the kernel cpulist format, e.g. "0-3,8,10-11". */
+    static CpuSet fromList(const char* list) {
+        CpuSet set;
+        while (*list) {
+            char* end = nullptr;
+            auto first = std::strtoul(list, &end, 10);
+            if (end == list) {
+                break;
+            }
+            auto last = first;
+            if (*end == '-') {
+                list = end + 1;
+                last = std::strtoul(list, &end, 10);
+            }
+            for (auto i = first; i <= last && i < maxProcessors; ++i) {
+                set.set(static_cast<uint32_t>(i));
+            }
+            list = *end == ',' ? end + 1 : end;
+        }
+        return set;
+    }
+
+    void set(uint32_t i) {
+        if (i < maxProcessors) {
+            bits[i / wordBits] |= uint64_t(1) << (i % wordBits);
+        }
+    }
+
+    void reset(uint32_t i) {
+        if (i < maxProcessors) {
+            bits[i / wordBits] &= ~(uint64_t(1) << (i % wordBits));
+        }
+    }
+
+    bool test(uint32_t i) const {
+        return i < maxProcessors && (bits[i / wordBits] >> (i % wordBits)) & 1;
+    }
+
+    void clear() {
+        for (uint32_t w = 0; w < words; ++w) {
+            bits[w] = 0;
+        }
+    }
+
+    /* Number of logical processors in the set. */
+    uint32_t count() const {
+        uint32_t result = 0;
+        for (uint32_t w = 0; w < words; ++w) {
+            result += popcount(bits[w]);
+        }
+        return result;
+    }
+
+    bool empty() const {
+        uint64_t any = 0;
+        for (uint32_t w = 0; w < words; ++w) {
+            any |= bits[w];
+        }
+        return any == 0;
+    }
+
+    /* Lowest bit index at or after i, maxProcessors if there is none. */
+    uint32_t next(uint32_t i) const {
+        if (i >= maxProcessors) {
+            return maxProcessors;
+        }
+        auto w = i / wordBits;
+        auto word = bits[w] & (~uint64_t(0) << (i % wordBits));
+        while (!word) {
+            if (++w == words) {
+                return maxProcessors;
+            }
+            word = bits[w];
+        }
+        return w * wordBits + countTrailingZeros(word);
+    }
+
+    /* Lowest bit index, maxProcessors if the set is empty. */
+    uint32_t first() const { return next(0); }
+
+    bool intersects(const CpuSet& other) const {
+        uint64_t any = 0;
+        for (uint32_t w = 0; w < words; ++w) {
+            any |= bits[w] & other.bits[w];
+        }
+        return any != 0;
+    }
+
+    /* True if every processor of other is also in this set. */
+    bool contains(const CpuSet& other) const {
+        uint64_t missing = 0;
+        for (uint32_t w = 0; w < words; ++w) {
+            missing |= other.bits[w] & ~bits[w];
+        }
+        return missing == 0;
+    }
+
+    CpuSet& operator |= (const CpuSet& other) {
+        for (uint32_t w = 0; w < words; ++w) {
+            bits[w] |= other.bits[w];
+        }
+        return *this;
+    }
+
+    CpuSet& operator &= (const CpuSet& other) {
+        for (uint32_t w = 0; w < words; ++w) {
+            bits[w] &= other.bits[w];
+        }
+        return *this;
+    }
+
+    CpuSet& operator ^= (const CpuSet& other) {
+        for (uint32_t w = 0; w < words; ++w) {
+            bits[w] ^= other.bits[w];
+        }
+        return *this;
+    }
+
+    /* Set difference. */
+    CpuSet& operator -= (const CpuSet& other) {
+        for (uint32_t w = 0; w < words; ++w) {
+            bits[w] &= ~other.bits[w];
+        }
+        return *this;
+    }
+
+    friend CpuSet operator | (const CpuSet& a, const CpuSet& b) {
+        CpuSet result = a;
+        return result |= b;
+    }
+    friend CpuSet operator & (const CpuSet& a, const CpuSet& b) {
+        CpuSet result = a;
+        return result &= b;
+    }
+    friend CpuSet operator ^ (const CpuSet& a, const CpuSet& b) {
+        CpuSet result = a;
+        return result ^= b;
+    }
+    friend CpuSet operator - (const CpuSet& a, const CpuSet& b) {
+        CpuSet result = a;
+        return result -= b;
+    }
+
+    friend bool operator == (const CpuSet& a, const CpuSet& b) {
+        uint64_t diff = 0;
+        for (uint32_t w = 0; w < words; ++w) {
+            diff |= a.bits[w] ^ b.bits[w];
+        }
+        return diff == 0;
+    }
+    friend bool operator != (const CpuSet& a, const CpuSet& b) { return !(a == b); }
+
+    /* Forward iterator over the set bit indices. */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = uint32_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const uint32_t*;
+        using reference = uint32_t;
+
+        const_iterator(const CpuSet* set, uint32_t position) : set(set), position(position) {}
+
+        uint32_t operator * () const { return position; }
+        const_iterator& operator ++ () {
+            position = set->next(position + 1);
+            return *this;
+        }
+        const_iterator operator ++ (int) {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+        bool operator == (const const_iterator& other) const { return position == other.position; }
+        bool operator != (const const_iterator& other) const { return position != other.position; }
+
+    private:
+        const CpuSet* set;
+        uint32_t position;
+    };
+
+    const_iterator begin() const { return const_iterator(this, first()); }
+    const_iterator end() const { return const_iterator(this, maxProcessors); }
+
+    /* Call f(index) for every set bit, cheaper than the iterator in tight loops. */
+    template <typename F>
+    void forEach(F&& f) const {
+        for (uint32_t w = 0; w < words; ++w) {
+            auto word = bits[w];
+            while (word) {
+                f(w * wordBits + countTrailingZeros(word));
+                word &= word - 1;
+            }
+        }
+    }
+
+    static uint32_t popcount(uint64_t x) {
+#if defined(_MSC_VER)
+        return static_cast<uint32_t>(__popcnt64(x));
+#else
+        return static_cast<uint32_t>(__builtin_popcountll(x));
+#endif
+    }
+
+    static uint32_t countTrailingZeros(uint64_t x) {
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanForward64(&index, x);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(__builtin_ctzll(x));
+#endif
+    }
+};
+
+
+/* Pin the calling thread onto set, returns false if the system refused it.
+   Windows can only bind a thread inside one processor group,
+   the group of the lowest processor in set is used. */
+bool bindCurrentThread(const CpuSet& set);
+
+/* Pin a std::thread onto set, same rules as bindCurrentThread. */
+bool bindThread(std::thread::native_handle_type thread, const CpuSet& set);
+
+/* Logical processors the process may run on, every active processor if the system cannot tell.
+   On Linux this is the affinity of the main thread, which cgroup cpuset changes update. */
+CpuSet processAffinity();
+
+/* Ways to ask which processor the calling thread runs on. */
+enum class ProcessorQuery : uint32_t {
+    /* cpu_id of the thread's rseq area, kept up to date by the kernel on every migration (Linux 4.18, glibc 2.35). */
+    rseq,
+    /* RDPID reads TSC_AUX, which Linux sets to the processor number on every processor. */
+    rdpid,
+    /* RDTSCP, the same TSC_AUX on CPUs without RDPID, it also reads the TSC and waits for earlier instructions. */
+    rdtscp,
+    /* sched_getcpu() through the vDSO on Linux, GetCurrentProcessorNumberEx() on Windows. */
+    system,
+    count,
+};
+
+/* Name of a query, for reports. */
+const char* processorQueryName(ProcessorQuery query);
+
+/* True if query works on this machine and thread library. system always does. */
+bool processorQueryAvailable(ProcessorQuery query);
+
+/* The first available query in declaration order, chosen once per process. */
+ProcessorQuery fastestProcessorQuery();
+
+/* CpuSet::index of the processor the calling thread runs on through query, which must be available. */
+uint32_t currentProcessor(ProcessorQuery query);
+
+/* CpuSet::index of the processor the calling thread runs on through fastestProcessorQuery(), 0 if the system cannot tell.
+   A few ns with rseq or RDPID. The thread may have moved on by the time the caller looks at it. */
+uint32_t currentProcessor();
@@ -1,14 +1,81 @@
+#if defined(_WIN32)
 #define NOMINMAX
+#endif
 
 #include <algorithm>
+#include <cstdlib>
 #include <iterator>
 #include <map>
+#include <thread>
+#include <tuple>
 
+#if defined(_WIN32)
 #include <Windows.h>
+#elif defined(__linux__)
+#include <cctype>
+#include <cstdio>
+#include <cstring>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "CoreLatency.h"
 #include "CpuTopology.h"
+#include "CpuidTopology.h"
+#include "NumaProbe.h"
+#include "TopologySnapshot.h"
+
+
+template <typename T1, typename T2>
+inline uint64_t makeUInt64(T1 high, T2 low) {
+    return (static_cast<uint64_t>(high) << 32) | static_cast<uint64_t>(low);
+}
+
+
+// Logical processor -> core index, indexed by CpuSet::index.
+// The consolidation loops do one array access per processor instead of a tree lookup.
+struct ProcessorMappings {
+    static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> cores;
+    uint32_t mapped = 0;
+
+    void set(uint32_t sysProcessorGroup, uint32_t sysLogicalProcessor, uint32_t core) {
+        auto i = CpuSet::index(sysProcessorGroup, sysLogicalProcessor);
+        if (i >= cores.size()) {
+            cores.resize(i + 1, none);
+        }
+        mapped += cores[i] == none;
+        cores[i] = core;
+    }
+
+    // Core of a logical processor, none if it is not mapped.
+    uint32_t find(uint32_t sysProcessorGroup, uint32_t sysLogicalProcessor) const {
+        auto i = CpuSet::index(sysProcessorGroup, sysLogicalProcessor);
+        return i < cores.size() ? cores[i] : none;
+    }
+
+    // Number of mapped logical processors.
+    uint32_t size() const { return mapped; }
+};
 
 
+// "level - type" -> cache of each logical processor, indexed by CpuSet::index.
+using ProcessorCaches = std::vector<std::map<uint64_t, CpuTopology::CacheInfo>>;
+
+
+inline std::map<uint64_t, CpuTopology::CacheInfo>& processorCaches(ProcessorCaches& caches, uint32_t sysProcessorGroup, uint32_t sysLogicalProcessor) {
+    auto i = CpuSet::index(sysProcessorGroup, sysLogicalProcessor);
+    if (i >= caches.size()) {
+        caches.resize(i + 1);
+    }
+    return caches[i];
+}
+
+
+#if defined(_WIN32)
 template <typename T, typename C>
 inline void getSetBitPositions(T x, C& container) {
     while (x) {
@@ -18,17 +85,11 @@ inline void getSetBitPositions(T x, C& container) {
 }
 
 
-template <typename T1, typename T2>
-inline uint64_t makeUInt64(T1 high, T2 low) {
-    return (static_cast<uint64_t>(high) << 32) | static_cast<uint64_t>(low);
-}
-
-
 void GetProcessorInfo(
     CpuTopology::TopologyInfo& Topology,
     std::map<uint64_t, CpuTopology::CacheInfo>& cacheMap,
-    std::map<uint64_t, std::map<uint64_t, CpuTopology::CacheInfo>>& processorCache,
-    std::map<uint64_t, uint32_t>& processorMappings) {
+    ProcessorCaches& processorCache,
+    ProcessorMappings& processorMappings) {
     DWORD len = 0;
     if (GetLogicalProcessorInformationEx(RelationAll, nullptr, &len) == FALSE &&
         GetLastError() == ERROR_INSUFFICIENT_BUFFER && 0 < len) {
@@ -50,7 +111,7 @@ void GetProcessorInfo(
 
                     // logical processor -> physical core map.
                     for (auto processor : core.sysLogicalProcessors) {
-                        processorMappings[makeUInt64(core.sysProcessorGroup, processor)] = core.id;
+                        processorMappings.set(core.sysProcessorGroup, processor, core.id);
                     }
 
                     Topology.cores.push_back(std::move(core));
@@ -82,7 +143,7 @@ void GetProcessorInfo(
                     getSetBitPositions(pi->Cache.GroupMask.Mask, cacheProcessorMap);
 
                     for (auto processor : cacheProcessorMap) {
-                        processorCache[makeUInt64(cachePorcessorGroup, processor)][cacheKey] = std::move(cache);
+                        processorCaches(processorCache, cachePorcessorGroup, processor)[cacheKey] = cache;
                     }
 
                     // core complex means the SoC which connects to the same L3 data cache. 
@@ -101,7 +162,10 @@ void GetProcessorInfo(
                     numaNode.sysProcessorGroup = pi->NumaNode.GroupMask.Group;
                     getSetBitPositions(pi->NumaNode.GroupMask.Mask, numaNode.sysLogicalProcessors);
                     GetNumaAvailableMemoryNodeEx(static_cast<USHORT>(numaNode.sysNumaNode), &numaNode.availableMemory);
-                    Topology.numaNodes.push_back(std::move(numaNode));
+                    // CPU-less nodes are memory nodes only, see GetMemoryNodes().
+                    if (!numaNode.sysLogicalProcessors.empty()) {
+                        Topology.numaNodes.push_back(std::move(numaNode));
+                    }
                 }
                 else if (pi->Relationship == RelationProcessorPackage) {
                     CpuTopology::TopologyInfo::SocketInfo socket;
@@ -126,7 +190,7 @@ void GetProcessorInfo(
 
 void GetCPPCRanking(
     CpuTopology::TopologyInfo& Topology,
-    const std::map<uint64_t, uint32_t>& processorMappings) {
+    const ProcessorMappings& processorMappings) {
     ULONG returnedLength = 0;
     if (GetSystemCpuSetInformation(NULL, 0, &returnedLength, NULL, 0) == FALSE &&
         GetLastError() == ERROR_INSUFFICIENT_BUFFER && 0 < returnedLength) {
@@ -139,9 +203,8 @@ void GetCPPCRanking(
                 if (nullptr == pi)
                     break;
                 if (CpuSetInformation == pi->Type) {
-                    auto key = makeUInt64(pi->CpuSet.Group, pi->CpuSet.LogicalProcessorIndex);
-                    if (processorMappings.count(key)) {
-                        auto coreID = processorMappings.at(key);
+                    auto coreID = processorMappings.find(pi->CpuSet.Group, pi->CpuSet.LogicalProcessorIndex);
+                    if (coreID != ProcessorMappings::none) {
                         decltype(auto) core = Topology.cores[coreID];
                         core.schedulingClass = pi->CpuSet.SchedulingClass;
                     }
@@ -153,172 +216,1853 @@ void GetCPPCRanking(
 }
 
 
-void ConsolidateCachesToCores(
-    CpuTopology::TopologyInfo& Topology,
-    const std::map<uint64_t, std::map<uint64_t, CpuTopology::CacheInfo>>& processorCache) {
-    for (auto& core : Topology.cores) {
-        for (auto processor : core.sysLogicalProcessors) {
-            auto key = makeUInt64(core.sysProcessorGroup, processor);
-            if (processorCache.count(key)) {
-                std::transform(processorCache.at(key).cbegin(), processorCache.at(key).cend(),
-                    std::back_inserter(core.caches), [](auto& kv) { return kv.second; });
-                break;
+// Every NUMA node with memory, linked to its node with processors.
+// Windows reports no total sizes, distances, memory tiers, HMAT data or per-node huge page pools.
+void GetMemoryNodes(CpuTopology::TopologyInfo& Topology) {
+    ULONG highestNode = 0;
+    if (!GetNumaHighestNodeNumber(&highestNode)) {
+        return;
+    }
+    for (ULONG node = 0; node <= highestNode; ++node) {
+        CpuTopology::TopologyInfo::MemoryNodeInfo memoryNode;
+        memoryNode.sysNumaNode = node;
+        for (auto& numaNode : Topology.numaNodes) {
+            if (numaNode.sysNumaNode == node) {
+                memoryNode.numaNode = &numaNode;
             }
         }
+        ULONGLONG available = 0;
+        if (!GetNumaAvailableMemoryNodeEx(static_cast<USHORT>(node), &available) || (!available && !memoryNode.numaNode)) {
+            continue;
+        }
+        memoryNode.id = static_cast<uint32_t>(Topology.memoryNodes.size());
+        memoryNode.nearestNumaNode = memoryNode.numaNode;
+        memoryNode.availableMemory = available;
+        Topology.memoryNodes.push_back(std::move(memoryNode));
     }
 }
 
 
-void ConsolidateComplexGroups(
-    CpuTopology::TopologyInfo& Topology,
-    const std::map<uint64_t, uint32_t>& processorMappings) {
-    // complexGroup.cores contains logical processors now, let it become physical cores.
-    for (auto& complexGroup : Topology.complexGroups) {
-        std::vector<CpuTopology::TopologyInfo::CoreInfo*> newCores;
-        for (auto processor : complexGroup.sysLogicalProcessors) {
-            auto key = makeUInt64(complexGroup.sysProcessorGroup, processor);
-            auto coreID = processorMappings.at(key);
-            decltype(auto) core = Topology.cores[coreID];
+// Free memory of every node now, for a topology restored from a snapshot.
+void RefreshFreeMemory(CpuTopology::TopologyInfo& Topology) {
+    for (auto& numaNode : Topology.numaNodes) {
+        GetNumaAvailableMemoryNodeEx(static_cast<USHORT>(numaNode.sysNumaNode), &numaNode.availableMemory);
+    }
+    for (auto& memoryNode : Topology.memoryNodes) {
+        GetNumaAvailableMemoryNodeEx(static_cast<USHORT>(memoryNode.sysNumaNode), &memoryNode.availableMemory);
+    }
+}
 
-            if (!core.complexGroup) {
-                core.complexGroup = &complexGroup;
-                newCores.emplace_back(&core);
-            }
+
+// Hard CPU rate cap of the job object the process runs in, in logical processors, 0 when there is none.
+float GetJobCpuQuota(uint32_t logicalProcessors) {
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION info = {};
+    if (!QueryInformationJobObject(nullptr, JobObjectCpuRateControlInformation, &info, sizeof(info), nullptr)) {
+        return 0.0f;
+    }
+    const DWORD hardCap = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+    if ((info.ControlFlags & hardCap) != hardCap || (info.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_WEIGHT_BASED)) {
+        return 0.0f;
+    }
+    // CpuRate is in 1/100 of a percent of all processors.
+    return static_cast<float>(info.CpuRate) / 10000.0f * static_cast<float>(logicalProcessors);
+}
+
+
+#elif defined(__linux__)
+// Large enough for the cpulist of a 2048 logical processor host and /proc/meminfo.
+constexpr size_t sysFileBufferSize = 16384;
+
+
+// Read a whole sysfs/procfs file relative to dir with a single read(2).
+// std::ifstream allocates per file which dominates discovery on many-core hosts.
+inline bool readSysFile(int dir, const char* path, std::vector<char>& buffer) {
+    auto fd = openat(dir, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    auto len = read(fd, buffer.data(), buffer.size() - 1);
+    close(fd);
+    if (len < 0) {
+        return false;
+    }
+    buffer[len] = '\0';
+    return true;
+}
+
+
+inline bool readSysFile(const std::string& path, std::vector<char>& buffer) {
+    return readSysFile(AT_FDCWD, path.c_str(), buffer);
+}
+
+
+inline bool readSysUInt(int dir, const char* path, std::vector<char>& buffer, uint32_t& value) {
+    if (!readSysFile(dir, path, buffer)) {
+        return false;
+    }
+    value = static_cast<uint32_t>(std::strtol(buffer.data(), nullptr, 10));
+    return true;
+}
+
+
+// Parse the kernel cpulist format, e.g. "0-3,8,10-11".
+template <typename C>
+inline void parseCpuList(const char* str, C& container) {
+    while (*str) {
+        char* end = nullptr;
+        auto first = std::strtoul(str, &end, 10);
+        if (end == str) {
+            break;
         }
-        complexGroup.cores = std::move(newCores);
+        auto last = first;
+        if (*end == '-') {
+            str = end + 1;
+            last = std::strtoul(str, &end, 10);
+        }
+        for (auto i = first; i <= last; ++i) {
+            container.push_back(static_cast<uint32_t>(i));
+        }
+        str = *end == ',' ? end + 1 : end;
     }
 }
 
 
-void ConsolidateNUMAs(
-    CpuTopology::TopologyInfo& Topology,
-    const std::map<uint64_t, uint32_t>& processorMappings) {
-    // numaNode.cores contains logical processors now, let it become physical cores.
-    for (auto& numaNode : Topology.numaNodes) {
-        std::vector<CpuTopology::TopologyInfo::CoreInfo*> newCores;
-        std::vector<CpuTopology::TopologyInfo::ComplexGroupInfo*> newComplexGroups;
-        for (auto processor : numaNode.sysLogicalProcessors) {
-            auto key = makeUInt64(numaNode.sysProcessorGroup, processor);
-            auto coreID = processorMappings.at(key);
-            decltype(auto) core = Topology.cores[coreID];
+// Get the value of label from a meminfo style file in KBs.
+inline uint64_t parseMemInfo(const char* str, const char* label) {
+    auto pos = std::strstr(str, label);
+    return pos ? std::strtoull(pos + std::strlen(label), nullptr, 10) : 0;
+}
 
-            if (!core.numaNode) {
-                core.numaNode = &numaNode;
-                core.sysNumaNode = numaNode.sysNumaNode;
-                newCores.emplace_back(&core);
 
-                if (!core.complexGroup->numaNode) {
-                    core.complexGroup->numaNode = &numaNode;
-                    core.complexGroup->sysNumaNode = numaNode.sysNumaNode;
-                    newComplexGroups.emplace_back(core.complexGroup);
-                }
+inline uint64_t readSysUInt64(const std::string& path, std::vector<char>& buffer) {
+    return readSysFile(path, buffer) ? std::strtoull(buffer.data(), nullptr, 10) : 0;
+}
+
+
+// Sorted entry names of a directory, hidden ones skipped.
+inline std::vector<std::string> listDirectory(const std::string& path) {
+    std::vector<std::string> names;
+    if (auto dir = opendir(path.c_str())) {
+        while (auto entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                names.push_back(entry->d_name);
             }
         }
-        numaNode.cores = std::move(newCores);
-        numaNode.complexGroups = std::move(newComplexGroups);
+        closedir(dir);
     }
+    std::sort(names.begin(), names.end());
+    return names;
 }
 
 
-void ConsolidateSockets(
+// Huge page pools under path/hugepages, a node directory or /sys/kernel/mm, by ascending page size.
+std::vector<CpuTopology::TopologyInfo::HugePageInfo> ReadHugePages(const std::string& path, std::vector<char>& buffer) {
+    std::vector<CpuTopology::TopologyInfo::HugePageInfo> pools;
+    const auto hugePagesPath = path + "hugepages/";
+    for (const auto& name : listDirectory(hugePagesPath)) {
+        // "hugepages-2048kB"
+        if (name.compare(0, 10, "hugepages-") != 0) {
+            continue;
+        }
+        CpuTopology::TopologyInfo::HugePageInfo pool;
+        pool.size = std::strtoull(name.c_str() + 10, nullptr, 10) * 1024;
+        pool.total = readSysUInt64(hugePagesPath + name + "/nr_hugepages", buffer);
+        pool.free = readSysUInt64(hugePagesPath + name + "/free_hugepages", buffer);
+        pools.push_back(pool);
+    }
+    std::sort(pools.begin(), pools.end(), [](const auto& a, const auto& b) { return a.size < b.size; });
+    return pools;
+}
+
+
+// Root of a captured sysfs/procfs tree, empty means the live system.
+inline std::string defaultSysRoot() {
+    auto root = std::getenv("CPU_TOPOLOGY_ROOT");
+    return root ? root : "";
+}
+
+
+void GetProcessorInfo(
     CpuTopology::TopologyInfo& Topology,
-    const std::map<uint64_t, uint32_t>& processorMappings) {
-    // socket.processorStruct contains logical processors now, let it become physical cores.
-    for (auto& socket : Topology.sockets) {
-        std::vector<CpuTopology::TopologyInfo::CoreInfo*> newCores;
-        std::vector<CpuTopology::TopologyInfo::ComplexGroupInfo*> newComplexGroups;
-        std::vector<CpuTopology::TopologyInfo::NumaNodeInfo*> newNumaNodes;
-        std::vector<uint32_t> newsysNumaNodes;
-        for (auto processorStruct : socket.processorsStructs) {
-            for (auto processor : processorStruct.sysLogicalProcessors) {
-                auto key = makeUInt64(processorStruct.sysProcessorGroup, processor);
-                auto coreID = processorMappings.at(key);
-                decltype(auto) core = Topology.cores[coreID];
+    std::map<uint64_t, CpuTopology::CacheInfo>& cacheMap,
+    ProcessorCaches& processorCache,
+    ProcessorMappings& processorMappings,
+    const std::string& root,
+    std::vector<char>& buffer) {
+    // Every file below is opened relative to the cpu directory to save the path walk.
+    const auto cpuRoot = root + "/sys/devices/system/cpu";
+    auto cpuDir = open(cpuRoot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cpuDir < 0) {
+        return;
+    }
 
-                if (!core.socket) {
-                    core.socket = &socket;
-                    newCores.emplace_back(&core);
+    std::vector<uint32_t> online;
+    if (readSysFile(cpuDir, "online", buffer)) {
+        parseCpuList(buffer.data(), online);
+    }
+    if (online.empty()) {
+        close(cpuDir);
+        return;
+    }
 
-                    if (!core.complexGroup->socket) {
-                        core.complexGroup->socket = &socket;
-                        newComplexGroups.emplace_back(core.complexGroup);
-                    }
+    std::vector<bool> onlineMask(online.back() + 1);
+    for (auto processor : online) {
+        onlineMask[processor] = true;
+    }
+    auto removeOffline = [&](std::vector<uint32_t>& processors) {
+        processors.erase(std::remove_if(processors.begin(), processors.end(),
+            [&](uint32_t p) { return p >= onlineMask.size() || !onlineMask[p]; }), processors.end());
+    };
 
-                    if (!core.numaNode->socket) {
-                        core.numaNode->socket = &socket;
-                        newNumaNodes.emplace_back(core.numaNode);
-                        newsysNumaNodes.emplace_back(core.sysNumaNode);
-                    }
+    // Logical processor -> core id and socket id, cheaper than processorMappings while walking sibling lists.
+    std::vector<uint32_t> processorCores(onlineMask.size(), std::numeric_limits<uint32_t>::max());
+    std::vector<uint32_t> processorSockets(onlineMask.size(), std::numeric_limits<uint32_t>::max());
+
+    // Logical processors already covered by a cache instance of each cache index.
+    // Only the first core behind a shared cache reads it, e.g. once per L3 instead of once per core.
+    std::vector<std::vector<bool>> cacheCovered;
+
+    // "index - size" -> cache attributes. Every core exposes the same cache indices,
+    // so level, type, ways and line are only read again when the size differs (hybrid cores).
+    std::map<uint64_t, CpuTopology::CacheInfo> cacheAttributes;
+
+    // Cores of one kind have the same private caches, the first core of a kind reads them for all.
+    // The kind is the hybrid core type when the kernel has one, else cpu_capacity (arm64 big.LITTLE), else one kind.
+    CpuSet efficientCores;
+    if (readSysFile(root + "/sys/devices/cpu_atom/cpus", buffer)) {
+        efficientCores = CpuSet::fromList(buffer.data());
+    }
+    char path[64];
+    std::snprintf(path, sizeof(path), "cpu%u/cpu_capacity", online.front());
+    uint32_t capacity = 0;
+    const auto capacities = efficientCores.empty() && readSysUInt(cpuDir, path, buffer, capacity);
+    auto coreKind = [&](uint32_t cpu) {
+        if (!efficientCores.empty()) {
+            return efficientCores.test(cpu) ? 1u : 0u;
+        }
+        uint32_t kind = 0;
+        if (capacities) {
+            std::snprintf(path, sizeof(path), "cpu%u/cpu_capacity", cpu);
+            readSysUInt(cpuDir, path, buffer, kind);
+        }
+        return kind;
+    };
+    // Cache indices of the first core of each kind: size, and whether it is private to the core.
+    struct IndexLayout {
+        bool isPrivate = false;
+        unsigned long size = 0;
+    };
+    std::map<uint32_t, std::vector<IndexLayout>> cacheLayouts;
+
+    std::vector<uint32_t> processors;
+    for (auto cpu : online) {
+        if (processorCores[cpu] != std::numeric_limits<uint32_t>::max()) {
+            continue;
+        }
+
+        CpuTopology::TopologyInfo::CoreInfo core;
+        core.id = static_cast<uint32_t>(Topology.cores.size());
+        core.sysProcessorGroup = 0;
+        std::snprintf(path, sizeof(path), "cpu%u/topology/core_cpus_list", cpu);
+        auto found = readSysFile(cpuDir, path, buffer);
+        if (!found) {
+            std::snprintf(path, sizeof(path), "cpu%u/topology/thread_siblings_list", cpu);
+            found = readSysFile(cpuDir, path, buffer);
+        }
+        if (found) {
+            parseCpuList(buffer.data(), core.sysLogicalProcessors);
+            removeOffline(core.sysLogicalProcessors);
+        }
+        if (core.sysLogicalProcessors.empty()) {
+            core.sysLogicalProcessors.push_back(cpu);
+        }
+        core.SMT = core.sysLogicalProcessors.size() > 1;
+
+        // logical processor -> physical core map.
+        for (auto processor : core.sysLogicalProcessors) {
+            processorCores[processor] = core.id;
+            processorMappings.set(core.sysProcessorGroup, processor, core.id);
+        }
+
+        // The first core of each package creates the socket from the package sibling list.
+        if (processorSockets[cpu] == std::numeric_limits<uint32_t>::max()) {
+            CpuTopology::TopologyInfo::SocketInfo socket;
+            socket.id = static_cast<uint32_t>(Topology.sockets.size());
+            socket.processorsStructs.resize(1);
+            socket.processorsStructs[0].sysProcessorGroup = 0;
+            auto& socketProcessors = socket.processorsStructs[0].sysLogicalProcessors;
+
+            std::snprintf(path, sizeof(path), "cpu%u/topology/package_cpus_list", cpu);
+            found = readSysFile(cpuDir, path, buffer);
+            if (!found) {
+                std::snprintf(path, sizeof(path), "cpu%u/topology/core_siblings_list", cpu);
+                found = readSysFile(cpuDir, path, buffer);
+            }
+            if (found) {
+                parseCpuList(buffer.data(), socketProcessors);
+                removeOffline(socketProcessors);
+            }
+            if (socketProcessors.empty()) {
+                socketProcessors = online;
+            }
+            for (auto processor : socketProcessors) {
+                processorSockets[processor] = socket.id;
+            }
+            Topology.sockets.push_back(std::move(socket));
+        }
+
+        // SMT siblings share the same caches, reading the first one is enough.
+        // A known kind copies its private caches and stops at its index count instead of probing past it.
+        auto kind = coreKind(cpu);
+        const auto known = cacheLayouts.count(kind) != 0;
+        auto& layout = cacheLayouts[kind];
+        for (uint32_t index = 0; !known || index < layout.size(); ++index) {
+            if (index == cacheCovered.size()) {
+                cacheCovered.emplace_back(onlineMask.size());
+            }
+            if (cacheCovered[index][cpu]) {
+                if (!known) {
+                    layout.emplace_back();
+                }
+                continue;
+            }
+
+            unsigned long size = 0;
+            const auto copied = known && layout[index].isPrivate;
+            if (copied) {
+                size = layout[index].size;
+            }
+            else {
+                std::snprintf(path, sizeof(path), "cpu%u/cache/index%u/size", cpu, index);
+                if (!readSysFile(cpuDir, path, buffer)) {
+                    break;
+                }
+                char* unit = nullptr;
+                size = std::strtoul(buffer.data(), &unit, 10);
+                if (*unit == 'K') {
+                    size *= 1024;
+                }
+                else if (*unit == 'M') {
+                    size *= 1024 * 1024;
+                }
+            }
 
+            auto& attributes = cacheAttributes[makeUInt64(index, size)];
+            if (attributes.level == std::numeric_limits<uint32_t>::max()) {
+                std::snprintf(path, sizeof(path), "cpu%u/cache/index%u/level", cpu, index);
+                readSysUInt(cpuDir, path, buffer, attributes.level);
+                std::snprintf(path, sizeof(path), "cpu%u/cache/index%u/ways_of_associativity", cpu, index);
+                readSysUInt(cpuDir, path, buffer, attributes.associativity);
+                std::snprintf(path, sizeof(path), "cpu%u/cache/index%u/coherency_line_size", cpu, index);
+                readSysUInt(cpuDir, path, buffer, attributes.line);
+                std::snprintf(path, sizeof(path), "cpu%u/cache/index%u/type", cpu, index);
+                if (readSysFile(cpuDir, path, buffer)) {
+                    if (std::strncmp(buffer.data(), "Unified", 7) == 0) {
+                        attributes.type = CpuTopology::CacheType::unified;
+                    }
+                    else if (std::strncmp(buffer.data(), "Instruction", 11) == 0) {
+                        attributes.type = CpuTopology::CacheType::instruction;
+                    }
+                    else if (std::strncmp(buffer.data(), "Data", 4) == 0) {
+                        attributes.type = CpuTopology::CacheType::data;
+                    }
                 }
             }
+
+            processors.clear();
+            std::snprintf(path, sizeof(path), "cpu%u/cache/index%u/shared_cpu_list", cpu, index);
+            if (!copied && readSysFile(cpuDir, path, buffer)) {
+                parseCpuList(buffer.data(), processors);
+                removeOffline(processors);
+            }
+            if (processors.empty()) {
+                processors = core.sysLogicalProcessors;
+            }
+            if (!known) {
+                layout.push_back({ processors == core.sysLogicalProcessors, size });
+            }
+            for (auto processor : processors) {
+                cacheCovered[index][processor] = true;
+            }
+
+            CpuTopology::CacheInfo cache = attributes;
+            cache.size = static_cast<uint32_t>(size);
+            cache.shared = static_cast<uint32_t>(processors.size());
+
+            // bind cache onto "logical core - group" and "level - type" map.
+            auto cacheKey = makeUInt64(cache.level, cache.type);
+            if (cacheMap.count(cacheKey)) {
+                cacheMap[cacheKey] += cache;
+            }
+            else {
+                cacheMap[cacheKey] = cache;
+            }
+
+            for (auto processor : processors) {
+                processorCaches(processorCache, 0, processor)[cacheKey] = cache;
+            }
+
+            // core complex means the SoC which connects to the same L3 data cache.
+            if (cache.level == 3 && (cache.type == CpuTopology::CacheType::data || cache.type == CpuTopology::CacheType::unified)) {
+                CpuTopology::TopologyInfo::ComplexGroupInfo complexGroup;
+                complexGroup.id = static_cast<uint32_t>(Topology.complexGroups.size());
+                complexGroup.sysProcessorGroup = 0;
+                complexGroup.sysLogicalProcessors = processors;
+                Topology.complexGroups.push_back(std::move(complexGroup));
+            }
         }
-        // Consolidate socket
-        socket.cores = std::move(newCores);
-        socket.complexGroups = std::move(newComplexGroups);
-        socket.numaNodes = std::move(newNumaNodes);
-        socket.sysNumaNodes = std::move(newsysNumaNodes);
+
+        Topology.cores.push_back(std::move(core));
     }
-}
+    close(cpuDir);
 
+    // Some VMs and embedded parts export no L3, let every socket be a complex group.
+    if (Topology.complexGroups.empty()) {
+        for (const auto& socket : Topology.sockets) {
+            CpuTopology::TopologyInfo::ComplexGroupInfo complexGroup;
+            complexGroup.id = static_cast<uint32_t>(Topology.complexGroups.size());
+            complexGroup.sysProcessorGroup = 0;
+            complexGroup.sysLogicalProcessors = socket.processorsStructs[0].sysLogicalProcessors;
+            Topology.complexGroups.push_back(std::move(complexGroup));
+        }
+    }
+}
 
-CpuTopology::CpuTopology() {
-    // Get basic processor information.
-    processorGroups = GetActiveProcessorGroupCount();
-    logicalProcessors = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
 
-    /* Get CPU family from cpuid. */
-    getCPUidFamily(family, model);
+// Replace every known value by its class, 0 for the lowest. A value within 1/tolerance of the lowest value
+// of the current class joins it, a tolerance of 0 gives every distinct value its own class.
+inline void RankClasses(std::vector<uint32_t>& values, uint32_t tolerance) {
+    constexpr auto none = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> sorted;
+    for (auto value : values) {
+        if (value != none) {
+            sorted.push_back(value);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end());
 
-    // Get CPU name from cpuid or the registry.
-    getCPUidName(name);
+    // Lowest value of each class.
+    std::vector<uint32_t> floors;
+    for (auto value : sorted) {
+        if (floors.empty() || value - floors.back() > (tolerance ? floors.back() / tolerance : 0)) {
+            floors.push_back(value);
+        }
+    }
+    for (auto& value : values) {
+        if (value != none) {
+            value = static_cast<uint32_t>(std::upper_bound(floors.cbegin(), floors.cend(), value) - floors.cbegin() - 1);
+        }
+    }
+}
 
-    // Get CPU vendor from cpuid
-    getCPUidVendor(vendor);
 
-    // Get total system memory.
-    ULONGLONG memoryKilobytes = 0;
-    GetPhysicallyInstalledSystemMemory(&memoryKilobytes);
-    systemMemory = static_cast<uint64_t>(memoryKilobytes);
+// Linux counterpart of the Windows EfficiencyClass and SchedulingClass.
+// efficiencyClass ranks cpu_capacity (arm64 big.LITTLE, x86 hybrid on recent kernels), else the hybrid PMU
+// each processor belongs to (cpu_core or cpu_atom, the kernel's view of the CPUID 0x1A core type).
+// schedulingClass ranks ACPI CPPC highest_perf, i.e. AMD preferred cores and Intel Turbo Boost Max 3.0 cores.
+// A file is only looked up for every core when the first core has it.
+void GetCoreClasses(
+    CpuTopology::TopologyInfo& Topology,
+    const std::string& root,
+    std::vector<char>& buffer) {
+    using CoreInfo = CpuTopology::TopologyInfo::CoreInfo;
+    const auto cpuRoot = root + "/sys/devices/system/cpu";
+    auto cpuDir = open(cpuRoot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cpuDir < 0 || Topology.cores.empty()) {
+        if (cpuDir >= 0) {
+            close(cpuDir);
+        }
+        return;
+    }
 
-    // Temporary set of cache levels.
-    std::map<uint64_t, CacheInfo> cacheMap;
+    char path[64];
+    auto readClasses = [&](const char* file, uint32_t tolerance, uint32_t CoreInfo::* member) {
+        std::vector<uint32_t> values(Topology.cores.size(), std::numeric_limits<uint32_t>::max());
+        for (size_t i = 0; i < values.size(); ++i) {
+            std::snprintf(path, sizeof(path), "cpu%u/%s", Topology.cores[i].sysLogicalProcessors.front(), file);
+            if (!readSysUInt(cpuDir, path, buffer, values[i]) && i == 0) {
+                return false;
+            }
+        }
+        RankClasses(values, tolerance);
+        for (size_t i = 0; i < values.size(); ++i) {
+            Topology.cores[i].*member = values[i];
+        }
+        return true;
+    };
 
-    // Temporary set of core cache.
-    std::map<uint64_t, std::map<uint64_t, CacheInfo>> processorCache;
+    // Capacities of one core type still differ by a few percent with the frequency they were measured at.
+    if (!readClasses("cpu_capacity", 16, &CoreInfo::efficiencyClass)) {
+        CpuSet performanceCores;
+        CpuSet efficientCores;
+        if (readSysFile(root + "/sys/devices/cpu_core/cpus", buffer)) {
+            performanceCores = CpuSet::fromList(buffer.data());
+        }
+        if (readSysFile(root + "/sys/devices/cpu_atom/cpus", buffer)) {
+            efficientCores = CpuSet::fromList(buffer.data());
+        }
+        if (!performanceCores.empty() && !efficientCores.empty()) {
+            for (auto& core : Topology.cores) {
+                auto processor = core.sysLogicalProcessors.front();
+                if (performanceCores.test(processor)) {
+                    core.efficiencyClass = 1;
+                }
+                else if (efficientCores.test(processor)) {
+                    core.efficiencyClass = 0;
+                }
+            }
+        }
+    }
 
-    // Temporary logical process to core index mappings for re-indexing complex groups, numa nodes, processor groups and socket.
-    std::map<uint64_t, uint32_t> processorMappings;
+    readClasses("acpi_cppc/highest_perf", 0, &CoreInfo::schedulingClass);
+    close(cpuDir);
+}
 
-    // Get physical core count, thread group and cache hierarchy information.
-    GetProcessorInfo(Topology, cacheMap, processorCache, processorMappings);
 
-    // Get CPPC ranking.
-    GetCPPCRanking(Topology, processorMappings);
+void GetNumaInfo(
+    CpuTopology::TopologyInfo& Topology,
+    const ProcessorMappings& processorMappings,
+    const std::string& root,
+    std::vector<char>& buffer) {
+    const auto nodeRoot = root + "/sys/devices/system/node/";
 
-    // Consolidate cache to physical core.
-    ConsolidateCachesToCores(Topology, processorCache);
+    // Nodes without any processor are memory nodes only, see GetMemoryNodes().
+    std::vector<uint32_t> nodes;
+    if (readSysFile(nodeRoot + "has_cpu", buffer) || readSysFile(nodeRoot + "online", buffer)) {
+        parseCpuList(buffer.data(), nodes);
+    }
 
-    // Consolidate cache level entries to cache vector.
-    for (auto& i : cacheMap) {
-        caches.push_back(std::move(i.second));
+    // Columns of nodeN/distance follow the online nodes, CPU-less ones included.
+    std::vector<uint32_t> onlineNodes;
+    if (readSysFile(nodeRoot + "online", buffer)) {
+        parseCpuList(buffer.data(), onlineNodes);
     }
+    std::vector<std::vector<uint32_t>> distanceRows;
 
-    // Consolidate cores and complex groups.
-    ConsolidateComplexGroups(Topology, processorMappings);
-    
-    // Consolidate numa nodes.
-    ConsolidateNUMAs(Topology, processorMappings);
+    for (auto node : nodes) {
+        const auto nodePath = nodeRoot + "node" + std::to_string(node) + "/";
 
-    // Consolidate sockets.
-    ConsolidateSockets(Topology, processorMappings);
+        CpuTopology::TopologyInfo::NumaNodeInfo numaNode;
+        numaNode.sysNumaNode = node;
+        numaNode.sysProcessorGroup = 0;
+        if (readSysFile(nodePath + "cpulist", buffer)) {
+            parseCpuList(buffer.data(), numaNode.sysLogicalProcessors);
+        }
+        numaNode.sysLogicalProcessors.erase(std::remove_if(numaNode.sysLogicalProcessors.begin(), numaNode.sysLogicalProcessors.end(),
+            [&](uint32_t p) { return processorMappings.find(0, p) == ProcessorMappings::none; }), numaNode.sysLogicalProcessors.end());
+        if (numaNode.sysLogicalProcessors.empty()) {
+            continue;
+        }
 
-    // Set total number of physical cores and complex groups.
-    physicalCores = static_cast<uint32_t>(Topology.cores.size());
-    complexGroups = static_cast<uint32_t>(Topology.complexGroups.size());
-    for (const auto& i : Topology.complexGroups) {
-        complexGroupSizes.push_back(static_cast<uint32_t>(i.cores.size()));
+        numaNode.id = static_cast<uint32_t>(Topology.numaNodes.size());
+        numaNode.availableMemory = readSysFile(nodePath + "meminfo", buffer) ? parseMemInfo(buffer.data(), "MemFree:") * 1024 : 0;
+        Topology.numaNodes.push_back(std::move(numaNode));
+
+        distanceRows.emplace_back();
+        if (readSysFile(nodePath + "distance", buffer)) {
+            const char* str = buffer.data();
+            char* end = nullptr;
+            for (auto distance = std::strtoul(str, &end, 10); end != str; distance = std::strtoul(str, &end, 10)) {
+                distanceRows.back().push_back(static_cast<uint32_t>(distance));
+                str = end;
+            }
+        }
     }
-    sockets = static_cast<uint32_t>(Topology.sockets.size());
-    numaNodes = static_cast<uint32_t>(Topology.numaNodes.size());
+
+    // SLIT distance matrix between the nodes kept in TopologyInfo.
+    if (!Topology.numaNodes.empty()) {
+        const auto count = Topology.numaNodes.size();
+        Topology.numaDistances.assign(count * count, 0);
+        for (size_t from = 0; from < count; ++from) {
+            for (size_t to = 0; to < count; ++to) {
+                auto column = std::find(onlineNodes.cbegin(), onlineNodes.cend(), Topology.numaNodes[to].sysNumaNode) - onlineNodes.cbegin();
+                auto& row = distanceRows[from];
+                Topology.numaDistances[from * count + to] = static_cast<size_t>(column) < row.size() ? row[column] : (from == to ? 10 : 20);
+            }
+        }
+    }
+
+    // Kernel without CONFIG_NUMA, the whole system is one node.
+    if (Topology.numaNodes.empty()) {
+        CpuTopology::TopologyInfo::NumaNodeInfo numaNode;
+        numaNode.id = 0;
+        numaNode.sysNumaNode = 0;
+        numaNode.sysProcessorGroup = 0;
+        for (uint32_t i = 0; i < processorMappings.cores.size(); ++i) {
+            if (processorMappings.cores[i] != ProcessorMappings::none) {
+                numaNode.sysLogicalProcessors.push_back(i);
+            }
+        }
+        numaNode.availableMemory = readSysFile(root + "/proc/meminfo", buffer) ? parseMemInfo(buffer.data(), "MemFree:") * 1024 : 0;
+        Topology.numaNodes.push_back(std::move(numaNode));
+        Topology.numaDistances.assign(1, 10);
+    }
+}
+
+
+// Every NUMA node with memory from sysfs, CPU-less ones included, linked to the NUMA nodes with processors.
+void GetMemoryNodes(
+    CpuTopology::TopologyInfo& Topology,
+    const std::string& root,
+    std::vector<char>& buffer) {
+    const auto nodeRoot = root + "/sys/devices/system/node/";
+    std::vector<uint32_t> nodes;
+    if (readSysFile(nodeRoot + "has_memory", buffer) || readSysFile(nodeRoot + "online", buffer)) {
+        parseCpuList(buffer.data(), nodes);
+    }
+
+    // Kernel without CONFIG_NUMA, the memory of the system belongs to its only node.
+    if (nodes.empty()) {
+        if (Topology.numaNodes.size() == 1) {
+            CpuTopology::TopologyInfo::MemoryNodeInfo memoryNode;
+            memoryNode.id = 0;
+            memoryNode.sysNumaNode = Topology.numaNodes.front().sysNumaNode;
+            memoryNode.numaNode = &Topology.numaNodes.front();
+            memoryNode.nearestNumaNode = memoryNode.numaNode;
+            if (readSysFile(root + "/proc/meminfo", buffer)) {
+                memoryNode.totalMemory = parseMemInfo(buffer.data(), "MemTotal:") * 1024;
+                memoryNode.availableMemory = parseMemInfo(buffer.data(), "MemFree:") * 1024;
+            }
+            memoryNode.distances.assign(1, 10);
+            memoryNode.hugePages = ReadHugePages(root + "/sys/kernel/mm/", buffer);
+            Topology.memoryNodes.push_back(std::move(memoryNode));
+        }
+        return;
+    }
+
+    // Distance rows of the NUMA nodes with processors, the columns follow the online nodes.
+    std::vector<uint32_t> onlineNodes;
+    if (readSysFile(nodeRoot + "online", buffer)) {
+        parseCpuList(buffer.data(), onlineNodes);
+    }
+    std::vector<std::vector<uint32_t>> distanceRows(Topology.numaNodes.size());
+    for (size_t i = 0; i < Topology.numaNodes.size(); ++i) {
+        if (readSysFile(nodeRoot + "node" + std::to_string(Topology.numaNodes[i].sysNumaNode) + "/distance", buffer)) {
+            const char* str = buffer.data();
+            char* end = nullptr;
+            for (auto distance = std::strtoul(str, &end, 10); end != str; distance = std::strtoul(str, &end, 10)) {
+                distanceRows[i].push_back(static_cast<uint32_t>(distance));
+                str = end;
+            }
+        }
+    }
+
+    // memory_tierN/nodelist, N grows with the abstract distance of the memory.
+    std::map<uint32_t, uint32_t> tiers;
+    const auto tierRoot = root + "/sys/devices/virtual/memory_tiering/";
+    for (const auto& name : listDirectory(tierRoot)) {
+        if (name.compare(0, 11, "memory_tier") != 0 || !readSysFile(tierRoot + name + "/nodelist", buffer)) {
+            continue;
+        }
+        std::vector<uint32_t> tierNodes;
+        parseCpuList(buffer.data(), tierNodes);
+        for (auto node : tierNodes) {
+            tiers[node] = static_cast<uint32_t>(std::strtoul(name.c_str() + 11, nullptr, 10));
+        }
+    }
+
+    for (auto node : nodes) {
+        const auto nodePath = nodeRoot + "node" + std::to_string(node) + "/";
+
+        CpuTopology::TopologyInfo::MemoryNodeInfo memoryNode;
+        memoryNode.id = static_cast<uint32_t>(Topology.memoryNodes.size());
+        memoryNode.sysNumaNode = node;
+        for (auto& numaNode : Topology.numaNodes) {
+            if (numaNode.sysNumaNode == node) {
+                memoryNode.numaNode = &numaNode;
+            }
+        }
+        if (readSysFile(nodePath + "meminfo", buffer)) {
+            memoryNode.totalMemory = parseMemInfo(buffer.data(), "MemTotal:") * 1024;
+            memoryNode.availableMemory = parseMemInfo(buffer.data(), "MemFree:") * 1024;
+        }
+        auto tier = tiers.find(node);
+        if (tier != tiers.end()) {
+            memoryNode.memoryTier = tier->second;
+        }
+
+        // HMAT attributes of the initiators with the best access, CONFIG_HMEM_REPORTING.
+        const auto accessPath = nodePath + "access0/initiators/";
+        memoryNode.readBandwidth = static_cast<uint32_t>(readSysUInt64(accessPath + "read_bandwidth", buffer));
+        memoryNode.writeBandwidth = static_cast<uint32_t>(readSysUInt64(accessPath + "write_bandwidth", buffer));
+        memoryNode.readLatency = static_cast<uint32_t>(readSysUInt64(accessPath + "read_latency", buffer));
+        memoryNode.writeLatency = static_cast<uint32_t>(readSysUInt64(accessPath + "write_latency", buffer));
+        for (const auto& name : listDirectory(accessPath)) {
+            if (name.compare(0, 4, "node") == 0 && name.size() > 4 && std::isdigit(static_cast<unsigned char>(name[4]))) {
+                memoryNode.initiators.push_back(static_cast<uint32_t>(std::strtoul(name.c_str() + 4, nullptr, 10)));
+            }
+        }
+        std::sort(memoryNode.initiators.begin(), memoryNode.initiators.end());
+
+        // Distances from every NUMA node with processors, the nearest one stands in for a CPU-less node.
+        auto column = static_cast<size_t>(std::find(onlineNodes.cbegin(), onlineNodes.cend(), node) - onlineNodes.cbegin());
+        for (size_t i = 0; i < Topology.numaNodes.size(); ++i) {
+            const auto& row = distanceRows[i];
+            auto local = Topology.numaNodes[i].sysNumaNode == node;
+            memoryNode.distances.push_back(column < row.size() ? row[column] : (local ? 10 : 20));
+            if (!memoryNode.nearestNumaNode || memoryNode.distances.back() < memoryNode.distances[memoryNode.nearestNumaNode->id]) {
+                memoryNode.nearestNumaNode = &Topology.numaNodes[i];
+            }
+        }
+        if (memoryNode.numaNode) {
+            memoryNode.nearestNumaNode = memoryNode.numaNode;
+        }
+
+        memoryNode.hugePages = ReadHugePages(nodePath, buffer);
+        Topology.memoryNodes.push_back(std::move(memoryNode));
+    }
+}
+
+
+// Free memory and free huge pages of every node now, for a topology restored from a snapshot.
+// A kernel without CONFIG_NUMA has no node directories, its only node has the memory of the system.
+void RefreshFreeMemory(CpuTopology::TopologyInfo& Topology, const std::string& root, std::vector<char>& buffer) {
+    const auto nodeRoot = root + "/sys/devices/system/node/";
+    auto freeMemory = [&](uint32_t sysNumaNode, bool& numa) -> uint64_t {
+        numa = readSysFile(nodeRoot + "node" + std::to_string(sysNumaNode) + "/meminfo", buffer);
+        if (!numa && !readSysFile(root + "/proc/meminfo", buffer)) {
+            return 0;
+        }
+        return parseMemInfo(buffer.data(), "MemFree:") * 1024;
+    };
+    bool numa = false;
+    for (auto& numaNode : Topology.numaNodes) {
+        numaNode.availableMemory = freeMemory(numaNode.sysNumaNode, numa);
+    }
+    for (auto& memoryNode : Topology.memoryNodes) {
+        memoryNode.availableMemory = freeMemory(memoryNode.sysNumaNode, numa);
+        memoryNode.hugePages = numa ?
+            ReadHugePages(nodeRoot + "node" + std::to_string(memoryNode.sysNumaNode) + "/", buffer) :
+            ReadHugePages(root + "/sys/kernel/mm/", buffer);
+    }
+}
+
+
+// Directories of a cgroup and its ancestors, innermost first.
+// Without a cgroup namespace the path is the host's while the mount is the container's own cgroup,
+// the walk then lands on the mount root which still holds the container limits.
+inline std::vector<std::string> cgroupDirectories(const std::string& mount, std::string path) {
+    std::vector<std::string> directories;
+    while (true) {
+        directories.push_back(mount + path);
+        auto slash = path.find_last_of('/');
+        if (slash == std::string::npos || path.size() <= 1) {
+            break;
+        }
+        path = slash ? path.substr(0, slash) : "/";
+    }
+    return directories;
+}
+
+
+// Effective cpuset and CPU quota of the process from cgroup v2 or v1.
+// cpuset stays untouched when no cpuset controller is found, quota stays 0 when unlimited.
+void GetCgroupLimits(const std::string& root, CpuSet& cpuset, float& quota, std::vector<char>& buffer) {
+    if (!readSysFile(root + "/proc/self/cgroup", buffer)) {
+        return;
+    }
+
+    // "hierarchy:controllers:path" lines, the v2 line has no controllers.
+    std::string unifiedPath;
+    std::string cpusetPath;
+    std::string cpusetMount;
+    std::string cpuPath;
+    std::string cpuMount;
+    const char* line = buffer.data();
+    while (*line) {
+        auto end = std::strchr(line, '\n');
+        std::string entry(line, end ? end - line : std::strlen(line));
+        line = end ? end + 1 : line + entry.size();
+
+        auto first = entry.find(':');
+        auto second = entry.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            continue;
+        }
+        auto controllers = entry.substr(first + 1, second - first - 1);
+        auto path = entry.substr(second + 1);
+        if (controllers.empty()) {
+            unifiedPath = path;
+            continue;
+        }
+        auto hasController = [&](const char* name) {
+            return ("," + controllers + ",").find(std::string(",") + name + ",") != std::string::npos;
+        };
+        if (hasController("cpuset")) {
+            cpusetPath = path;
+            cpusetMount = root + "/sys/fs/cgroup/" + controllers;
+        }
+        if (hasController("cpu")) {
+            cpuPath = path;
+            cpuMount = root + "/sys/fs/cgroup/" + controllers;
+        }
+    }
+
+    auto readCpuset = [&](const std::string& directory, const char* file) {
+        if (readSysFile(directory + file, buffer) && buffer[0] >= '0' && buffer[0] <= '9') {
+            cpuset &= CpuSet::fromList(buffer.data());
+            return true;
+        }
+        return false;
+    };
+    // Every ancestor caps the quota, the tightest one wins.
+    auto capQuota = [&](float limit) {
+        if (limit > 0.0f && (quota <= 0.0f || limit < quota)) {
+            quota = limit;
+        }
+    };
+
+    bool cpusetFound = false;
+    if (!cpusetPath.empty()) {
+        for (const auto& directory : cgroupDirectories(cpusetMount, cpusetPath)) {
+            if (readCpuset(directory, "/cpuset.effective_cpus") || readCpuset(directory, "/cpuset.cpus")) {
+                cpusetFound = true;
+                break;
+            }
+        }
+    }
+    if (!cpuPath.empty()) {
+        for (const auto& directory : cgroupDirectories(cpuMount, cpuPath)) {
+            if (readSysFile(directory + "/cpu.cfs_quota_us", buffer)) {
+                auto limit = std::strtol(buffer.data(), nullptr, 10);
+                uint32_t period = 0;
+                if (readSysUInt(AT_FDCWD, (directory + "/cpu.cfs_period_us").c_str(), buffer, period) && limit > 0 && period) {
+                    capQuota(static_cast<float>(limit) / static_cast<float>(period));
+                }
+            }
+        }
+    }
+
+    // cgroup v2 is mounted at /sys/fs/cgroup, or at /sys/fs/cgroup/unified on hybrid hosts.
+    if (!unifiedPath.empty()) {
+        for (const auto* mount : { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" }) {
+            bool mounted = false;
+            for (const auto& directory : cgroupDirectories(root + mount, unifiedPath)) {
+                // The effective cpuset of the innermost cgroup already includes its ancestors.
+                if (!cpusetFound && readCpuset(directory, "/cpuset.cpus.effective")) {
+                    cpusetFound = true;
+                    mounted = true;
+                }
+                // "max 100000" or "quota period".
+                if (readSysFile(directory + "/cpu.max", buffer)) {
+                    mounted = true;
+                    char* end = nullptr;
+                    auto limit = std::strtoul(buffer.data(), &end, 10);
+                    auto period = end != buffer.data() ? std::strtoul(end, nullptr, 10) : 0;
+                    if (period) {
+                        capQuota(static_cast<float>(limit) / static_cast<float>(period));
+                    }
+                }
+            }
+            if (mounted) {
+                break;
+            }
+        }
+    }
+}
+#endif
+
+
+// Raw topology of a synthetic layout in the same shape discovery produces.
+void GetSyntheticInfo(
+    const CpuTopology::SyntheticLayout& layout,
+    CpuTopology::TopologyInfo& Topology,
+    std::map<uint64_t, CpuTopology::CacheInfo>& cacheMap,
+    ProcessorCaches& processorCache,
+    ProcessorMappings& processorMappings) {
+    // Every level has at least one instance.
+    const auto threads = std::max(layout.threadsPerCore, 1u);
+    const auto coresPerComplexGroup = std::max(layout.coresPerComplexGroup, 1u);
+    const auto coresPerNumaNode = std::max(layout.complexGroupsPerNumaNode, 1u) * coresPerComplexGroup;
+    const auto numaNodesPerSocket = std::max(layout.numaNodesPerSocket, 1u);
+    const auto coresPerSocket = numaNodesPerSocket * coresPerNumaNode;
+    const auto cores = static_cast<uint32_t>(std::min<uint64_t>(
+        uint64_t(std::max(layout.sockets, 1u)) * coresPerSocket, CpuSet::maxProcessors / threads));
+
+    // Thread t of core c is logical processor c + t * cores.
+    auto processorsOf = [&](uint32_t firstCore, uint32_t endCore) {
+        std::vector<uint32_t> processors;
+        processors.reserve((endCore - firstCore) * threads);
+        for (uint32_t t = 0; t < threads; ++t) {
+            for (auto c = firstCore; c < endCore; ++c) {
+                processors.push_back(c + t * cores);
+            }
+        }
+        return processors;
+    };
+
+    const auto l3Shared = coresPerComplexGroup * threads;
+    const CpuTopology::CacheInfo coreCaches[] = {
+        { CpuTopology::CacheType::data, 1, 12, layout.l1DataSize, 64, threads },
+        { CpuTopology::CacheType::instruction, 1, 8, layout.l1InstructionSize, 64, threads },
+        { CpuTopology::CacheType::unified, 2, 16, layout.l2Size, 64, threads },
+    };
+    const CpuTopology::CacheInfo l3 = { CpuTopology::CacheType::unified, 3, 16, layout.l3Size, 64, l3Shared };
+    auto addCache = [&](const CpuTopology::CacheInfo& cache, const std::vector<uint32_t>& processors) {
+        auto cacheKey = makeUInt64(cache.level, cache.type);
+        if (cacheMap.count(cacheKey)) {
+            cacheMap[cacheKey] += cache;
+        }
+        else {
+            cacheMap[cacheKey] = cache;
+        }
+        for (auto processor : processors) {
+            processorCaches(processorCache, 0, processor)[cacheKey] = cache;
+        }
+    };
+
+    for (uint32_t c = 0; c < cores; ++c) {
+        CpuTopology::TopologyInfo::CoreInfo core;
+        core.id = c;
+        core.sysProcessorGroup = 0;
+        core.SMT = threads > 1;
+        core.sysLogicalProcessors = processorsOf(c, c + 1);
+        for (auto processor : core.sysLogicalProcessors) {
+            processorMappings.set(0, processor, core.id);
+        }
+        for (const auto& cache : coreCaches) {
+            addCache(cache, core.sysLogicalProcessors);
+        }
+        Topology.cores.push_back(std::move(core));
+    }
+
+    for (uint32_t g = 0; g * coresPerComplexGroup < cores; ++g) {
+        CpuTopology::TopologyInfo::ComplexGroupInfo complexGroup;
+        complexGroup.id = g;
+        complexGroup.sysProcessorGroup = 0;
+        complexGroup.sysLogicalProcessors = processorsOf(g * coresPerComplexGroup, std::min((g + 1) * coresPerComplexGroup, cores));
+        addCache(l3, complexGroup.sysLogicalProcessors);
+        Topology.complexGroups.push_back(std::move(complexGroup));
+    }
+
+    for (uint32_t n = 0; n * coresPerNumaNode < cores; ++n) {
+        CpuTopology::TopologyInfo::NumaNodeInfo numaNode;
+        numaNode.id = n;
+        numaNode.sysNumaNode = n;
+        numaNode.sysProcessorGroup = 0;
+        numaNode.availableMemory = layout.numaNodeMemory;
+        numaNode.sysLogicalProcessors = processorsOf(n * coresPerNumaNode, std::min((n + 1) * coresPerNumaNode, cores));
+        Topology.numaNodes.push_back(std::move(numaNode));
+    }
+
+    for (uint32_t p = 0; p * coresPerSocket < cores; ++p) {
+        CpuTopology::TopologyInfo::SocketInfo socket;
+        socket.id = p;
+        socket.processorsStructs.resize(1);
+        socket.processorsStructs[0].sysProcessorGroup = 0;
+        socket.processorsStructs[0].sysLogicalProcessors = processorsOf(p * coresPerSocket, std::min((p + 1) * coresPerSocket, cores));
+        Topology.sockets.push_back(std::move(socket));
+    }
+
+    // SLIT-like distances: local 10, same socket 12, remote socket 32.
+    const auto count = static_cast<uint32_t>(Topology.numaNodes.size());
+    Topology.numaDistances.assign(count * count, 0);
+    for (uint32_t from = 0; from < count; ++from) {
+        for (uint32_t to = 0; to < count; ++to) {
+            auto sameSocket = from / numaNodesPerSocket == to / numaNodesPerSocket;
+            Topology.numaDistances[from * count + to] = from == to ? 10 : (sameSocket ? 12 : 32);
+        }
+    }
+
+    // Memory of every NUMA node in tier 4 like DRAM, then the CPU-less nodes of each socket one tier down,
+    // 20 away from their own socket and 42 from the other ones.
+    for (uint32_t n = 0; n < count; ++n) {
+        CpuTopology::TopologyInfo::MemoryNodeInfo memoryNode;
+        memoryNode.id = n;
+        memoryNode.sysNumaNode = n;
+        memoryNode.numaNode = &Topology.numaNodes[n];
+        memoryNode.nearestNumaNode = memoryNode.numaNode;
+        memoryNode.memoryTier = 4;
+        memoryNode.totalMemory = layout.numaNodeMemory;
+        memoryNode.availableMemory = layout.numaNodeMemory;
+        memoryNode.initiators.push_back(n);
+        memoryNode.distances.assign(Topology.numaDistances.begin() + n * count, Topology.numaDistances.begin() + (n + 1) * count);
+        Topology.memoryNodes.push_back(std::move(memoryNode));
+    }
+    for (uint32_t p = 0; p < Topology.sockets.size(); ++p) {
+        for (uint32_t m = 0; m < layout.memoryOnlyNodesPerSocket; ++m) {
+            CpuTopology::TopologyInfo::MemoryNodeInfo memoryNode;
+            memoryNode.id = static_cast<uint32_t>(Topology.memoryNodes.size());
+            memoryNode.sysNumaNode = memoryNode.id;
+            memoryNode.memoryTier = 5;
+            memoryNode.totalMemory = layout.memoryOnlyNodeMemory;
+            memoryNode.availableMemory = layout.memoryOnlyNodeMemory;
+            for (uint32_t n = 0; n < count; ++n) {
+                auto sameSocket = n / numaNodesPerSocket == p;
+                memoryNode.distances.push_back(sameSocket ? 20 : 42);
+                if (sameSocket) {
+                    memoryNode.initiators.push_back(n);
+                }
+            }
+            memoryNode.nearestNumaNode = &Topology.numaNodes[p * numaNodesPerSocket];
+            Topology.memoryNodes.push_back(std::move(memoryNode));
+        }
+    }
+}
+
+
+void GetCpuidInfo(
+    const CpuidTopology& source,
+    CpuTopology::TopologyInfo& Topology,
+    std::map<uint64_t, CpuTopology::CacheInfo>& cacheMap,
+    ProcessorCaches& processorCache,
+    ProcessorMappings& processorMappings) {
+    // Domain id -> index in Topology. Complex groups and NUMA nodes are also split by processor group,
+    // both hold a single sysProcessorGroup.
+    std::map<uint32_t, uint32_t> cores;
+    std::map<uint64_t, uint32_t> complexGroups;
+    std::map<uint64_t, uint32_t> numaNodes;
+    std::map<uint32_t, uint32_t> sockets;
+
+    for (const auto& processor : source.processors) {
+        const auto group = processor.index / CpuSet::wordBits;
+        const auto logical = processor.index % CpuSet::wordBits;
+
+        auto core = cores.emplace(processor.core, static_cast<uint32_t>(Topology.cores.size()));
+        if (core.second) {
+            CpuTopology::TopologyInfo::CoreInfo info;
+            info.id = core.first->second;
+            info.sysProcessorGroup = group;
+            Topology.cores.push_back(std::move(info));
+        }
+        decltype(auto) coreInfo = Topology.cores[core.first->second];
+        coreInfo.sysLogicalProcessors.push_back(logical);
+        coreInfo.SMT = coreInfo.sysLogicalProcessors.size() > 1;
+        processorMappings.set(group, logical, coreInfo.id);
+
+        auto complexGroup = complexGroups.emplace(makeUInt64(group, processor.complexGroup), static_cast<uint32_t>(Topology.complexGroups.size()));
+        if (complexGroup.second) {
+            CpuTopology::TopologyInfo::ComplexGroupInfo info;
+            info.id = complexGroup.first->second;
+            info.sysProcessorGroup = group;
+            Topology.complexGroups.push_back(std::move(info));
+        }
+        Topology.complexGroups[complexGroup.first->second].sysLogicalProcessors.push_back(logical);
+
+        auto socket = sockets.emplace(processor.package, static_cast<uint32_t>(Topology.sockets.size()));
+        if (socket.second) {
+            CpuTopology::TopologyInfo::SocketInfo info;
+            info.id = socket.first->second;
+            Topology.sockets.push_back(std::move(info));
+        }
+        auto& processorsStructs = Topology.sockets[socket.first->second].processorsStructs;
+        if (processorsStructs.empty() || processorsStructs.back().sysProcessorGroup != group) {
+            processorsStructs.emplace_back();
+            processorsStructs.back().sysProcessorGroup = group;
+        }
+        processorsStructs.back().sysLogicalProcessors.push_back(logical);
+
+        auto numaNode = numaNodes.emplace(makeUInt64(group, processor.package), static_cast<uint32_t>(Topology.numaNodes.size()));
+        if (numaNode.second) {
+            CpuTopology::TopologyInfo::NumaNodeInfo info;
+            info.id = numaNode.first->second;
+            info.sysNumaNode = socket.first->second;
+            info.sysProcessorGroup = group;
+            info.availableMemory = 0;
+            Topology.numaNodes.push_back(std::move(info));
+        }
+        Topology.numaNodes[numaNode.first->second].sysLogicalProcessors.push_back(logical);
+    }
+
+    // Cache instances: processors with the same level, type and x2APIC id above the share shift.
+    struct CacheInstance {
+        CpuidTopology::Cache cache;
+        std::vector<uint32_t> processors;
+    };
+    std::map<std::tuple<uint32_t, CpuTopology::CacheType, uint32_t>, CacheInstance> instances;
+    for (const auto& processor : source.processors) {
+        for (const auto& cache : processor.caches) {
+            auto& instance = instances[std::make_tuple(cache.level, cache.type, processor.apicId >> cache.shareShift)];
+            instance.cache = cache;
+            instance.processors.push_back(processor.index);
+        }
+    }
+    for (const auto& i : instances) {
+        const auto& instance = i.second;
+        CpuTopology::CacheInfo cache = { instance.cache.type, instance.cache.level, instance.cache.associativity,
+            instance.cache.size, instance.cache.line, static_cast<uint32_t>(instance.processors.size()) };
+        auto cacheKey = makeUInt64(cache.level, cache.type);
+        if (cacheMap.count(cacheKey)) {
+            cacheMap[cacheKey] += cache;
+        }
+        else {
+            cacheMap[cacheKey] = cache;
+        }
+        for (auto index : instance.processors) {
+            processorCaches(processorCache, index / CpuSet::wordBits, index % CpuSet::wordBits)[cacheKey] = cache;
+        }
+    }
+}
+
+
+void ConsolidateCachesToCores(
+    CpuTopology::TopologyInfo& Topology,
+    const ProcessorCaches& processorCache) {
+    for (auto& core : Topology.cores) {
+        for (auto processor : core.sysLogicalProcessors) {
+            auto i = CpuSet::index(core.sysProcessorGroup, processor);
+            if (i < processorCache.size() && !processorCache[i].empty()) {
+                std::transform(processorCache[i].cbegin(), processorCache[i].cend(),
+                    std::back_inserter(core.caches), [](auto& kv) { return kv.second; });
+                break;
+            }
+        }
+    }
+}
+
+
+void ConsolidateComplexGroups(
+    CpuTopology::TopologyInfo& Topology,
+    const ProcessorMappings& processorMappings) {
+    // complexGroup.cores contains logical processors now, let it become physical cores.
+    for (auto& complexGroup : Topology.complexGroups) {
+        std::vector<CpuTopology::TopologyInfo::CoreInfo*> newCores;
+        for (auto processor : complexGroup.sysLogicalProcessors) {
+            auto coreID = processorMappings.find(complexGroup.sysProcessorGroup, processor);
+            if (coreID == ProcessorMappings::none) {
+                continue;
+            }
+            decltype(auto) core = Topology.cores[coreID];
+
+            if (!core.complexGroup) {
+                core.complexGroup = &complexGroup;
+                newCores.emplace_back(&core);
+            }
+        }
+        complexGroup.cores = std::move(newCores);
+    }
+}
+
+
+void ConsolidateNUMAs(
+    CpuTopology::TopologyInfo& Topology,
+    const ProcessorMappings& processorMappings) {
+    // numaNode.cores contains logical processors now, let it become physical cores.
+    for (auto& numaNode : Topology.numaNodes) {
+        std::vector<CpuTopology::TopologyInfo::CoreInfo*> newCores;
+        std::vector<CpuTopology::TopologyInfo::ComplexGroupInfo*> newComplexGroups;
+        for (auto processor : numaNode.sysLogicalProcessors) {
+            auto coreID = processorMappings.find(numaNode.sysProcessorGroup, processor);
+            if (coreID == ProcessorMappings::none) {
+                continue;
+            }
+            decltype(auto) core = Topology.cores[coreID];
+
+            if (!core.numaNode) {
+                core.numaNode = &numaNode;
+                core.sysNumaNode = numaNode.sysNumaNode;
+                newCores.emplace_back(&core);
+
+                if (core.complexGroup && !core.complexGroup->numaNode) {
+                    core.complexGroup->numaNode = &numaNode;
+                    core.complexGroup->sysNumaNode = numaNode.sysNumaNode;
+                    newComplexGroups.emplace_back(core.complexGroup);
+                }
+            }
+        }
+        numaNode.cores = std::move(newCores);
+        numaNode.complexGroups = std::move(newComplexGroups);
+    }
+}
+
+
+void ConsolidateSockets(
+    CpuTopology::TopologyInfo& Topology,
+    const ProcessorMappings& processorMappings) {
+    // socket.processorStruct contains logical processors now, let it become physical cores.
+    for (auto& socket : Topology.sockets) {
+        std::vector<CpuTopology::TopologyInfo::CoreInfo*> newCores;
+        std::vector<CpuTopology::TopologyInfo::ComplexGroupInfo*> newComplexGroups;
+        std::vector<CpuTopology::TopologyInfo::NumaNodeInfo*> newNumaNodes;
+        std::vector<uint32_t> newsysNumaNodes;
+        for (const auto& processorStruct : socket.processorsStructs) {
+            for (auto processor : processorStruct.sysLogicalProcessors) {
+                auto coreID = processorMappings.find(processorStruct.sysProcessorGroup, processor);
+                if (coreID == ProcessorMappings::none) {
+                    continue;
+                }
+                decltype(auto) core = Topology.cores[coreID];
+
+                if (!core.socket) {
+                    core.socket = &socket;
+                    newCores.emplace_back(&core);
+
+                    if (core.complexGroup && !core.complexGroup->socket) {
+                        core.complexGroup->socket = &socket;
+                        newComplexGroups.emplace_back(core.complexGroup);
+                    }
+
+                    if (core.numaNode && !core.numaNode->socket) {
+                        core.numaNode->socket = &socket;
+                        newNumaNodes.emplace_back(core.numaNode);
+                        newsysNumaNodes.emplace_back(core.sysNumaNode);
+                    }
+
+                }
+            }
+        }
+        // Consolidate socket
+        socket.cores = std::move(newCores);
+        socket.complexGroups = std::move(newComplexGroups);
+        socket.numaNodes = std::move(newNumaNodes);
+        socket.sysNumaNodes = std::move(newsysNumaNodes);
+    }
+}
+
+
+void ConsolidateCpuSets(CpuTopology::TopologyInfo& Topology) {
+    for (auto& core : Topology.cores) {
+        core.cpuSet = CpuSet::from(core.sysProcessorGroup, core.sysLogicalProcessors);
+        Topology.cpuSet |= core.cpuSet;
+        if (!core.sysLogicalProcessors.empty()) {
+            Topology.primaryProcessors.set(CpuSet::index(core.sysProcessorGroup, core.sysLogicalProcessors.front()));
+        }
+    }
+    for (auto& complexGroup : Topology.complexGroups) {
+        complexGroup.cpuSet = CpuSet::from(complexGroup.sysProcessorGroup, complexGroup.sysLogicalProcessors);
+    }
+    for (auto& numaNode : Topology.numaNodes) {
+        numaNode.cpuSet = CpuSet::from(numaNode.sysProcessorGroup, numaNode.sysLogicalProcessors);
+    }
+    for (auto& socket : Topology.sockets) {
+        for (const auto& processorStruct : socket.processorsStructs) {
+            socket.cpuSet |= CpuSet::from(processorStruct.sysProcessorGroup, processorStruct.sysLogicalProcessors);
+        }
+    }
+}
+
+
+void ConsolidateFlatTopology(
+    const CpuTopology::TopologyInfo& Topology,
+    CpuTopology::FlatTopologyInfo& FlatTopology) {
+    using Flat = CpuTopology::FlatTopologyInfo;
+    auto id = [](const auto* p) { return p ? static_cast<uint16_t>(p->id) : Flat::none; };
+
+    uint32_t processorCount = 0;
+    for (const auto& core : Topology.cores) {
+        for (auto processor : core.sysLogicalProcessors) {
+            processorCount = std::max(processorCount, CpuSet::index(core.sysProcessorGroup, processor) + 1);
+        }
+    }
+    FlatTopology.processors.assign(processorCount, Flat::ProcessorLocation());
+
+    FlatTopology.coreCacheOffsets.reserve(Topology.cores.size() + 1);
+    for (const auto& core : Topology.cores) {
+        Flat::ProcessorLocation location;
+        location.core = static_cast<uint16_t>(core.id);
+        location.complexGroup = id(core.complexGroup);
+        location.numaNode = id(core.numaNode);
+        location.socket = id(core.socket);
+        for (auto processor : core.sysLogicalProcessors) {
+            FlatTopology.processors[CpuSet::index(core.sysProcessorGroup, processor)] = location;
+        }
+
+        FlatTopology.coreComplexGroups.push_back(location.complexGroup);
+        FlatTopology.coreNumaNodes.push_back(location.numaNode);
+        FlatTopology.coreSockets.push_back(location.socket);
+
+        FlatTopology.coreCacheOffsets.push_back(static_cast<uint32_t>(FlatTopology.coreCaches.size()));
+        FlatTopology.coreCaches.insert(FlatTopology.coreCaches.end(), core.caches.cbegin(), core.caches.cend());
+    }
+    FlatTopology.coreCacheOffsets.push_back(static_cast<uint32_t>(FlatTopology.coreCaches.size()));
+
+    for (const auto& complexGroup : Topology.complexGroups) {
+        FlatTopology.complexGroupNumaNodes.push_back(id(complexGroup.numaNode));
+        FlatTopology.complexGroupSockets.push_back(id(complexGroup.socket));
+    }
+    for (const auto& numaNode : Topology.numaNodes) {
+        FlatTopology.numaNodeSockets.push_back(id(numaNode.socket));
+    }
+}
+
+
+// Consolidate the discovered cores, caches, complex groups, NUMA nodes and sockets.
+void ConsolidateTopology(
+    CpuTopology& cpu,
+    std::map<uint64_t, CpuTopology::CacheInfo>& cacheMap,
+    const ProcessorCaches& processorCache,
+    const ProcessorMappings& processorMappings) {
+    auto& Topology = cpu.Topology;
+
+    // Consolidate cache to physical core.
+    ConsolidateCachesToCores(Topology, processorCache);
+
+    // Consolidate cache level entries to cache vector.
+    for (auto& i : cacheMap) {
+        cpu.caches.push_back(std::move(i.second));
+    }
+
+    // Consolidate cores and complex groups.
+    ConsolidateComplexGroups(Topology, processorMappings);
+    
+    // Consolidate numa nodes.
+    ConsolidateNUMAs(Topology, processorMappings);
+
+    // Consolidate sockets.
+    ConsolidateSockets(Topology, processorMappings);
+
+    // Build the logical processor bitmasks of every level.
+    ConsolidateCpuSets(Topology);
+
+    // Build the index-based lookup tables.
+    ConsolidateFlatTopology(Topology, cpu.FlatTopology);
+
+    // Set total number of physical cores and complex groups.
+    cpu.physicalCores = static_cast<uint32_t>(Topology.cores.size());
+    cpu.complexGroups = static_cast<uint32_t>(Topology.complexGroups.size());
+    for (const auto& i : Topology.complexGroups) {
+        cpu.complexGroupSizes.push_back(static_cast<uint32_t>(i.cores.size()));
+    }
+    cpu.sockets = static_cast<uint32_t>(Topology.sockets.size());
+    cpu.numaNodes = static_cast<uint32_t>(Topology.numaNodes.size());
+}
+
+
+// Attach measured data persisted by an earlier run.
+// CPU_TOPOLOGY_MEASURE=latency,numa measures and persists whatever is missing.
+// Matrices already restored from a snapshot are kept.
+void AttachMeasurements(CpuTopology& cpu) {
+    auto measure = std::getenv("CPU_TOPOLOGY_MEASURE");
+    std::string requested = measure ? measure : "";
+
+    auto latencyPath = coreLatencyCachePath(cpu);
+    if (cpu.Topology.coreLatencies.empty() &&
+        !loadCoreLatency(latencyPath, cpu, cpu.Topology.coreLatencies) && requested.find("latency") != std::string::npos) {
+        cpu.Topology.coreLatencies = measureCoreLatency(cpu);
+        if (!cpu.Topology.coreLatencies.empty()) {
+            saveCoreLatency(latencyPath, cpu, cpu.Topology.coreLatencies);
+        }
+    }
+
+    if (!cpu.Topology.numaLatencies.empty()) {
+        return;
+    }
+    NumaProbeResult probe;
+    auto probePath = numaProbeCachePath(cpu);
+    auto probed = loadNumaProbe(probePath, cpu, probe);
+    if (!probed && requested.find("numa") != std::string::npos) {
+        probe = probeNuma(cpu);
+        saveNumaProbe(probePath, cpu, probe);
+        probed = true;
+    }
+    if (probed) {
+        cpu.Topology.numaLatencies = std::move(probe.latencies);
+        cpu.Topology.numaReadBandwidths = std::move(probe.readBandwidths);
+        cpu.Topology.numaCopyBandwidths = std::move(probe.copyBandwidths);
+    }
+}
+
+
+// CPU_TOPOLOGY_SNAPSHOT=off ignores snapshots, =save writes one after discovery.
+inline std::string snapshotMode() {
+    auto mode = std::getenv("CPU_TOPOLOGY_SNAPSHOT");
+    return mode ? mode : "";
+}
+
+
+// Restore the topology from the snapshot of an earlier run instead of discovering it.
+// Needs name, family, model and logicalProcessors to match the fingerprint,
+// a non-empty online set must also match the restored processors (hot-plug keeps the count but not the set).
+bool LoadTopologySnapshot(CpuTopology& cpu, const CpuSet& online) {
+    if (snapshotMode() == "off") {
+        return false;
+    }
+    TopologySnapshot snapshot;
+    if (!snapshot.open(snapshotCachePath(cpu)) ||
+        snapshot.header().fingerprint != cpu.fingerprint() ||
+        !loadSnapshot(snapshot, cpu)) {
+        return false;
+    }
+    ConsolidateCpuSets(cpu.Topology);
+    if (!online.empty() && cpu.Topology.cpuSet != online) {
+        cpu.Topology = CpuTopology::TopologyInfo();
+        cpu.caches.clear();
+        cpu.complexGroupSizes.clear();
+        return false;
+    }
+    ConsolidateFlatTopology(cpu.Topology, cpu.FlatTopology);
+    return true;
+}
+
+
+void SaveTopologySnapshot(const CpuTopology& cpu) {
+    if (snapshotMode() == "save") {
+        saveSnapshot(snapshotCachePath(cpu), cpu);
+    }
+}
+
+
+uint64_t CpuTopology::fingerprint() const {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](const void* data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<const unsigned char*>(data)[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    mix(name.data(), name.size());
+    mix(&family, sizeof(family));
+    mix(&model, sizeof(model));
+    mix(&logicalProcessors, sizeof(logicalProcessors));
+    return hash;
+}
+
+
+std::string CpuTopology::cacheDirectory() {
+    if (auto path = std::getenv("CPU_TOPOLOGY_CACHE")) {
+        return path;
+    }
+#if defined(_WIN32)
+    if (auto path = std::getenv("LOCALAPPDATA")) {
+        return std::string(path) + "\\cpu_topology";
+    }
+#else
+    if (auto path = std::getenv("XDG_CACHE_HOME")) {
+        return std::string(path) + "/cpu_topology";
+    }
+    if (auto path = std::getenv("HOME")) {
+        return std::string(path) + "/.cache/cpu_topology";
+    }
+#endif
+    return "cpu_topology";
+}
+
+
+#if defined(_WIN32)
+CpuTopology::CpuTopology() {
+    // Get basic processor information.
+    processorGroups = GetActiveProcessorGroupCount();
+    logicalProcessors = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+
+    /* Get CPU family from cpuid. */
+    getCPUidFamily(family, model);
+
+    // Get CPU name from cpuid or the registry.
+    getCPUidName(name);
+
+    // Get CPU vendor from cpuid
+    getCPUidVendor(vendor);
+
+    // Get ISA feature flags from cpuid.
+    isa = hostIsa();
+
+    // Skip discovery when a snapshot of this host exists.
+    if (LoadTopologySnapshot(*this, CpuSet())) {
+        RefreshFreeMemory(Topology);
+        AttachMeasurements(*this);
+        return;
+    }
+
+    // Get total system memory.
+    ULONGLONG memoryKilobytes = 0;
+    GetPhysicallyInstalledSystemMemory(&memoryKilobytes);
+    systemMemory = static_cast<uint64_t>(memoryKilobytes);
+
+    // Temporary set of cache levels.
+    std::map<uint64_t, CacheInfo> cacheMap;
+
+    // Temporary set of core cache.
+    ProcessorCaches processorCache;
+
+    // Temporary logical process to core index mappings for re-indexing complex groups, numa nodes, processor groups and socket.
+    ProcessorMappings processorMappings;
+
+    // Get physical core count, thread group and cache hierarchy information.
+    GetProcessorInfo(Topology, cacheMap, processorCache, processorMappings);
+
+    // Get CPPC ranking.
+    GetCPPCRanking(Topology, processorMappings);
+
+    // Get memory nodes, CPU-less ones included.
+    GetMemoryNodes(Topology);
+
+    ConsolidateTopology(*this, cacheMap, processorCache, processorMappings);
+
+    // Load or measure the core latency matrix.
+    AttachMeasurements(*this);
+    SaveTopologySnapshot(*this);
+}
+#elif defined(__linux__)
+CpuTopology::CpuTopology() : CpuTopology(defaultSysRoot()) {
+}
+
+
+CpuTopology::CpuTopology(const std::string& root) {
+    std::vector<char> buffer(sysFileBufferSize);
+
+    // Linux has no processor group, every logical processor lives in group 0.
+    processorGroups = 1;
+
+    /* Get CPU family from cpuid. */
+    getCPUidFamily(family, model);
+
+    // Get CPU name from cpuid.
+    getCPUidName(name);
+
+    // Get CPU vendor from cpuid
+    getCPUidVendor(vendor);
+
+    // Get ISA feature flags from cpuid.
+    isa = hostIsa();
+
+    // Skip discovery when a snapshot of this host exists, the online count is part of the fingerprint.
+    if (root.empty() && readSysFile(root + "/sys/devices/system/cpu/online", buffer)) {
+        auto online = CpuSet::fromList(buffer.data());
+        logicalProcessors = online.count();
+        if (LoadTopologySnapshot(*this, online)) {
+            RefreshFreeMemory(Topology, root, buffer);
+            AttachMeasurements(*this);
+            return;
+        }
+    }
+
+    // Get total system memory.
+    if (readSysFile(root + "/proc/meminfo", buffer)) {
+        systemMemory = parseMemInfo(buffer.data(), "MemTotal:");
+    }
+
+    // Temporary set of cache levels.
+    std::map<uint64_t, CacheInfo> cacheMap;
+
+    // Temporary set of core cache.
+    ProcessorCaches processorCache;
+
+    // Temporary logical process to core index mappings for re-indexing complex groups, numa nodes, processor groups and socket.
+    ProcessorMappings processorMappings;
+
+    // Get physical core count, socket and cache hierarchy information from sysfs.
+    GetProcessorInfo(Topology, cacheMap, processorCache, processorMappings, root, buffer);
+    logicalProcessors = static_cast<uint32_t>(processorMappings.size());
+
+    // Get efficiency and scheduling classes from sysfs, a hybrid CPU the kernel says nothing about is asked directly.
+    GetCoreClasses(Topology, root, buffer);
+    if (root.empty()) {
+        getCPUidCoreTypes(Topology);
+    }
+
+    // Get NUMA nodes from sysfs.
+    GetNumaInfo(Topology, processorMappings, root, buffer);
+
+    // Get memory nodes from sysfs, CPU-less ones included.
+    GetMemoryNodes(Topology, root, buffer);
+
+    ConsolidateTopology(*this, cacheMap, processorCache, processorMappings);
+
+    // Measured data belongs to the running host, not to a captured tree.
+    if (root.empty()) {
+        AttachMeasurements(*this);
+        SaveTopologySnapshot(*this);
+    }
+}
+
+
+void CpuTopology::getCPUidCoreTypes(TopologyInfo& Topology) {
+    if (!getCPUidCoreType()) {
+        return;
+    }
+    for (const auto& core : Topology.cores) {
+        if (core.efficiencyClass != std::numeric_limits<uint32_t>::max()) {
+            return;
+        }
+    }
+
+    // CPUID answers for the processor it runs on, so a helper thread visits every core.
+    // The probing thread is thrown away instead of restoring the caller's affinity.
+    std::thread probe([&Topology]() {
+        for (auto& core : Topology.cores) {
+            CpuSet processor;
+            processor.set(CpuSet::index(core.sysProcessorGroup, core.sysLogicalProcessors.front()));
+            if (!bindCurrentThread(processor)) {
+                continue;
+            }
+            auto type = getCPUidCoreType();
+            if (type == coreTypeCore) {
+                core.efficiencyClass = 1;
+            }
+            else if (type == coreTypeAtom) {
+                core.efficiencyClass = 0;
+            }
+        }
+    });
+    probe.join();
 }
+#endif
+
+
+CpuTopology::CpuTopology(const SyntheticLayout& layout) {
+    processorGroups = 1;
+    family = 0;
+    model = 0;
+    name = "Synthetic " + std::to_string(layout.sockets) + "x" + std::to_string(layout.numaNodesPerSocket) + "x" +
+        std::to_string(layout.complexGroupsPerNumaNode) + "x" + std::to_string(layout.coresPerComplexGroup) + "x" +
+        std::to_string(layout.threadsPerCore);
+    vendor = "Synthetic";
+
+    std::map<uint64_t, CacheInfo> cacheMap;
+    ProcessorCaches processorCache;
+    ProcessorMappings processorMappings;
+
+    GetSyntheticInfo(layout, Topology, cacheMap, processorCache, processorMappings);
+    logicalProcessors = processorMappings.size();
+    systemMemory = (Topology.numaNodes.size() * layout.numaNodeMemory +
+        Topology.sockets.size() * layout.memoryOnlyNodesPerSocket * layout.memoryOnlyNodeMemory) / 1024;
+
+    ConsolidateTopology(*this, cacheMap, processorCache, processorMappings);
+}
+
+
+CpuTopology::CpuTopology(const CpuidTopology& source) {
+    processorGroups = 0;
+    for (const auto& processor : source.processors) {
+        processorGroups = std::max(processorGroups, processor.index / CpuSet::wordBits + 1);
+    }
+    getCPUidFamily(family, model);
+    getCPUidName(name);
+    getCPUidVendor(vendor);
+    isa = hostIsa();
+    systemMemory = 0;
+
+    std::map<uint64_t, CacheInfo> cacheMap;
+    ProcessorCaches processorCache;
+    ProcessorMappings processorMappings;
+
+    GetCpuidInfo(source, Topology, cacheMap, processorCache, processorMappings);
+    logicalProcessors = processorMappings.size();
+
+    ConsolidateTopology(*this, cacheMap, processorCache, processorMappings);
+}
+
+
+CpuTopology::CpuTopology(const CpuTopology& source, const ProcessLimits& limits) {
+    processorGroups = 0;
+    family = source.family;
+    model = source.model;
+    name = source.name;
+    vendor = source.vendor;
+    isa = source.isa;
+    systemMemory = source.systemMemory;
+    cpuQuota = limits.cpuQuota;
+    caches = source.caches;
+
+    const auto& from = source.Topology;
+    constexpr auto none = std::numeric_limits<uint32_t>::max();
+    auto keep = [&](uint32_t sysProcessorGroup, const std::vector<uint32_t>& processors) {
+        std::vector<uint32_t> kept;
+        for (auto processor : processors) {
+            if (limits.allowed.test(CpuSet::index(sysProcessorGroup, processor))) {
+                kept.push_back(processor);
+            }
+        }
+        return kept;
+    };
+
+    // Old id -> new id of every level, none for a pruned one.
+    std::vector<uint32_t> coreIDs(from.cores.size(), none);
+    std::vector<uint32_t> complexGroupIDs(from.complexGroups.size(), none);
+    std::vector<uint32_t> numaNodeIDs(from.numaNodes.size(), none);
+    std::vector<uint32_t> socketIDs(from.sockets.size(), none);
+    uint32_t cores = 0;
+    for (const auto& core : from.cores) {
+        if (!keep(core.sysProcessorGroup, core.sysLogicalProcessors).empty()) {
+            coreIDs[core.id] = cores++;
+        }
+    }
+    auto number = [&](const auto& levels, auto& ids) {
+        uint32_t count = 0;
+        for (const auto& level : levels) {
+            if (std::any_of(level.cores.cbegin(), level.cores.cend(), [&](const auto* core) { return coreIDs[core->id] != none; })) {
+                ids[level.id] = count++;
+            }
+        }
+        return count;
+    };
+    Topology.cores.resize(cores);
+    Topology.complexGroups.resize(number(from.complexGroups, complexGroupIDs));
+    Topology.numaNodes.resize(number(from.numaNodes, numaNodeIDs));
+    Topology.sockets.resize(number(from.sockets, socketIDs));
+
+    // Every level is sized, the pointers below stay valid.
+    auto link = [](const auto* level, const std::vector<uint32_t>& ids, auto& targets) {
+        return level && ids[level->id] != none ? &targets[ids[level->id]] : nullptr;
+    };
+    auto links = [](const auto& levels, const std::vector<uint32_t>& ids, auto& targets) {
+        std::vector<typename std::remove_reference_t<decltype(targets)>::value_type*> result;
+        for (const auto* level : levels) {
+            if (ids[level->id] != none) {
+                result.push_back(&targets[ids[level->id]]);
+            }
+        }
+        return result;
+    };
+
+    for (const auto& sourceCore : from.cores) {
+        if (coreIDs[sourceCore.id] == none) {
+            continue;
+        }
+        auto& core = Topology.cores[coreIDs[sourceCore.id]];
+        core = sourceCore;
+        core.id = coreIDs[sourceCore.id];
+        core.complexGroup = link(sourceCore.complexGroup, complexGroupIDs, Topology.complexGroups);
+        core.numaNode = link(sourceCore.numaNode, numaNodeIDs, Topology.numaNodes);
+        core.socket = link(sourceCore.socket, socketIDs, Topology.sockets);
+        core.sysLogicalProcessors = keep(core.sysProcessorGroup, sourceCore.sysLogicalProcessors);
+        core.SMT = core.sysLogicalProcessors.size() > 1;
+        core.cpuSet = CpuSet();
+    }
+
+    for (const auto& sourceComplexGroup : from.complexGroups) {
+        if (complexGroupIDs[sourceComplexGroup.id] == none) {
+            continue;
+        }
+        auto& complexGroup = Topology.complexGroups[complexGroupIDs[sourceComplexGroup.id]];
+        complexGroup.id = complexGroupIDs[sourceComplexGroup.id];
+        complexGroup.numaNode = link(sourceComplexGroup.numaNode, numaNodeIDs, Topology.numaNodes);
+        complexGroup.sysNumaNode = sourceComplexGroup.sysNumaNode;
+        complexGroup.socket = link(sourceComplexGroup.socket, socketIDs, Topology.sockets);
+        complexGroup.sysProcessorGroup = sourceComplexGroup.sysProcessorGroup;
+        complexGroup.sysLogicalProcessors = keep(complexGroup.sysProcessorGroup, sourceComplexGroup.sysLogicalProcessors);
+        complexGroup.cores = links(sourceComplexGroup.cores, coreIDs, Topology.cores);
+    }
+
+    for (const auto& sourceNumaNode : from.numaNodes) {
+        if (numaNodeIDs[sourceNumaNode.id] == none) {
+            continue;
+        }
+        auto& numaNode = Topology.numaNodes[numaNodeIDs[sourceNumaNode.id]];
+        numaNode.id = numaNodeIDs[sourceNumaNode.id];
+        numaNode.sysNumaNode = sourceNumaNode.sysNumaNode;
+        numaNode.socket = link(sourceNumaNode.socket, socketIDs, Topology.sockets);
+        numaNode.sysProcessorGroup = sourceNumaNode.sysProcessorGroup;
+        numaNode.availableMemory = sourceNumaNode.availableMemory;
+        numaNode.sysLogicalProcessors = keep(numaNode.sysProcessorGroup, sourceNumaNode.sysLogicalProcessors);
+        numaNode.cores = links(sourceNumaNode.cores, coreIDs, Topology.cores);
+        numaNode.complexGroups = links(sourceNumaNode.complexGroups, complexGroupIDs, Topology.complexGroups);
+    }
+
+    for (const auto& sourceSocket : from.sockets) {
+        if (socketIDs[sourceSocket.id] == none) {
+            continue;
+        }
+        auto& socket = Topology.sockets[socketIDs[sourceSocket.id]];
+        socket.id = socketIDs[sourceSocket.id];
+        for (const auto& sourceProcessors : sourceSocket.processorsStructs) {
+            TopologyInfo::SocketInfo::SocketProcessors processorStruct;
+            processorStruct.sysProcessorGroup = sourceProcessors.sysProcessorGroup;
+            processorStruct.sysLogicalProcessors = keep(processorStruct.sysProcessorGroup, sourceProcessors.sysLogicalProcessors);
+            if (!processorStruct.sysLogicalProcessors.empty()) {
+                socket.processorsStructs.push_back(std::move(processorStruct));
+            }
+        }
+        socket.cores = links(sourceSocket.cores, coreIDs, Topology.cores);
+        socket.complexGroups = links(sourceSocket.complexGroups, complexGroupIDs, Topology.complexGroups);
+        socket.numaNodes = links(sourceSocket.numaNodes, numaNodeIDs, Topology.numaNodes);
+        for (const auto* numaNode : socket.numaNodes) {
+            socket.sysNumaNodes.push_back(numaNode->sysNumaNode);
+        }
+    }
+
+    // Square matrices keep the rows and columns of the kept cores and nodes.
+    auto submatrix = [](const auto& matrix, const std::vector<uint32_t>& ids, uint32_t count) {
+        std::remove_const_t<std::remove_reference_t<decltype(matrix)>> result;
+        if (matrix.size() != ids.size() * ids.size()) {
+            return result;
+        }
+        result.resize(static_cast<size_t>(count) * count);
+        for (size_t row = 0; row < ids.size(); ++row) {
+            for (size_t column = 0; column < ids.size(); ++column) {
+                if (ids[row] != std::numeric_limits<uint32_t>::max() && ids[column] != std::numeric_limits<uint32_t>::max()) {
+                    result[static_cast<size_t>(ids[row]) * count + ids[column]] = matrix[row * ids.size() + column];
+                }
+            }
+        }
+        return result;
+    };
+    // Memory is not limited by the processors, every memory node stays. Distances keep the kept NUMA nodes,
+    // a memory node whose NUMA node was dropped is served by the nearest kept one.
+    for (const auto& sourceMemoryNode : from.memoryNodes) {
+        auto memoryNode = sourceMemoryNode;
+        memoryNode.numaNode = link(sourceMemoryNode.numaNode, numaNodeIDs, Topology.numaNodes);
+        memoryNode.nearestNumaNode = link(sourceMemoryNode.nearestNumaNode, numaNodeIDs, Topology.numaNodes);
+        memoryNode.distances.clear();
+        if (sourceMemoryNode.distances.size() == numaNodeIDs.size()) {
+            memoryNode.distances.resize(Topology.numaNodes.size());
+            for (size_t i = 0; i < numaNodeIDs.size(); ++i) {
+                if (numaNodeIDs[i] != none) {
+                    memoryNode.distances[numaNodeIDs[i]] = sourceMemoryNode.distances[i];
+                }
+            }
+        }
+        if (!memoryNode.nearestNumaNode) {
+            for (size_t i = 0; i < memoryNode.distances.size(); ++i) {
+                if (!memoryNode.nearestNumaNode || memoryNode.distances[i] < memoryNode.distances[memoryNode.nearestNumaNode->id]) {
+                    memoryNode.nearestNumaNode = &Topology.numaNodes[i];
+                }
+            }
+        }
+        Topology.memoryNodes.push_back(std::move(memoryNode));
+    }
+
+    const auto numaNodeCount = static_cast<uint32_t>(Topology.numaNodes.size());
+    Topology.coreLatencies = submatrix(from.coreLatencies, coreIDs, cores);
+    Topology.numaDistances = submatrix(from.numaDistances, numaNodeIDs, numaNodeCount);
+    Topology.numaLatencies = submatrix(from.numaLatencies, numaNodeIDs, numaNodeCount);
+    Topology.numaReadBandwidths = submatrix(from.numaReadBandwidths, numaNodeIDs, numaNodeCount);
+    Topology.numaCopyBandwidths = submatrix(from.numaCopyBandwidths, numaNodeIDs, numaNodeCount);
+
+    ConsolidateCpuSets(Topology);
+    ConsolidateFlatTopology(Topology, FlatTopology);
+
+    physicalCores = static_cast<uint32_t>(Topology.cores.size());
+    logicalProcessors = Topology.cpuSet.count();
+    complexGroups = static_cast<uint32_t>(Topology.complexGroups.size());
+    for (const auto& i : Topology.complexGroups) {
+        complexGroupSizes.push_back(static_cast<uint32_t>(i.cores.size()));
+    }
+    sockets = static_cast<uint32_t>(Topology.sockets.size());
+    numaNodes = numaNodeCount;
+    for (uint32_t word = 0; word < CpuSet::words; ++word) {
+        processorGroups += Topology.cpuSet.bits[word] != 0;
+    }
+}
+
+
+CpuTopology::ProcessLimits CpuTopology::processLimits() {
+    ProcessLimits limits;
+#if defined(_WIN32)
+    limits.allowed = processAffinity();
+    limits.cpuQuota = GetJobCpuQuota(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS));
+#elif defined(__linux__)
+    // A captured tree carries its own cgroup files, the affinity of this process means nothing for it.
+    auto root = defaultSysRoot();
+    if (root.empty()) {
+        limits.allowed = processAffinity();
+    }
+    else {
+        for (auto& word : limits.allowed.bits) {
+            word = ~uint64_t(0);
+        }
+    }
+    std::vector<char> buffer(sysFileBufferSize);
+    GetCgroupLimits(root, limits.allowed, limits.cpuQuota, buffer);
+#endif
+    return limits;
+}
+
+
+std::vector<CpuTopology::TopologyInfo::HugePageInfo> CpuTopology::readHugePages(uint32_t sysNumaNode) {
+#if defined(__linux__)
+    std::vector<char> buffer(sysFileBufferSize);
+    return ReadHugePages(defaultSysRoot() + "/sys/devices/system/node/node" + std::to_string(sysNumaNode) + "/", buffer);
+#else
+    (void)sysNumaNode;
+    return {};
+#endif
+}
+
+
+const CpuTopology& CpuTopology::process() {
+    static const CpuTopology info(get(), processLimits());
+    return info;
+}
+
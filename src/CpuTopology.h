@@ -1,12 +1,22 @@
 #pragma once
 
 
+#include <cstdint>
 #include <limits>
 #include <string>
 #include <vector>
 
+#if defined(_MSC_VER)
 #include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 
+#include "CpuSet.h"
+#include "IsaFeatures.h"
+
+
+class CpuidTopology;
 
 struct CpuTopology {
     /* Number of CPU sockets. */
@@ -38,8 +48,13 @@ struct CpuTopology {
     std::string name;
     /* CPU vendor. */
     std::string vendor;
+    /* Instruction set extensions of the CPU that the OS enabled, see hostIsa(). Empty for synthetic layouts. */
+    IsaFeatures isa;
     /* System memory size in KBs. */
     uint64_t systemMemory = std::numeric_limits<uint32_t>::max();
+    /* CPU time the process may use in logical processors, the cgroup cpu.max quota / period
+       (the job object hard cap on Windows). 0 means unlimited, only process views set it. */
+    float cpuQuota = 0.0f;
 
     enum class CacheType {
         /* Error cache type. */
@@ -73,6 +88,17 @@ struct CpuTopology {
             return *this;
         }
     };
+
+    /* Cache behaviour measured by probeCoreCaches(), please see CacheProbe.h. */
+    struct MeasuredCacheInfo {
+        /* Largest working set one core still reads at this level's latency in bytes, 0 if not measured. */
+        uint32_t effectiveSize = 0;
+        /* Dependent load latency in ns. */
+        float latency = 0.0f;
+        /* Streaming read bandwidth of one core in GB/s. */
+        float bandwidth = 0.0f;
+    };
+
     /* shared variable in caches vector always equals to logicalProcessors
        as it counts the total amout of each cache level.
        Please use the shared varialbe in cores.caches vecotr. */
@@ -113,8 +139,12 @@ struct CpuTopology {
             uint32_t schedulingClass = std::numeric_limits<uint32_t>::max();
             /* System logical processor group id. */
             std::vector<uint32_t> sysLogicalProcessors;
+            /* Bitmask of sysLogicalProcessors. */
+            CpuSet cpuSet;
             /* The cache this core can access. */
             std::vector<CacheInfo> caches;
+            /* Measured counterpart of each entry of caches, empty until probed. */
+            std::vector<MeasuredCacheInfo> measuredCaches;
         };
         std::vector<CoreInfo> cores;
 
@@ -132,6 +162,8 @@ struct CpuTopology {
             uint32_t sysProcessorGroup = std::numeric_limits<uint32_t>::max();
             /* System logical processor group id. */
             std::vector<uint32_t> sysLogicalProcessors;
+            /* Bitmask of sysLogicalProcessors. */
+            CpuSet cpuSet;
             /* Physical cores pointer in TopologyInfo. */
             std::vector<CoreInfo*> cores;
         };
@@ -151,6 +183,8 @@ struct CpuTopology {
             uint64_t availableMemory = std::numeric_limits<uint32_t>::max();
             /* System logical processor group id. */
             std::vector<uint32_t> sysLogicalProcessors;
+            /* Bitmask of sysLogicalProcessors. */
+            CpuSet cpuSet;
             /* Physical cores pointer in TopologyInfo. */
             std::vector<CoreInfo*> cores;
             /* Complex groups pointer in TopologyInfo. */
@@ -170,6 +204,8 @@ struct CpuTopology {
             };
             /* Group system processor group and system logical processors. */
             std::vector <SocketProcessors> processorsStructs;
+            /* Bitmask of every processorsStructs. */
+            CpuSet cpuSet;
             /* Physical cores pointer in TopologyInfo. */
             std::vector<CoreInfo*> cores;
             /* Complex groups pointer in TopologyInfo. */
@@ -180,31 +216,419 @@ struct CpuTopology {
             std::vector<uint32_t> sysNumaNodes;
         };
         std::vector<SocketInfo> sockets;
+
+        /* Huge page pool of one page size on one node. */
+        struct HugePageInfo {
+            /* Page size in bytes, e.g. 2 MB or 1 GB. */
+            uint64_t size = 0;
+            /* Pages in the pool. */
+            uint64_t total = 0;
+            /* Pages of the pool not in use, as of discovery or snapshot load. Please see readHugePages() for a current count. */
+            uint64_t free = 0;
+        };
+
+        /* Memory target: every system NUMA node with memory, the CPU-less ones (CXL expanders,
+           HBM in flat mode, persistent memory as system RAM) included. */
+        struct MemoryNodeInfo {
+            /* Memory node id in TopologyInfo. */
+            uint32_t id = std::numeric_limits<uint32_t>::max();
+            /* System NUMA id. */
+            uint32_t sysNumaNode = std::numeric_limits<uint32_t>::max();
+            /* NUMA node pointer in TopologyInfo, null for a node without logical processors. */
+            NumaNodeInfo* numaNode = nullptr;
+            /* NUMA node with logical processors at the smallest distance, numaNode itself when it is set. */
+            NumaNodeInfo* nearestNumaNode = nullptr;
+            /* Kernel memory tier (memory_tiering/memory_tierN), lower is faster, DRAM is usually 4.
+               Max uint32_t when the kernel has no memory tiers. */
+            uint32_t memoryTier = std::numeric_limits<uint32_t>::max();
+            /* Memory size and free memory in bytes, the latter as of discovery or snapshot load. */
+            uint64_t totalMemory = 0;
+            uint64_t availableMemory = 0;
+            /* ACPI HMAT performance from the best initiators (nodeN/access0/initiators), 0 when firmware has no HMAT.
+               Bandwidth in MB/s, latency in ns. */
+            uint32_t readBandwidth = 0;
+            uint32_t writeBandwidth = 0;
+            uint32_t readLatency = 0;
+            uint32_t writeLatency = 0;
+            /* System NUMA ids of the best initiators, the nodes whose processors reach this memory fastest. */
+            std::vector<uint32_t> initiators;
+            /* SLIT distance from every NUMA node of numaNodes to this memory, in numaNodes order.
+               Empty where numaDistances is. */
+            std::vector<uint32_t> distances;
+            /* Huge page pools by ascending page size. */
+            std::vector<HugePageInfo> hugePages;
+        };
+        std::vector<MemoryNodeInfo> memoryNodes;
+
+        /* Every logical processor of the system. */
+        CpuSet cpuSet;
+        /* The first logical processor of every core,
+           e.g. numaNodes[i].cpuSet & primaryProcessors skips the SMT siblings. */
+        CpuSet primaryProcessors;
+
+        /* One-way cache line transfer latency between cores in ns,
+           cores.size() * cores.size() row-major, empty until measured or loaded.
+           Please see CoreLatency.h. */
+        std::vector<float> coreLatencies;
+
+        float coreLatency(uint32_t core, uint32_t otherCore) const {
+            return coreLatencies[core * cores.size() + otherCore];
+        }
+
+        /* ACPI SLIT distance between NUMA nodes, numaNodes.size() * numaNodes.size() row-major,
+           10 means local. Filled on Linux, empty on Windows which does not report it. */
+        std::vector<uint32_t> numaDistances;
+
+        /* Probed from the cores of the row node to the memory of the column node,
+           numaNodes.size() * numaNodes.size() row-major, empty until probed or loaded.
+           Please see NumaProbe.h. */
+        /* Dependent load latency in ns. */
+        std::vector<float> numaLatencies;
+        /* Streaming read bandwidth of all cores of the row node in GB/s. */
+        std::vector<float> numaReadBandwidths;
+        /* Streaming copy bandwidth of all cores of the row node in GB/s. */
+        std::vector<float> numaCopyBandwidths;
+
+        uint32_t numaDistance(uint32_t numaNode, uint32_t otherNumaNode) const {
+            return numaDistances[numaNode * numaNodes.size() + otherNumaNode];
+        }
+
+        /* Memory node of a system NUMA id, nullptr if the node has no memory. */
+        const MemoryNodeInfo* memoryNode(uint32_t sysNumaNode) const {
+            for (const auto& memoryNode : memoryNodes) {
+                if (memoryNode.sysNumaNode == sysNumaNode) {
+                    return &memoryNode;
+                }
+            }
+            return nullptr;
+        }
     } Topology;
 
+
+    /* Contiguous, index-based copy of Topology kept for fast queries.
+       Every link is a 16 bit logical id, so resolving a logical processor
+       to its core, complex group, NUMA node and socket is one 8 byte load. */
+    struct FlatTopologyInfo {
+        /* Logical id meaning "not linked". */
+        static constexpr uint16_t none = std::numeric_limits<uint16_t>::max();
+
+        struct ProcessorLocation {
+            uint16_t core = none;
+            uint16_t complexGroup = none;
+            uint16_t numaNode = none;
+            uint16_t socket = none;
+        };
+        /* Indexed by CpuSet::index of a logical processor. */
+        std::vector<ProcessorLocation> processors;
+
+        /* Per core links, indexed by the core id. */
+        std::vector<uint16_t> coreComplexGroups;
+        std::vector<uint16_t> coreNumaNodes;
+        std::vector<uint16_t> coreSockets;
+
+        /* Per complex group links, indexed by the complex group id. */
+        std::vector<uint16_t> complexGroupNumaNodes;
+        std::vector<uint16_t> complexGroupSockets;
+
+        /* Per NUMA node link, indexed by the NUMA node id. */
+        std::vector<uint16_t> numaNodeSockets;
+
+        /* Caches of core i are coreCaches[coreCacheOffsets[i]] ~ coreCaches[coreCacheOffsets[i + 1] - 1]. */
+        std::vector<uint32_t> coreCacheOffsets;
+        std::vector<CacheInfo> coreCaches;
+
+        /* Location of a logical processor, nullptr if it is unknown. */
+        const ProcessorLocation* locate(uint32_t sysProcessorGroup, uint32_t sysLogicalProcessor) const {
+            auto index = CpuSet::index(sysProcessorGroup, sysLogicalProcessor);
+            return index < processors.size() && processors[index].core != none ? &processors[index] : nullptr;
+        }
+
+        /* Location of the processor the calling thread runs on, nullptr if it is unknown.
+           One currentProcessor() and a table load, cheap enough to pick a shard on every operation. */
+        const ProcessorLocation* current() const {
+            auto index = currentProcessor();
+            return index < processors.size() && processors[index].core != none ? &processors[index] : nullptr;
+        }
+
+        /* Number of caches of a core. */
+        uint32_t cacheCount(uint32_t core) const {
+            return coreCacheOffsets[core + 1] - coreCacheOffsets[core];
+        }
+
+        /* First cache of a core, followed by cacheCount(core) - 1 more. */
+        const CacheInfo* caches(uint32_t core) const {
+            return coreCaches.data() + coreCacheOffsets[core];
+        }
+    } FlatTopology;
+
+    /* Parameters of a synthetic topology, every count is per instance of the parent level. */
+    struct SyntheticLayout {
+        uint32_t sockets = 1;
+        uint32_t numaNodesPerSocket = 1;
+        /* Complex groups (CCD, CCX or L3 slice) per NUMA node. */
+        uint32_t complexGroupsPerNumaNode = 1;
+        uint32_t coresPerComplexGroup = 8;
+        /* SMT width. */
+        uint32_t threadsPerCore = 2;
+
+        uint32_t l1DataSize = 48 * 1024;
+        uint32_t l1InstructionSize = 32 * 1024;
+        uint32_t l2Size = 1024 * 1024;
+        /* Per complex group. */
+        uint32_t l3Size = 32 * 1024 * 1024;
+        /* Per NUMA node in bytes. */
+        uint64_t numaNodeMemory = uint64_t(64) << 30;
+        /* CPU-less memory nodes per socket, e.g. CXL expanders, in a slower memory tier.
+           Their system ids follow those of the NUMA nodes with cores. */
+        uint32_t memoryOnlyNodesPerSocket = 0;
+        /* Per CPU-less node in bytes. */
+        uint64_t memoryOnlyNodeMemory = uint64_t(256) << 30;
+    };
+
     static const CpuTopology& get() {
         static const CpuTopology info;
         return info;
     }
 
+    /* Instruction set extensions of the running CPU, read with cpuid and checked against XGETBV
+       so register state the OS does not save is never reported. Computed once, without discovery. */
+    static const IsaFeatures& hostIsa() {
+        static const IsaFeatures features = getCPUidFeatures();
+        return features;
+    }
+
+    /* What the process may use: the processors it may run on and its CPU quota. */
+    struct ProcessLimits {
+        /* Affinity mask intersected with the cgroup v1/v2 cpuset on Linux,
+           the process group affinity on Windows. */
+        CpuSet allowed;
+        /* Same as CpuTopology::cpuQuota. */
+        float cpuQuota = 0.0f;
+    };
+
+    /* Read the limits of the running process. */
+    static ProcessLimits processLimits();
+
+    /* Current huge page pools of a system NUMA node by ascending page size, empty on Windows
+       which has no per-node pools. Cheap enough to call before every large allocation. */
+    static std::vector<TopologyInfo::HugePageInfo> readHugePages(uint32_t sysNumaNode);
+
+    /* View of get() restricted to processLimits(), see CpuTopology(const CpuTopology&, const ProcessLimits&). */
+    static const CpuTopology& process();
+
+    /* Number of threads worth running: logicalProcessors capped by cpuQuota.
+       The quota rounds down, a thread more than the quota only gets throttled. */
+    uint32_t effectiveParallelism() const {
+        if (cpuQuota <= 0.0f || cpuQuota >= static_cast<float>(logicalProcessors)) {
+            return logicalProcessors;
+        }
+        return cpuQuota < 1.0f ? 1 : static_cast<uint32_t>(cpuQuota);
+    }
+
+#if defined(__linux__)
+    /* Build the topology from a sysfs/procfs tree captured under root,
+       i.e. root/sys/devices/system/{cpu,node} and root/proc/meminfo.
+       An empty root reads the running system.
+       get() honors the CPU_TOPOLOGY_ROOT environment variable. */
+    explicit CpuTopology(const std::string& root);
+#endif
+    /* Build the topology of layout instead of the running system, through the same consolidation as discovery.
+       Logical processors are numbered like Linux: the first thread of every core, then the second one and so on.
+       Cores beyond CpuSet::maxProcessors logical processors are dropped. */
+    explicit CpuTopology(const SyntheticLayout& layout);
+    /* Build the topology cpuid reports on every processor of source: a core per core id, a complex group per
+       last level cache, a socket per package. cpuid knows nothing of memory, each package is one NUMA node
+       without memory. Please see CpuidTopology.h. */
+    explicit CpuTopology(const CpuidTopology& source);
+    /* Copy of source restricted to limits.allowed. Cores, complex groups, NUMA nodes and sockets left
+       without a logical processor are dropped and the rest renumbered, links and matrices follow. */
+    CpuTopology(const CpuTopology& source, const ProcessLimits& limits);
+    ~CpuTopology() = default;
+
+    /* Hash of name, family, model and logical processor count,
+       measured data persisted for another host is rejected with it. */
+    uint64_t fingerprint() const;
+
+    /* Directory for persisted measurements: CPU_TOPOLOGY_CACHE,
+       else $XDG_CACHE_HOME/cpu_topology or ~/.cache/cpu_topology (%LOCALAPPDATA%\cpu_topology on Windows). */
+    static std::string cacheDirectory();
+
 private:
+    friend class TopologyMonitor;
+    friend class CpuidTopology;
+
     CpuTopology();
-    ~CpuTopology() = default;
     CpuTopology(CpuTopology&) = delete;
     CpuTopology(CpuTopology&&) = delete;
 
     CpuTopology& operator = (CpuTopology&) = delete;
     CpuTopology& operator = (CpuTopology&&) = delete;
 
+    /* Portable cpuid, all registers are zero on non-x86 targets. */
+    static void cpuid(int cpui[4], int leaf) {
+#if defined(_MSC_VER)
+        __cpuid(cpui, leaf);
+#elif defined(__x86_64__) || defined(__i386__)
+        unsigned int regs[4] = { 0 };
+        __cpuid(leaf, regs[0], regs[1], regs[2], regs[3]);
+        for (auto i = 0; i < 4; ++i) {
+            cpui[i] = static_cast<int>(regs[i]);
+        }
+#else
+        (void)leaf;
+        cpui[0] = cpui[1] = cpui[2] = cpui[3] = 0;
+#endif
+    }
+
+    /* cpuid with a subleaf in ecx. */
+    static void cpuidex(int cpui[4], int leaf, int subleaf) {
+#if defined(_MSC_VER)
+        __cpuidex(cpui, leaf, subleaf);
+#elif defined(__x86_64__) || defined(__i386__)
+        unsigned int regs[4] = { 0 };
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+        for (auto i = 0; i < 4; ++i) {
+            cpui[i] = static_cast<int>(regs[i]);
+        }
+#else
+        (void)leaf;
+        (void)subleaf;
+        cpui[0] = cpui[1] = cpui[2] = cpui[3] = 0;
+#endif
+    }
+
+    /* Extended control register, 0 on non-x86 targets. */
+    static uint64_t xgetbv(uint32_t index) {
+#if defined(_MSC_VER)
+        return _xgetbv(index);
+#elif defined(__x86_64__) || defined(__i386__)
+        uint32_t eax = 0;
+        uint32_t edx = 0;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#else
+        (void)index;
+        return 0;
+#endif
+    }
+
+    /* Get the ISA feature flags via cpuid, features whose register state XCR0 does not enable are dropped. */
+    static IsaFeatures getCPUidFeatures() {
+        IsaFeatures features;
+        int cpui[4] = { 0 };
+        cpuid(cpui, 0);
+        const auto maxLeaf = cpui[0];
+        if (maxLeaf < 1) {
+            return features;
+        }
+
+        auto bit = [](int reg, int index) { return ((static_cast<uint32_t>(reg) >> index) & 1) != 0; };
+        auto add = [&](bool present, IsaFeature feature) {
+            if (present) {
+                features.set(feature);
+            }
+        };
+
+        cpuid(cpui, 1);
+        const int ecx1 = cpui[2];
+        const int edx1 = cpui[3];
+
+        // XMM|YMM, opmask|ZMM_Hi256|Hi16_ZMM and XTILECFG|XTILEDATA state components.
+        const auto xcr0 = bit(ecx1, 27) ? xgetbv(0) : 0;
+        const bool avxState = (xcr0 & 0x6) == 0x6;
+        const bool avx512State = avxState && (xcr0 & 0xE0) == 0xE0;
+        const bool amxState = (xcr0 & 0x60000) == 0x60000;
+
+        add(bit(edx1, 26), IsaFeature::sse2);
+        add(bit(ecx1, 0), IsaFeature::sse3);
+        add(bit(ecx1, 9), IsaFeature::ssse3);
+        add(bit(ecx1, 19), IsaFeature::sse41);
+        add(bit(ecx1, 20), IsaFeature::sse42);
+        add(bit(ecx1, 23), IsaFeature::popcnt);
+        add(bit(ecx1, 25), IsaFeature::aes);
+        add(bit(ecx1, 1), IsaFeature::pclmulqdq);
+        add(avxState && bit(ecx1, 28), IsaFeature::avx);
+        add(avxState && bit(ecx1, 12), IsaFeature::fma);
+        add(avxState && bit(ecx1, 29), IsaFeature::f16c);
+
+        if (maxLeaf >= 7) {
+            cpuidex(cpui, 7, 0);
+            const int subleaves = cpui[0];
+            const int ebx7 = cpui[1];
+            const int ecx7 = cpui[2];
+            const int edx7 = cpui[3];
+            add(bit(ebx7, 3), IsaFeature::bmi1);
+            add(bit(ebx7, 8), IsaFeature::bmi2);
+            add(bit(ebx7, 29), IsaFeature::sha);
+            add(bit(ecx7, 8), IsaFeature::gfni);
+            add(avxState && bit(ebx7, 5), IsaFeature::avx2);
+            add(avxState && bit(ecx7, 9), IsaFeature::vaes);
+            add(avxState && bit(ecx7, 10), IsaFeature::vpclmulqdq);
+            add(avx512State && bit(ebx7, 16), IsaFeature::avx512f);
+            add(avx512State && bit(ebx7, 17), IsaFeature::avx512dq);
+            add(avx512State && bit(ebx7, 21), IsaFeature::avx512ifma);
+            add(avx512State && bit(ebx7, 28), IsaFeature::avx512cd);
+            add(avx512State && bit(ebx7, 30), IsaFeature::avx512bw);
+            add(avx512State && bit(ebx7, 31), IsaFeature::avx512vl);
+            add(avx512State && bit(ecx7, 1), IsaFeature::avx512vbmi);
+            add(avx512State && bit(ecx7, 6), IsaFeature::avx512vbmi2);
+            add(avx512State && bit(ecx7, 11), IsaFeature::avx512vnni);
+            add(avx512State && bit(ecx7, 12), IsaFeature::avx512bitalg);
+            add(avx512State && bit(ecx7, 14), IsaFeature::avx512vpopcntdq);
+            add(avx512State && bit(edx7, 23), IsaFeature::avx512fp16);
+            add(amxState && bit(edx7, 22), IsaFeature::amxBf16);
+            add(amxState && bit(edx7, 24), IsaFeature::amxTile);
+            add(amxState && bit(edx7, 25), IsaFeature::amxInt8);
+
+            if (subleaves >= 1) {
+                cpuidex(cpui, 7, 1);
+                add(avxState && bit(cpui[0], 4), IsaFeature::avxVnni);
+                add(avx512State && bit(cpui[0], 5), IsaFeature::avx512bf16);
+            }
+        }
+
+        cpuid(cpui, static_cast<int>(0x80000000));
+        if (static_cast<unsigned int>(cpui[0]) >= 0x80000001) {
+            cpuid(cpui, static_cast<int>(0x80000001));
+            add(bit(cpui[2], 5), IsaFeature::lzcnt);
+        }
+        return features;
+    }
+
+    /* Core types of cpuid leaf 0x1A. */
+    static constexpr uint32_t coreTypeAtom = 0x20;
+    static constexpr uint32_t coreTypeCore = 0x40;
+
+    /* Core type of the calling processor from cpuid leaf 0x1A, 0 unless the CPU is hybrid. */
+    static uint32_t getCPUidCoreType() {
+        int cpui[4] = { 0 };
+        cpuid(cpui, 0);
+        if (cpui[0] < 0x1A) {
+            return 0;
+        }
+        // Hybrid flag, leaf 7 edx bit 15.
+        cpuidex(cpui, 7, 0);
+        if (!((cpui[3] >> 15) & 1)) {
+            return 0;
+        }
+        cpuidex(cpui, 0x1A, 0);
+        return static_cast<uint32_t>(cpui[0]) >> 24;
+    }
+
+#if defined(__linux__)
+    /* Fill the efficiencyClass of a hybrid CPU from the core type of each core, unless sysfs already did. */
+    static void getCPUidCoreTypes(TopologyInfo& Topology);
+#endif
+
     /* Get the CPU name via cpuid. */
     static bool getCPUidName(std::string& name) {
         bool result = false;
         int cpui[4] = { 0 };
-        __cpuid(cpui, 0x80000000);
+        cpuid(cpui, static_cast<int>(0x80000000));
 
-        if (cpui[0] >= 0x80000004) {
+        if (static_cast<unsigned int>(cpui[0]) >= 0x80000004) {
             for (auto i = 0; i < 3; ++i) {
-                __cpuid(cpui, static_cast<int>(0x80000002 + i));
+                cpuid(cpui, static_cast<int>(0x80000002 + i));
                 name.append(reinterpret_cast<const char*>(cpui), sizeof(cpui));
             }
             result = true;
@@ -215,7 +639,10 @@ private:
     /* Get the CPU vendor via cpuid. */
     static void getCPUidVendor(std::string& vendor) {
         int cpui[4] = { 0 };
-        __cpuid(cpui, 0);
+        cpuid(cpui, 0);
+        if (cpui[0] == 0) {
+            return;
+        }
 
         vendor.append(reinterpret_cast<const char*>(&cpui[1]), sizeof(cpui[1]));
         vendor.append(reinterpret_cast<const char*>(&cpui[3]), sizeof(cpui[3]));
@@ -225,7 +652,7 @@ private:
     /* Get the CPU family via cpuid. */
     static void getCPUidFamily(int& family, int& model) {
         int cpui[4] = { 0 };
-        __cpuid(cpui, 1);
+        cpuid(cpui, 1);
 
         family = (cpui[0] >> 8) & 0x0F;
         model = (cpui[0] >> 4) & 0x0F;
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#include "CpuidTopology.h"
+#include "TextWriter.h"
+
+
+// Bits needed to number count ids.
+static uint32_t shiftOf(uint32_t count) {
+    uint32_t shift = 0;
+    while (shift < 31 && (uint32_t(1) << shift) < count) {
+        ++shift;
+    }
+    return shift;
+}
+
+
+static bool bit(int reg, int index) {
+    return ((static_cast<uint32_t>(reg) >> index) & 1) != 0;
+}
+
+
+CpuidTopology::CpuidTopology(const CpuSet& set) {
+    std::vector<uint32_t> indices;
+    set.forEach([&](uint32_t index) { indices.push_back(index); });
+
+    // One thread per processor, a batch at a time so a 2048 processor host does not start 2048 threads at once.
+    constexpr size_t batch = 64;
+    std::vector<Processor> read(indices.size());
+    for (size_t begin = 0; begin < indices.size(); begin += batch) {
+        std::vector<std::thread> threads;
+        for (auto i = begin; i < std::min(begin + batch, indices.size()); ++i) {
+            threads.emplace_back([&read, &indices, i]() {
+                CpuSet processor;
+                processor.set(indices[i]);
+                if (bindCurrentThread(processor)) {
+                    read[i].index = indices[i];
+                    readCurrent(read[i]);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    for (auto& processor : read) {
+        if (processor.apicId != none) {
+            apicIndex.emplace_back(processor.apicId, static_cast<uint32_t>(processors.size()));
+            processors.push_back(std::move(processor));
+        }
+    }
+    std::sort(apicIndex.begin(), apicIndex.end());
+}
+
+
+void CpuidTopology::readCurrent(Processor& processor) {
+    int cpui[4] = { 0 };
+    CpuTopology::cpuid(cpui, 0);
+    const auto maxLeaf = static_cast<uint32_t>(cpui[0]);
+    if (maxLeaf < 1) {
+        return;
+    }
+    // "AuthenticAMD" and "HygonGenuine" share the AMD leaves.
+    const bool amd = cpui[1] == 0x68747541 || cpui[1] == 0x6F677948;
+
+    CpuTopology::cpuid(cpui, static_cast<int>(0x80000000));
+    const auto maxExtendedLeaf = static_cast<uint32_t>(cpui[0]);
+    bool topologyExtensions = false;
+    if (maxExtendedLeaf >= 0x80000001) {
+        CpuTopology::cpuid(cpui, static_cast<int>(0x80000001));
+        topologyExtensions = bit(cpui[2], 22);
+    }
+
+    // x2APIC id levels, each shift drops the ids of the level and every level below.
+    uint32_t apicId = none;
+    uint32_t smtShift = 0;
+    uint32_t belowDieShift = 0;
+    uint32_t packageShift = 0;
+    bool dieLevel = false;
+    for (auto leaf : { 0x1F, 0xB }) {
+        if (maxLeaf < static_cast<uint32_t>(leaf)) {
+            continue;
+        }
+        CpuTopology::cpuidex(cpui, leaf, 0);
+        if (cpui[1] == 0) {
+            continue;
+        }
+        for (int subleaf = 0; subleaf < 8; ++subleaf) {
+            CpuTopology::cpuidex(cpui, leaf, subleaf);
+            // 1 SMT, 2 core, 3 module, 4 tile, 5 die, 6 die group.
+            auto type = (static_cast<uint32_t>(cpui[2]) >> 8) & 0xFF;
+            if (type == 0) {
+                break;
+            }
+            auto shift = static_cast<uint32_t>(cpui[0]) & 0x1F;
+            apicId = static_cast<uint32_t>(cpui[3]);
+            if (type == 1) {
+                smtShift = shift;
+            }
+            if (type < 5) {
+                belowDieShift = shift;
+            }
+            dieLevel = dieLevel || type == 5;
+            packageShift = shift;
+        }
+        break;
+    }
+
+    // Legacy initial APIC id, the package holds as many ids as leaf 1 reports.
+    if (apicId == none) {
+        CpuTopology::cpuid(cpui, 1);
+        apicId = static_cast<uint32_t>(cpui[1]) >> 24;
+        packageShift = bit(cpui[3], 28) ? shiftOf((static_cast<uint32_t>(cpui[1]) >> 16) & 0xFF) : 0;
+        belowDieShift = packageShift;
+        if (amd && maxExtendedLeaf >= 0x8000001E) {
+            CpuTopology::cpuid(cpui, static_cast<int>(0x8000001E));
+            smtShift = shiftOf(((static_cast<uint32_t>(cpui[1]) >> 8) & 0xFF) + 1);
+        }
+    }
+
+    // Deterministic cache parameters, leaf 4 and 0x8000001D share the layout.
+    uint32_t cacheLeaf = amd && topologyExtensions ? 0x8000001D : (!amd && maxLeaf >= 4 ? 4 : 0);
+    uint32_t lastLevelShift = packageShift;
+    uint32_t lastLevel = 0;
+    for (int subleaf = 0; cacheLeaf && subleaf < 16; ++subleaf) {
+        CpuTopology::cpuidex(cpui, static_cast<int>(cacheLeaf), subleaf);
+        auto eax = static_cast<uint32_t>(cpui[0]);
+        auto ebx = static_cast<uint32_t>(cpui[1]);
+        auto type = eax & 0x1F;
+        if (type == 0) {
+            break;
+        }
+        Cache cache;
+        cache.type = type == 1 ? CpuTopology::CacheType::data :
+            (type == 2 ? CpuTopology::CacheType::instruction :
+            (type == 3 ? CpuTopology::CacheType::unified : CpuTopology::CacheType::unknown));
+        cache.level = (eax >> 5) & 0x7;
+        cache.line = (ebx & 0xFFF) + 1;
+        cache.associativity = ((ebx >> 22) & 0x3FF) + 1;
+        cache.size = cache.associativity * (((ebx >> 12) & 0x3FF) + 1) * cache.line * (static_cast<uint32_t>(cpui[2]) + 1);
+        cache.shareShift = shiftOf(((eax >> 14) & 0xFFF) + 1);
+        if (cache.type != CpuTopology::CacheType::instruction && cache.level >= lastLevel) {
+            lastLevel = cache.level;
+            lastLevelShift = cache.shareShift;
+        }
+        processor.caches.push_back(cache);
+    }
+
+    processor.apicId = apicId;
+    processor.core = apicId >> smtShift;
+    processor.complexGroup = apicId >> lastLevelShift;
+    processor.package = apicId >> packageShift;
+    processor.die = processor.package;
+    if (dieLevel) {
+        processor.die = apicId >> belowDieShift;
+    }
+    else if (amd && maxExtendedLeaf >= 0x8000001E) {
+        CpuTopology::cpuid(cpui, static_cast<int>(0x8000001E));
+        processor.die = static_cast<uint32_t>(cpui[2]) & 0xFF;
+    }
+}
+
+
+uint32_t CpuidTopology::currentApicId() {
+    static const bool x2apic = []() {
+        int cpui[4] = { 0 };
+        CpuTopology::cpuid(cpui, 0);
+        if (cpui[0] < 0xB) {
+            return false;
+        }
+        CpuTopology::cpuidex(cpui, 0xB, 0);
+        return cpui[1] != 0;
+    }();
+
+    int cpui[4] = { 0 };
+    if (x2apic) {
+        CpuTopology::cpuidex(cpui, 0xB, 0);
+        return static_cast<uint32_t>(cpui[3]);
+    }
+    CpuTopology::cpuid(cpui, 1);
+    return static_cast<uint32_t>(cpui[1]) >> 24;
+}
+
+
+const CpuidTopology::Processor* CpuidTopology::find(uint32_t apicId) const {
+    auto it = std::lower_bound(apicIndex.cbegin(), apicIndex.cend(), std::make_pair(apicId, uint32_t(0)));
+    return it != apicIndex.cend() && it->first == apicId ? &processors[it->second] : nullptr;
+}
+
+
+const CpuidTopology::Processor* CpuidTopology::current() const {
+    return find(currentApicId());
+}
+
+
+// Kernel cpulist format through writeCpuList(), e.g. "0-3,8".
+static std::string cpuList(const CpuSet& set) {
+    std::ostringstream list;
+    {
+        TextWriter out(list);
+        writeCpuList(out, set);
+    }
+    return set.empty() ? "none" : list.str();
+}
+
+
+static std::string cacheName(const CpuTopology::CacheInfo& cache) {
+    const char* type = cache.type == CpuTopology::CacheType::instruction ? "I" :
+        (cache.type == CpuTopology::CacheType::data ? "D" : "U");
+    return "L" + std::to_string(cache.level) + type;
+}
+
+
+static std::string cacheGeometry(const CpuTopology::CacheInfo& cache) {
+    return std::to_string(cache.size / 1024) + " KB, " + std::to_string(cache.associativity) + " ways, " +
+        std::to_string(cache.line) + " B line";
+}
+
+
+std::vector<std::string> crossCheckTopology(const CpuTopology& cpuid, const CpuTopology& os) {
+    std::vector<std::string> differences;
+
+    const auto onlyCpuid = cpuid.Topology.cpuSet - os.Topology.cpuSet;
+    if (!onlyCpuid.empty()) {
+        differences.push_back("processors only cpuid reports: " + cpuList(onlyCpuid));
+    }
+    const auto onlyOs = os.Topology.cpuSet - cpuid.Topology.cpuSet;
+    if (!onlyOs.empty()) {
+        differences.push_back("processors only the OS reports: " + cpuList(onlyOs));
+    }
+
+    // Domains are compared on the processors both know, a process view holds fewer than the machine.
+    const auto common = cpuid.Topology.cpuSet & os.Topology.cpuSet;
+    CpuSet reported[4];
+    auto compare = [&](int level, const char* name, uint32_t index, const CpuSet& a, const CpuSet& b) {
+        if (reported[level].test(index) || (a & common) == (b & common)) {
+            return;
+        }
+        differences.push_back(std::string(name) + " of processor " + std::to_string(index) +
+            ": cpuid " + cpuList(a & common) + ", OS " + cpuList(b & common));
+        reported[level] |= (a | b) & common;
+    };
+
+    common.forEach([&](uint32_t index) {
+        const auto group = index / CpuSet::wordBits;
+        const auto processor = index % CpuSet::wordBits;
+        const auto* a = cpuid.FlatTopology.locate(group, processor);
+        const auto* b = os.FlatTopology.locate(group, processor);
+        if (!a || !b) {
+            return;
+        }
+        const CpuSet empty;
+        decltype(auto) coreA = cpuid.Topology.cores[a->core];
+        decltype(auto) coreB = os.Topology.cores[b->core];
+        compare(0, "core", index, coreA.cpuSet, coreB.cpuSet);
+        compare(1, "complex group", index,
+            a->complexGroup != CpuTopology::FlatTopologyInfo::none ? cpuid.Topology.complexGroups[a->complexGroup].cpuSet : empty,
+            b->complexGroup != CpuTopology::FlatTopologyInfo::none ? os.Topology.complexGroups[b->complexGroup].cpuSet : empty);
+        compare(2, "socket", index,
+            a->socket != CpuTopology::FlatTopologyInfo::none ? cpuid.Topology.sockets[a->socket].cpuSet : empty,
+            b->socket != CpuTopology::FlatTopologyInfo::none ? os.Topology.sockets[b->socket].cpuSet : empty);
+
+        // Cache geometry once per OS core.
+        if (reported[3].test(index)) {
+            return;
+        }
+        reported[3] |= coreB.cpuSet;
+        for (const auto& cache : coreA.caches) {
+            auto match = std::find_if(coreB.caches.cbegin(), coreB.caches.cend(), [&](const CpuTopology::CacheInfo& other) {
+                return other.level == cache.level && other.type == cache.type;
+            });
+            if (match == coreB.caches.cend()) {
+                differences.push_back(cacheName(cache) + " of processor " + std::to_string(index) + ": cpuid " +
+                    cacheGeometry(cache) + ", OS none");
+            }
+            else if (match->size != cache.size || match->line != cache.line || match->associativity != cache.associativity) {
+                differences.push_back(cacheName(cache) + " of processor " + std::to_string(index) + ": cpuid " +
+                    cacheGeometry(cache) + ", OS " + cacheGeometry(*match));
+            }
+        }
+        for (const auto& cache : coreB.caches) {
+            auto match = std::find_if(coreA.caches.cbegin(), coreA.caches.cend(), [&](const CpuTopology::CacheInfo& other) {
+                return other.level == cache.level && other.type == cache.type;
+            });
+            if (match == coreA.caches.cend()) {
+                differences.push_back(cacheName(cache) + " of processor " + std::to_string(index) + ": cpuid none, OS " +
+                    cacheGeometry(cache));
+            }
+        }
+    });
+    return differences;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Topology read with cpuid on every logical processor, the OS is only asked to pin the reading threads.
+   Hypervisors and sandboxes sometimes hand the OS a made-up topology while cpuid still tells the truth,
+   or the other way round, crossCheckTopology() shows where the two disagree.
+   SMT, core, die and package ids come from the x2APIC id split by leaf 0x1F (0xB when 0x1F is missing),
+   caches from leaf 4 on Intel and 0x8000001D on AMD, the AMD node id from 0x8000001E.
+   Empty on non-x86 targets. */
+class CpuidTopology {
+public:
+    static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+    /* One cache descriptor of leaf 4 or 0x8000001D. */
+    struct Cache {
+        CpuTopology::CacheType type = CpuTopology::CacheType::unknown;
+        uint32_t level = 0;
+        uint32_t associativity = 0;
+        uint32_t size = 0;
+        uint32_t line = 0;
+        /* Processors whose x2APIC ids only differ below this bit share one instance. */
+        uint32_t shareShift = 0;
+    };
+
+    struct Processor {
+        /* CpuSet::index of the logical processor. */
+        uint32_t index = none;
+        uint32_t apicId = none;
+        /* Domain ids, unique across the machine. Every id but die is the x2APIC id shifted by the domain's shift. */
+        uint32_t core = none;
+        /* Processors sharing the last level cache, the complex group (CCX) of AMD parts. */
+        uint32_t complexGroup = none;
+        /* Die of leaf 0x1F, or the node (CCD on Zen 1) of AMD leaf 0x8000001E, else the package. */
+        uint32_t die = none;
+        uint32_t package = none;
+        std::vector<Cache> caches;
+    };
+
+    /* Read cpuid on every processor of processors, one pinned thread per processor, in batches run in parallel.
+       Processors the threads cannot be pinned to are left out. */
+    explicit CpuidTopology(const CpuSet& processors = processAffinity());
+
+    /* Sorted by index. */
+    std::vector<Processor> processors;
+
+    /* Processor with x2APIC id apicId, nullptr if it was not read. */
+    const Processor* find(uint32_t apicId) const;
+
+    /* Processor the calling thread runs on, looked up by its x2APIC id with one cpuid.
+       cpuid is serializing and traps to the hypervisor in a VM, callers on a hot path should cache the result. */
+    const Processor* current() const;
+
+    /* x2APIC id of the calling processor (the 8 bit initial APIC id on CPUs without leaf 0xB). */
+    static uint32_t currentApicId();
+
+private:
+    /* Fill processor from cpuid of the processor the calling thread runs on. */
+    static void readCurrent(Processor& processor);
+
+    /* (x2APIC id, position in processors) sorted by id. */
+    std::vector<std::pair<uint32_t, uint32_t>> apicIndex;
+};
+
+
+/* Differences between two topologies of the same machine, e.g. CpuTopology(CpuidTopology()) and CpuTopology::process():
+   processors only one of them knows, and for every other processor a core, complex group or socket
+   holding different processors or core caches of a different size, line or associativity.
+   Every difference is reported once per domain. An empty result means they agree. */
+std::vector<std::string> crossCheckTopology(const CpuTopology& cpuid, const CpuTopology& os);
@@ -0,0 +1,280 @@
+#include <iomanip>
+#include <string>
+
+#if defined(__linux__)
+#include <cerrno>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "DomainCounters.h"
+
+
+const char* counterEventName(CounterEvent event) {
+    switch (event) {
+    case CounterEvent::cycles: return "cycles";
+    case CounterEvent::instructions: return "instructions";
+    case CounterEvent::llcMisses: return "LLC misses";
+    case CounterEvent::remoteNodeAccesses: return "remote node accesses";
+    case CounterEvent::cpuTime: return "CPU time";
+    case CounterEvent::contextSwitches: return "context switches";
+    case CounterEvent::cpuMigrations: return "CPU migrations";
+    case CounterEvent::count: break;
+    }
+    return "unknown";
+}
+
+
+#if defined(__linux__)
+namespace {
+
+struct EventSpec {
+    CounterEvent event;
+    uint32_t type;
+    uint64_t config;
+    /* Shares the hardware group of its processor, else it is alone. */
+    bool grouped;
+};
+
+// In CounterEvent order, the first hardware event opened leads the group.
+const EventSpec eventSpecs[] = {
+    { CounterEvent::cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true },
+    { CounterEvent::instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, true },
+    { CounterEvent::llcMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, true },
+    { CounterEvent::remoteNodeAccesses, PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_NODE | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), true },
+    { CounterEvent::cpuTime, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK, false },
+    { CounterEvent::contextSwitches, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, false },
+    { CounterEvent::cpuMigrations, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, false },
+};
+
+
+int openEvent(const EventSpec& spec, pid_t pid, int cpu, int leader, bool excludeKernel) {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = spec.type;
+    attr.config = spec.config;
+    // cpu-clock counts whatever runs on the processor, a thread wants its own task-clock.
+    if (spec.event == CounterEvent::cpuTime && pid != -1) {
+        attr.config = PERF_COUNT_SW_TASK_CLOCK;
+    }
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = excludeKernel;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, pid, cpu, leader, PERF_FLAG_FD_CLOEXEC));
+}
+
+}
+#endif
+
+
+DomainCounters::DomainCounters(const CpuTopology& cpu) {
+    cores = static_cast<uint32_t>(cpu.Topology.cores.size());
+    complexGroups = static_cast<uint32_t>(cpu.Topology.complexGroups.size());
+    numaNodes = static_cast<uint32_t>(cpu.Topology.numaNodes.size());
+    sockets = static_cast<uint32_t>(cpu.Topology.sockets.size());
+
+    cpu.Topology.cpuSet.forEach([&](uint32_t index) {
+        if (index < cpu.FlatTopology.processors.size()) {
+            ProcessorCounters processor;
+            processor.location = cpu.FlatTopology.processors[index];
+            processors.push_back(std::move(processor));
+        }
+    });
+
+#if defined(__linux__)
+    if (processors.empty()) {
+        return;
+    }
+
+    // Find the widest scope the kernel grants with a software event on the first processor:
+    // every process, then only this thread, each with and without kernel mode.
+    const auto& probe = eventSpecs[static_cast<uint32_t>(CounterEvent::contextSwitches)];
+    const auto firstProcessor = static_cast<int>(cpu.Topology.cpuSet.first());
+    pid_t pid = -1;
+    bool excludeKernel = false;
+    int fd = -1;
+    for (auto scope : { -1, 0 }) {
+        for (auto exclude : { false, true }) {
+            if (fd < 0) {
+                fd = openEvent(probe, scope, firstProcessor, -1, exclude);
+                pid = scope;
+                excludeKernel = exclude;
+            }
+        }
+    }
+    if (fd < 0) {
+        return;
+    }
+    close(fd);
+    wholeSystem = pid == -1;
+
+    // Once the descriptor limit is hit every further open fails too, the remaining processors stay uncounted.
+    bool exhausted = false;
+    size_t position = 0;
+    cpu.Topology.cpuSet.forEach([&](uint32_t index) {
+        if (index >= cpu.FlatTopology.processors.size()) {
+            return;
+        }
+        auto& processor = processors[position++];
+        processor.groups.resize(1);
+        for (const auto& spec : eventSpecs) {
+            if (!spec.grouped) {
+                processor.groups.emplace_back();
+            }
+            auto& group = spec.grouped ? processor.groups.front() : processor.groups.back();
+            auto descriptor = exhausted ? -1 : openEvent(spec, pid, static_cast<int>(index), group.leader, excludeKernel);
+            if (descriptor < 0) {
+                exhausted = exhausted || errno == EMFILE || errno == ENFILE;
+                continue;
+            }
+            if (group.leader < 0) {
+                group.leader = descriptor;
+            }
+            group.descriptors.push_back(descriptor);
+            group.events.push_back(spec.event);
+            ++coveredProcessors[static_cast<uint32_t>(spec.event)];
+        }
+    });
+#endif
+}
+
+
+DomainCounters::~DomainCounters() {
+#if defined(__linux__)
+    for (auto& processor : processors) {
+        for (auto& group : processor.groups) {
+            for (auto descriptor : group.descriptors) {
+                close(descriptor);
+            }
+        }
+    }
+#endif
+}
+
+
+DomainCounters::Snapshot DomainCounters::snapshot() const {
+    Snapshot result;
+    result.counts.resize(processors.size() * eventCount);
+#if defined(__linux__)
+    // nr, time enabled, time running, then one value per event of the group.
+    uint64_t values[3 + eventCount];
+    for (size_t p = 0; p < processors.size(); ++p) {
+        for (const auto& group : processors[p].groups) {
+            if (group.leader < 0) {
+                continue;
+            }
+            auto len = read(group.leader, values, sizeof(values));
+            if (len < static_cast<ssize_t>(3 * sizeof(uint64_t))) {
+                continue;
+            }
+            const auto enabled = values[1];
+            const auto running = values[2];
+            for (size_t i = 0; i < values[0] && i < group.events.size(); ++i) {
+                auto value = values[3 + i];
+                // The group shared the PMU with others for part of the time, extrapolate.
+                if (running && running < enabled) {
+                    value = static_cast<uint64_t>(static_cast<double>(value) * static_cast<double>(enabled) / static_cast<double>(running));
+                }
+                result.counts[p * eventCount + static_cast<uint32_t>(group.events[i])] = value;
+            }
+        }
+    }
+#endif
+    return result;
+}
+
+
+DomainCounters::Deltas DomainCounters::delta(const Snapshot& before, const Snapshot& after) const {
+    Deltas result;
+    result.cores.resize(cores);
+    result.complexGroups.resize(complexGroups);
+    result.numaNodes.resize(numaNodes);
+    result.sockets.resize(sockets);
+    if (before.counts.size() != processors.size() * eventCount || after.counts.size() != before.counts.size()) {
+        return result;
+    }
+
+    constexpr auto none = CpuTopology::FlatTopologyInfo::none;
+    for (size_t p = 0; p < processors.size(); ++p) {
+        Counts counts;
+        for (uint32_t e = 0; e < eventCount; ++e) {
+            auto from = before.counts[p * eventCount + e];
+            auto to = after.counts[p * eventCount + e];
+            counts.values[e] = to > from ? to - from : 0;
+        }
+
+        const auto& location = processors[p].location;
+        if (location.core != none && location.core < cores) {
+            result.cores[location.core] += counts;
+        }
+        if (location.complexGroup != none && location.complexGroup < complexGroups) {
+            result.complexGroups[location.complexGroup] += counts;
+        }
+        if (location.numaNode != none && location.numaNode < numaNodes) {
+            result.numaNodes[location.numaNode] += counts;
+        }
+        if (location.socket != none && location.socket < sockets) {
+            result.sockets[location.socket] += counts;
+        }
+        result.total += counts;
+    }
+    return result;
+}
+
+
+void writeCounterReport(std::ostream& out, const DomainCounters& counters, const DomainCounters::Deltas& deltas) {
+    const CounterEvent columns[] = { CounterEvent::cycles, CounterEvent::instructions, CounterEvent::llcMisses,
+        CounterEvent::remoteNodeAccesses, CounterEvent::cpuTime, CounterEvent::contextSwitches, CounterEvent::cpuMigrations };
+    const char* headers[] = { "Cycles", "Instructions", "LLC misses", "Remote loads", "CPU ms", "Switches", "Migrations" };
+
+    auto row = [&](const std::string& name, const DomainCounters::Counts& counts) {
+        out << std::left << std::setw(18) << name << std::right;
+        for (auto event : columns) {
+            out << std::setw(16);
+            if (!counters.available(event)) {
+                out << '-';
+            }
+            else if (event == CounterEvent::cpuTime) {
+                out << counts[event] / 1000000;
+            }
+            else {
+                out << counts[event];
+            }
+        }
+        out << std::setw(8);
+        if (counters.available(CounterEvent::cycles) && counters.available(CounterEvent::instructions)) {
+            out << std::fixed << std::setprecision(2) << counts.ipc();
+        }
+        else {
+            out << '-';
+        }
+        out << std::endl;
+    };
+
+    out << std::left << std::setw(18) << (counters.systemWide() ? "System wide" : "Calling thread") << std::right;
+    for (auto header : headers) {
+        out << std::setw(16) << header;
+    }
+    out << std::setw(8) << "IPC" << std::endl;
+
+    for (size_t i = 0; i < deltas.complexGroups.size(); ++i) {
+        row("Complex group " + std::to_string(i), deltas.complexGroups[i]);
+    }
+    for (size_t i = 0; i < deltas.numaNodes.size(); ++i) {
+        row("NUMA node " + std::to_string(i), deltas.numaNodes[i]);
+    }
+    for (size_t i = 0; i < deltas.sockets.size(); ++i) {
+        row("Socket " + std::to_string(i), deltas.sockets[i]);
+    }
+    row("Total", deltas.total);
+
+    for (auto event : columns) {
+        if (counters.available(event) && !counters.complete(event)) {
+            out << counterEventName(event) << " counted on " << counters.coverage(event) << " of "
+                << counters.processorCount() << " processors" << std::endl;
+        }
+    }
+}
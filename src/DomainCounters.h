@@ -0,0 +1,136 @@
+#pragma once
+
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Events DomainCounters counts on every logical processor. */
+enum class CounterEvent : uint32_t {
+    /* Hardware events, missing inside most VMs and containers without a virtual PMU. */
+    cycles,
+    instructions,
+    /* Last level cache misses. */
+    llcMisses,
+    /* Loads served by another NUMA node's memory. */
+    remoteNodeAccesses,
+    /* Software events, counted by the kernel and available wherever perf_event_open is.
+       CPU time in ns, the cpu-clock of each processor when system wide, else the thread's task-clock. */
+    cpuTime,
+    contextSwitches,
+    cpuMigrations,
+    count,
+};
+
+/* Name of an event, for reports. */
+const char* counterEventName(CounterEvent event);
+
+
+/* Per topology domain hardware and software counters through perf_event_open (Linux only, nothing is counted elsewhere).
+   The hardware events of a logical processor form one group read with a single read(2) in PERF_FORMAT_GROUP
+   format, so they are scheduled on the PMU together. Software events are opened and read on their own,
+   the kernel stops counting some of them as members of a group led by a clock event.
+   Counts are system wide when the kernel allows it (perf_event_paranoid <= 0 or CAP_PERFMON), otherwise
+   they only cover the thread which created the counters. Multiplexed groups are scaled by enabled / running time.
+   Every event is a file descriptor, up to eventCount per logical processor: 256 processors need 1792, beyond the
+   common RLIMIT_NOFILE soft limit of 1024. Raise the limit first on large hosts; processors left without
+   descriptors are not counted and coverage() tells how many were.
+   Domain ids are those of cpu, the same ThreadPool and planPlacement() schedule with. */
+class DomainCounters {
+public:
+    static constexpr uint32_t eventCount = static_cast<uint32_t>(CounterEvent::count);
+
+    explicit DomainCounters(const CpuTopology& cpu = CpuTopology::process());
+    ~DomainCounters();
+
+    DomainCounters(const DomainCounters&) = delete;
+    DomainCounters& operator = (const DomainCounters&) = delete;
+
+    /* True if the event opened on at least one processor. */
+    bool available(CounterEvent event) const { return coveredProcessors[static_cast<uint32_t>(event)] != 0; }
+
+    /* Number of processors the event opened on, domain counts only include those. */
+    uint32_t coverage(CounterEvent event) const { return coveredProcessors[static_cast<uint32_t>(event)]; }
+
+    /* True if the event opened on every processor of cpu. */
+    bool complete(CounterEvent event) const { return coverage(event) == processorCount(); }
+
+    /* Number of logical processors of cpu. */
+    uint32_t processorCount() const { return static_cast<uint32_t>(processors.size()); }
+
+    /* True if counts cover every process, false if only the creating thread. */
+    bool systemWide() const { return wholeSystem; }
+
+    /* Raw counts of every processor, processors * eventCount. */
+    struct Snapshot {
+        std::vector<uint64_t> counts;
+    };
+
+    Snapshot snapshot() const;
+
+    struct Counts {
+        uint64_t values[eventCount] = {};
+
+        uint64_t operator [] (CounterEvent event) const { return values[static_cast<uint32_t>(event)]; }
+        /* Instructions per cycle, 0 without cycles. */
+        double ipc() const {
+            auto cycles = (*this)[CounterEvent::cycles];
+            return cycles ? static_cast<double>((*this)[CounterEvent::instructions]) / static_cast<double>(cycles) : 0.0;
+        }
+        Counts& operator += (const Counts& other) {
+            for (uint32_t i = 0; i < eventCount; ++i) {
+                values[i] += other.values[i];
+            }
+            return *this;
+        }
+    };
+
+    /* Counts between two snapshots, indexed by the domain ids of cpu. */
+    struct Deltas {
+        std::vector<Counts> cores;
+        std::vector<Counts> complexGroups;
+        std::vector<Counts> numaNodes;
+        std::vector<Counts> sockets;
+        Counts total;
+    };
+
+    Deltas delta(const Snapshot& before, const Snapshot& after) const;
+
+    /* Counts of region(). */
+    template <typename F>
+    Deltas measure(F&& region) const {
+        auto before = snapshot();
+        region();
+        return delta(before, snapshot());
+    }
+
+private:
+    struct Group {
+        int leader = -1;
+        std::vector<int> descriptors;
+        /* Event of each value in read order. */
+        std::vector<CounterEvent> events;
+    };
+
+    /* Per processor hardware group, then one group per software event. */
+    struct ProcessorCounters {
+        CpuTopology::FlatTopologyInfo::ProcessorLocation location;
+        std::vector<Group> groups;
+    };
+
+    std::vector<ProcessorCounters> processors;
+    uint32_t cores = 0;
+    uint32_t complexGroups = 0;
+    uint32_t numaNodes = 0;
+    uint32_t sockets = 0;
+    uint32_t coveredProcessors[eventCount] = {};
+    bool wholeSystem = false;
+};
+
+
+/* Table of cycles, instructions, IPC, LLC misses, remote accesses and context switches per complex group,
+   NUMA node and socket, unavailable events are printed as "-" and partially covered ones get a note. */
+void writeCounterReport(std::ostream& out, const DomainCounters& counters, const DomainCounters::Deltas& deltas);
@@ -0,0 +1,78 @@
+#pragma once
+
+
+#include <utility>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Implementations of one kernel for several instruction sets, bound to the best one the CPU supports.
+   Implementations are registered from the baseline up, the last one whose required features are all
+   in CpuTopology::hostIsa() wins. Binding happens in add(), so a dispatcher built during static
+   initialization is bound before main() and a call is one indirect call through a function pointer.
+
+       static const auto sum = IsaDispatch<float(const float*, size_t)>(sumScalar, "scalar")
+           .add(sumAvx2, { IsaFeature::avx2, IsaFeature::fma }, "avx2")
+           .add(sumAvx512, { IsaFeature::avx512f }, "avx512");
+       auto total = sum(data, size);
+
+   Each implementation is compiled for its instruction set, e.g. __attribute__((target("avx2,fma")))
+   on GCC and Clang or a translation unit built with /arch:AVX2 on MSVC. */
+template <typename Signature>
+class IsaDispatch;
+
+template <typename R, typename... Args>
+class IsaDispatch<R(Args...)> {
+public:
+    using Function = R(*)(Args...);
+
+    /* fallback runs on any CPU. */
+    explicit IsaDispatch(Function fallback, const char* name = "baseline") {
+        implementations.push_back({ fallback, IsaFeatures(), name });
+        bind(CpuTopology::hostIsa());
+    }
+
+    /* Register an implementation needing every feature of required, preferred over every earlier one. */
+    IsaDispatch& add(Function function, IsaFeatures required, const char* name = "") {
+        implementations.push_back({ function, required, name });
+        if (available.contains(required)) {
+            selected = implementations.size() - 1;
+            bound = function;
+        }
+        return *this;
+    }
+
+    /* Bind again against another feature set, e.g. to test a narrower implementation on a wider CPU. */
+    void bind(const IsaFeatures& features) {
+        available = features;
+        for (size_t i = 0; i < implementations.size(); ++i) {
+            if (features.contains(implementations[i].required)) {
+                selected = i;
+                bound = implementations[i].function;
+            }
+        }
+    }
+
+    R operator () (Args... args) const {
+        return bound(std::forward<Args>(args)...);
+    }
+
+    /* Bound implementation, hot loops may keep it instead of going through the dispatcher. */
+    Function function() const { return bound; }
+
+    /* Name of the bound implementation. */
+    const char* name() const { return implementations[selected].name; }
+
+private:
+    struct Implementation {
+        Function function;
+        IsaFeatures required;
+        const char* name;
+    };
+
+    std::vector<Implementation> implementations;
+    IsaFeatures available;
+    size_t selected = 0;
+    Function bound = nullptr;
+};
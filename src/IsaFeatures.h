@@ -0,0 +1,91 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+
+/* x86 instruction set extensions reported by cpuid. */
+enum class IsaFeature : uint32_t {
+    sse2,
+    sse3,
+    ssse3,
+    sse41,
+    sse42,
+    popcnt,
+    lzcnt,
+    bmi1,
+    bmi2,
+    aes,
+    pclmulqdq,
+    sha,
+    gfni,
+    /* Every feature below needs the AVX register state enabled by the OS. */
+    avx,
+    avx2,
+    fma,
+    f16c,
+    avxVnni,
+    vaes,
+    vpclmulqdq,
+    /* Every feature below needs the AVX-512 register state enabled by the OS. */
+    avx512f,
+    avx512dq,
+    avx512cd,
+    avx512bw,
+    avx512vl,
+    avx512ifma,
+    avx512vbmi,
+    avx512vbmi2,
+    avx512vnni,
+    avx512bitalg,
+    avx512vpopcntdq,
+    avx512bf16,
+    avx512fp16,
+    /* Every feature below needs the AMX tile state enabled by the OS.
+       Linux also wants arch_prctl(ARCH_REQ_XCOMP_PERM, XFEATURE_XTILEDATA) once per process before the first tile instruction. */
+    amxTile,
+    amxInt8,
+    amxBf16,
+    count,
+};
+
+
+/* Set of IsaFeature, one bit per feature. */
+struct IsaFeatures {
+    uint64_t bits = 0;
+
+    IsaFeatures() = default;
+    IsaFeatures(std::initializer_list<IsaFeature> features) {
+        for (auto feature : features) {
+            set(feature);
+        }
+    }
+
+    void set(IsaFeature feature) { bits |= bit(feature); }
+    bool has(IsaFeature feature) const { return (bits & bit(feature)) != 0; }
+    /* True if every feature of required is present. */
+    bool contains(const IsaFeatures& required) const { return (bits & required.bits) == required.bits; }
+    bool empty() const { return bits == 0; }
+
+    friend bool operator == (const IsaFeatures& a, const IsaFeatures& b) { return a.bits == b.bits; }
+    friend bool operator != (const IsaFeatures& a, const IsaFeatures& b) { return a.bits != b.bits; }
+
+private:
+    static uint64_t bit(IsaFeature feature) { return uint64_t(1) << static_cast<uint32_t>(feature); }
+};
+
+
+/* Lower case name of a feature as in compiler target attributes, e.g. "avx512bw" or "amx-tile". */
+inline const char* isaFeatureName(IsaFeature feature) {
+    static const char* const names[] = {
+        "sse2", "sse3", "ssse3", "sse4.1", "sse4.2", "popcnt", "lzcnt", "bmi", "bmi2", "aes", "pclmul", "sha", "gfni",
+        "avx", "avx2", "fma", "f16c", "avxvnni", "vaes", "vpclmulqdq",
+        "avx512f", "avx512dq", "avx512cd", "avx512bw", "avx512vl", "avx512ifma", "avx512vbmi", "avx512vbmi2",
+        "avx512vnni", "avx512bitalg", "avx512vpopcntdq", "avx512bf16", "avx512fp16",
+        "amx-tile", "amx-int8", "amx-bf16",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(IsaFeature::count), "one name per IsaFeature");
+    return feature < IsaFeature::count ? names[static_cast<uint32_t>(feature)] : "unknown";
+}
@@ -0,0 +1,80 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "MeasurementCache.h"
+
+
+struct MeasurementHeader {
+    char magic[4] = { 'C', 'T', 'M', 'M' };
+    uint32_t version = 1;
+    uint64_t fingerprint = 0;
+    uint32_t dimension = 0;
+    uint32_t matrices = 0;
+};
+
+
+std::string measurementCachePath(const CpuTopology& cpu, const std::string& name) {
+    std::ostringstream path;
+    path << CpuTopology::cacheDirectory() << "/" << name << "-" << std::hex << cpu.fingerprint() << ".bin";
+    return path.str();
+}
+
+
+bool saveMeasurement(const std::string& path, const CpuTopology& cpu, uint32_t dimension,
+    const std::vector<const std::vector<float>*>& matrices) {
+    const auto size = static_cast<size_t>(dimension) * dimension;
+    for (auto matrix : matrices) {
+        if (matrix->size() != size) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    MeasurementHeader header;
+    header.fingerprint = cpu.fingerprint();
+    header.dimension = dimension;
+    header.matrices = static_cast<uint32_t>(matrices.size());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (auto matrix : matrices) {
+        file.write(reinterpret_cast<const char*>(matrix->data()), size * sizeof(float));
+    }
+    return static_cast<bool>(file);
+}
+
+
+bool loadMeasurement(const std::string& path, const CpuTopology& cpu, uint32_t dimension,
+    const std::vector<std::vector<float>*>& matrices) {
+    std::ifstream file(path, std::ios::binary);
+    MeasurementHeader header;
+    MeasurementHeader expected;
+    expected.fingerprint = cpu.fingerprint();
+    expected.dimension = dimension;
+    expected.matrices = static_cast<uint32_t>(matrices.size());
+
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        header.version != expected.version ||
+        header.fingerprint != expected.fingerprint ||
+        header.dimension != expected.dimension ||
+        header.matrices != expected.matrices) {
+        return false;
+    }
+
+    const auto size = static_cast<size_t>(dimension) * dimension;
+    std::vector<std::vector<float>> result(matrices.size(), std::vector<float>(size));
+    for (auto& matrix : result) {
+        if (!file.read(reinterpret_cast<char*>(matrix.data()), size * sizeof(float))) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < matrices.size(); ++i) {
+        *matrices[i] = std::move(result[i]);
+    }
+    return true;
+}
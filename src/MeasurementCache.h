@@ -0,0 +1,22 @@
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Square float matrices measured on this host, persisted in CpuTopology::cacheDirectory()
+   and tagged with CpuTopology::fingerprint() so a file from another host is rejected. */
+
+/* Path of the measurement file called name. */
+std::string measurementCachePath(const CpuTopology& cpu, const std::string& name);
+
+/* Save matrices of dimension * dimension floats, creating the cache directory if needed. */
+bool saveMeasurement(const std::string& path, const CpuTopology& cpu, uint32_t dimension,
+    const std::vector<const std::vector<float>*>& matrices);
+
+/* Load matrices saved by saveMeasurement, fails for another host, dimension or matrix count. */
+bool loadMeasurement(const std::string& path, const CpuTopology& cpu, uint32_t dimension,
+    const std::vector<std::vector<float>*>& matrices);
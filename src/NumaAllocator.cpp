@@ -0,0 +1,266 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#endif
+
+#include <algorithm>
+#include <limits>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "NumaAllocator.h"
+
+
+#if defined(__linux__)
+// From <numaif.h>, spelled out to avoid a libnuma dependency.
+constexpr int mpolPreferred = 1;
+constexpr int mpolInterleave = 3;
+#endif
+
+
+struct NumaArena::Header {
+    /* Arena owning the block. */
+    NumaArena* arena;
+    /* Size class, sizeClasses for a block with its own mapping. */
+    uint32_t sizeClass;
+    /* Distance from the block start to the user pointer. */
+    uint32_t offset;
+    /* Mapped size of a block with its own mapping. */
+    size_t mappedSize;
+    size_t reserved;
+};
+
+
+NumaArena::NumaArena(uint32_t sysNumaNode) : sysNumaNodes{ sysNumaNode } {
+}
+
+
+NumaArena::NumaArena(const std::vector<uint32_t>& sysNumaNodes) : sysNumaNodes(sysNumaNodes), interleave(true) {
+}
+
+
+NumaArena::~NumaArena() {
+    for (const auto& chunk : chunks) {
+        unmap(chunk.first, chunk.second);
+    }
+}
+
+
+void* NumaArena::map(size_t size) {
+#if defined(_WIN32)
+    void* p = nullptr;
+    if (!interleave && !sysNumaNodes.empty()) {
+        p = VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, sysNumaNodes.front());
+    }
+    if (!p) {
+        // Windows has no interleave policy for a single allocation.
+        bindingHonored = false;
+        p = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+#elif defined(__linux__)
+    auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    constexpr size_t wordBits = std::numeric_limits<unsigned long>::digits;
+    std::vector<unsigned long> mask;
+    for (auto node : sysNumaNodes) {
+        if (node / wordBits >= mask.size()) {
+            mask.resize(node / wordBits + 1);
+        }
+        mask[node / wordBits] |= 1UL << (node % wordBits);
+    }
+    if (mask.empty() ||
+        syscall(SYS_mbind, p, size, interleave ? mpolInterleave : mpolPreferred, mask.data(), mask.size() * wordBits + 1, 0) != 0) {
+        bindingHonored = false;
+    }
+    return p;
+#endif
+}
+
+
+void NumaArena::unmap(void* p, size_t size) {
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(p, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(p, size);
+#endif
+}
+
+
+void* NumaArena::allocate(size_t size, size_t alignment) {
+    static_assert(sizeof(Header) % alignof(std::max_align_t) == 0, "Header must keep the user pointer aligned.");
+
+    alignment = std::max(alignment, alignof(std::max_align_t));
+    auto needed = size + sizeof(Header) + (alignment > alignof(std::max_align_t) ? alignment : 0);
+
+    uint32_t sizeClass = 0;
+    while (sizeClass < sizeClasses && (minClassSize << sizeClass) < needed) {
+        ++sizeClass;
+    }
+
+    char* block = nullptr;
+    size_t mappedSize = 0;
+    if (sizeClass == sizeClasses) {
+        mappedSize = needed;
+        block = static_cast<char*>(map(mappedSize));
+    }
+    else {
+        std::lock_guard<std::mutex> guard(lock);
+        if (freeLists[sizeClass]) {
+            block = static_cast<char*>(freeLists[sizeClass]);
+            freeLists[sizeClass] = *reinterpret_cast<void**>(block);
+        }
+        else {
+            auto blockSize = minClassSize << sizeClass;
+            if (static_cast<size_t>(chunkEnd - chunkCursor) < blockSize) {
+                chunkCursor = static_cast<char*>(map(chunkSize));
+                chunkEnd = chunkCursor + chunkSize;
+                chunks.emplace_back(chunkCursor, chunkSize);
+            }
+            block = chunkCursor;
+            chunkCursor += blockSize;
+        }
+    }
+
+    auto user = reinterpret_cast<uintptr_t>(block) + sizeof(Header);
+    user = (user + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    auto header = reinterpret_cast<Header*>(user) - 1;
+    header->arena = this;
+    header->sizeClass = sizeClass;
+    header->offset = static_cast<uint32_t>(user - reinterpret_cast<uintptr_t>(block));
+    header->mappedSize = mappedSize;
+    return reinterpret_cast<void*>(user);
+}
+
+
+void NumaArena::release(void* p) {
+    if (!p) {
+        return;
+    }
+    auto header = static_cast<Header*>(p) - 1;
+    auto block = static_cast<char*>(p) - header->offset;
+    if (header->sizeClass == sizeClasses) {
+        unmap(block, header->mappedSize);
+        return;
+    }
+
+    auto arena = header->arena;
+    auto sizeClass = header->sizeClass;
+    std::lock_guard<std::mutex> guard(arena->lock);
+    *reinterpret_cast<void**>(block) = arena->freeLists[sizeClass];
+    arena->freeLists[sizeClass] = block;
+}
+
+
+// One arena per NUMA node of TopologyInfo, then one per memory node without processors,
+// and one interleaving across the NUMA nodes. Slower tiers only get memory asked for by sysNode().
+struct NumaArenas {
+    std::vector<std::unique_ptr<NumaArena>> nodes;
+    /* Arenas of NUMA nodes at the front of nodes, the CPU-less ones follow. */
+    size_t numaNodes = 0;
+    std::unique_ptr<NumaArena> interleaved;
+
+    NumaArenas() {
+        decltype(auto) cpu = CpuTopology::get();
+        std::vector<uint32_t> sysNumaNodes;
+        for (const auto& numaNode : cpu.Topology.numaNodes) {
+            nodes.push_back(std::make_unique<NumaArena>(numaNode.sysNumaNode));
+            sysNumaNodes.push_back(numaNode.sysNumaNode);
+        }
+        if (nodes.empty()) {
+            nodes.push_back(std::make_unique<NumaArena>(0));
+            sysNumaNodes.push_back(0);
+        }
+        numaNodes = nodes.size();
+        interleaved = std::make_unique<NumaArena>(sysNumaNodes);
+        for (const auto& memoryNode : cpu.Topology.memoryNodes) {
+            if (!memoryNode.numaNode && std::find(sysNumaNodes.cbegin(), sysNumaNodes.cend(), memoryNode.sysNumaNode) == sysNumaNodes.cend()) {
+                nodes.push_back(std::make_unique<NumaArena>(memoryNode.sysNumaNode));
+            }
+        }
+    }
+
+    static NumaArenas& get() {
+        static NumaArenas arenas;
+        return arenas;
+    }
+};
+
+
+NumaArena& NumaArena::node(uint32_t numaNode) {
+    decltype(auto) arenas = NumaArenas::get();
+    return *arenas.nodes[numaNode < arenas.numaNodes ? numaNode : 0];
+}
+
+
+NumaArena& NumaArena::sysNode(uint32_t sysNumaNode) {
+    decltype(auto) arenas = NumaArenas::get();
+    for (const auto& arena : arenas.nodes) {
+        if (arena->sysNumaNodes.front() == sysNumaNode) {
+            return *arena;
+        }
+    }
+    return *arenas.nodes.front();
+}
+
+
+NumaArena& NumaArena::interleaved() {
+    return *NumaArenas::get().interleaved;
+}
+
+
+NumaArena& NumaArena::local() {
+    struct Cached {
+        uint32_t processor = std::numeric_limits<uint32_t>::max();
+        NumaArena* arena = nullptr;
+    };
+    static thread_local Cached cached;
+
+    auto processor = currentProcessor();
+
+    if (processor != cached.processor) {
+        auto location = CpuTopology::get().FlatTopology.locate(processor / CpuSet::wordBits, processor % CpuSet::wordBits);
+        cached.processor = processor;
+        cached.arena = &node(location ? location->numaNode : 0);
+    }
+    return *cached.arena;
+}
+
+
+std::vector<const CpuTopology::TopologyInfo::MemoryNodeInfo*> memoryPlacementOrder(uint32_t numaNode, const CpuTopology& cpu) {
+    using MemoryNodeInfo = CpuTopology::TopologyInfo::MemoryNodeInfo;
+    std::vector<const MemoryNodeInfo*> order;
+    for (const auto& memoryNode : cpu.Topology.memoryNodes) {
+        order.push_back(&memoryNode);
+    }
+    // Without SLIT rows the NUMA node's own memory still comes first within its tier.
+    auto distance = [numaNode](const MemoryNodeInfo* memoryNode) {
+        if (numaNode < memoryNode->distances.size()) {
+            return memoryNode->distances[numaNode];
+        }
+        return memoryNode->numaNode && memoryNode->numaNode->id == numaNode ? 0u : 1u;
+    };
+    std::stable_sort(order.begin(), order.end(), [&](const MemoryNodeInfo* a, const MemoryNodeInfo* b) {
+        if (a->memoryTier != b->memoryTier) {
+            return a->memoryTier < b->memoryTier;
+        }
+        if (distance(a) != distance(b)) {
+            return distance(a) < distance(b);
+        }
+        return a->readLatency < b->readLatency;
+    });
+    return order;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Memory arena placed on NUMA nodes.
+   Chunks are mapped from the system and bound with mbind (VirtualAllocExNuma on Windows),
+   then carved into power of two size classes. Every block starts with a small header
+   so release() finds its arena without a lookup.
+   Binding uses the preferred policy, a full node spills over instead of failing.
+   When the system refuses the binding (kernels without NUMA, seccomp filtered containers)
+   the chunk stays with the default first-touch policy. */
+class NumaArena {
+public:
+    /* Memory bound to one system NUMA node. */
+    explicit NumaArena(uint32_t sysNumaNode);
+    /* Memory interleaved page by page across sysNumaNodes. */
+    explicit NumaArena(const std::vector<uint32_t>& sysNumaNodes);
+    ~NumaArena();
+
+    NumaArena(const NumaArena&) = delete;
+    NumaArena& operator = (const NumaArena&) = delete;
+
+    /* Allocate size bytes aligned to alignment (a power of two no larger than a page). */
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    /* Give a block back to the arena which allocated it, nullptr is ignored. */
+    static void release(void* p);
+
+    /* System NUMA nodes this arena places memory on. */
+    const std::vector<uint32_t>& nodes() const { return sysNumaNodes; }
+
+    /* True if the system accepted the NUMA binding of every chunk so far. */
+    bool bound() const { return bindingHonored; }
+
+    /* Arena of one NUMA node in TopologyInfo, created on first use. An id past the NUMA nodes gets the first node,
+       memory without processors is only reached through sysNode(). */
+    static NumaArena& node(uint32_t numaNode);
+
+    /* Arena of a system NUMA id, e.g. CoreInfo::sysNumaNode of any CpuTopology view or
+       MemoryNodeInfo::sysNumaNode of a CPU-less node, the first node if it is unknown. */
+    static NumaArena& sysNode(uint32_t sysNumaNode);
+
+    /* Arena of the NUMA node the calling thread runs on.
+       The node is cached per thread and only resolved again when the thread moved to another processor. */
+    static NumaArena& local();
+
+    /* Arena interleaving across every NUMA node with processors, created on first use. */
+    static NumaArena& interleaved();
+
+private:
+    struct Header;
+
+    /* Size classes are 16 << i bytes, larger blocks get their own mapping. */
+    static constexpr uint32_t sizeClasses = 17;
+    static constexpr size_t minClassSize = 16;
+    static constexpr size_t chunkSize = size_t(2) << 20;
+
+    void* map(size_t size);
+    static void unmap(void* p, size_t size);
+
+    std::vector<uint32_t> sysNumaNodes;
+    bool interleave = false;
+    bool bindingHonored = true;
+
+    std::mutex lock;
+    /* Free blocks of each size class, linked through their first word. */
+    void* freeLists[sizeClasses] = {};
+    /* Bump pointer inside the current chunk. */
+    char* chunkCursor = nullptr;
+    char* chunkEnd = nullptr;
+    std::vector<std::pair<void*, size_t>> chunks;
+};
+
+
+/* STL allocator placing elements in a NumaArena.
+   A default constructed allocator uses the arena of the calling thread's node at allocation time. */
+template <typename T>
+class NumaAllocator {
+public:
+    using value_type = T;
+
+    NumaAllocator() noexcept = default;
+    explicit NumaAllocator(NumaArena& arena) noexcept : arena(&arena) {}
+    template <typename U>
+    NumaAllocator(const NumaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        auto& target = arena ? *arena : NumaArena::local();
+        return static_cast<T*>(target.allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        NumaArena::release(p);
+    }
+
+    /* Any block can be released through any NumaAllocator, the header knows its arena. */
+    template <typename U>
+    bool operator == (const NumaAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator != (const NumaAllocator<U>&) const noexcept { return false; }
+
+private:
+    template <typename U>
+    friend class NumaAllocator;
+
+    NumaArena* arena = nullptr;
+};
+
+
+/* Memory nodes for data used by the processors of a NUMA node in TopologyInfo, best first:
+   by memory tier, then SLIT distance from numaNode, then HMAT read latency.
+   Allocate from NumaArena::sysNode() of the first node with room, e.g. for a cache spilling
+   from DRAM to a CXL expander. */
+std::vector<const CpuTopology::TopologyInfo::MemoryNodeInfo*> memoryPlacementOrder(uint32_t numaNode,
+    const CpuTopology& cpu = CpuTopology::get());
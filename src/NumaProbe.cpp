@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+#include "MeasurementCache.h"
+#include "NumaAllocator.h"
+#include "NumaProbe.h"
+#include "ProbeUtils.h"
+
+
+// Dependent loads over a random cycle of cache lines, returns ns per load.
+double chaseLatency(const CpuTopology::TopologyInfo::NumaNodeInfo& from, NumaArena& memory, size_t bytes, const NumaProbeOptions& options) {
+    constexpr size_t line = 64;
+    const auto lines = bytes / line;
+    auto buffer = static_cast<char*>(memory.allocate(lines * line, line));
+
+    // Sattolo's shuffle gives a single cycle through every line.
+    std::vector<uint32_t> order(lines);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937_64 random(42);
+    for (auto i = lines - 1; i > 0; --i) {
+        std::uniform_int_distribution<size_t> pick(0, i - 1);
+        std::swap(order[i], order[pick(random)]);
+    }
+    for (size_t i = 0; i < lines; ++i) {
+        *reinterpret_cast<void**>(buffer + order[i] * line) = buffer + order[(i + 1) % lines] * line;
+    }
+
+    double best = 0.0;
+    runPinned({ from.cores.front()->cpuSet }, nullptr, [&](size_t) {
+        best = chaseNanoseconds(buffer, options.chaseSteps, options.samples);
+    });
+
+    NumaArena::release(buffer);
+    return best;
+}
+
+
+// Streaming read and copy from every core of from, returns GB/s.
+std::pair<double, double> streamBandwidth(const CpuTopology::TopologyInfo::NumaNodeInfo& from, NumaArena& memory, const NumaProbeOptions& options) {
+    const auto words = options.bandwidthBytes / sizeof(uint64_t);
+    auto buffer = static_cast<uint64_t*>(memory.allocate(words * sizeof(uint64_t), 64));
+    std::fill(buffer, buffer + words, 1);
+
+    const auto threads = from.cores.size();
+    std::vector<uint64_t> sums(threads * 8);
+    std::vector<CpuSet> cpuSets;
+    for (auto core : from.cores) {
+        cpuSets.push_back(core->cpuSet);
+    }
+
+    auto bestRead = std::numeric_limits<double>::max();
+    auto bestCopy = std::numeric_limits<double>::max();
+    for (uint32_t sample = 0; sample < options.samples; ++sample) {
+        bestRead = std::min(bestRead, runPinned(cpuSets, nullptr, [&](size_t t) {
+            uint64_t sum = 0;
+            for (auto i = words * t / threads; i < words * (t + 1) / threads; ++i) {
+                sum += buffer[i];
+            }
+            sums[t * 8] = sum;
+        }));
+
+        // Copy the first half onto the second half.
+        const auto half = words / 2;
+        bestCopy = std::min(bestCopy, runPinned(cpuSets, nullptr, [&](size_t t) {
+            auto begin = half * t / threads;
+            auto end = half * (t + 1) / threads;
+            std::memcpy(buffer + half + begin, buffer + begin, (end - begin) * sizeof(uint64_t));
+        }));
+    }
+
+    NumaArena::release(buffer);
+    return { words * sizeof(uint64_t) / bestRead / 1e9, (words / 2) * 2 * sizeof(uint64_t) / bestCopy / 1e9 };
+}
+
+
+NumaProbeResult probeNuma(const CpuTopology& cpu, const NumaProbeOptions& requested) {
+    // Without a sample or a step the best time would stay at its initial maximum and read as inf.
+    auto options = requested;
+    options.samples = std::max<uint32_t>(1, options.samples);
+    options.chaseSteps = std::max<uint32_t>(1, options.chaseSteps);
+    const auto nodes = cpu.Topology.numaNodes.size();
+    NumaProbeResult result;
+    result.latencies.assign(nodes * nodes, 0.0f);
+    result.readBandwidths.assign(nodes * nodes, 0.0f);
+    result.copyBandwidths.assign(nodes * nodes, 0.0f);
+
+    for (size_t from = 0; from < nodes; ++from) {
+        const auto& node = cpu.Topology.numaNodes[from];
+        if (node.cores.empty()) {
+            continue;
+        }
+
+        auto latencyBytes = options.latencyBytes;
+        if (latencyBytes == 0) {
+            latencyBytes = size_t(64) << 20;
+            for (const auto& cache : node.cores.front()->caches) {
+                latencyBytes = std::max(latencyBytes, size_t(4) * cache.size);
+            }
+            latencyBytes = std::min(latencyBytes, size_t(1) << 30);
+        }
+
+        for (size_t to = 0; to < nodes; ++to) {
+            // A private arena, the shared ones need CpuTopology::get() which may be under construction.
+            NumaArena memory(cpu.Topology.numaNodes[to].sysNumaNode);
+            result.latencies[from * nodes + to] = static_cast<float>(chaseLatency(node, memory, latencyBytes, options));
+            auto bandwidth = streamBandwidth(node, memory, options);
+            result.readBandwidths[from * nodes + to] = static_cast<float>(bandwidth.first);
+            result.copyBandwidths[from * nodes + to] = static_cast<float>(bandwidth.second);
+        }
+    }
+    return result;
+}
+
+
+bool saveNumaProbe(const std::string& path, const CpuTopology& cpu, const NumaProbeResult& result) {
+    return saveMeasurement(path, cpu, static_cast<uint32_t>(cpu.Topology.numaNodes.size()),
+        { &result.latencies, &result.readBandwidths, &result.copyBandwidths });
+}
+
+
+bool loadNumaProbe(const std::string& path, const CpuTopology& cpu, NumaProbeResult& result) {
+    return loadMeasurement(path, cpu, static_cast<uint32_t>(cpu.Topology.numaNodes.size()),
+        { &result.latencies, &result.readBandwidths, &result.copyBandwidths });
+}
+
+
+std::string numaProbeCachePath(const CpuTopology& cpu) {
+    return measurementCachePath(cpu, "numa_probe");
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Options of the NUMA node pair probe. */
+struct NumaProbeOptions {
+    /* Pointer chase footprint, 0 picks 4 times the largest cache of the probing core, 64 MB ~ 1 GB. */
+    size_t latencyBytes = 0;
+    /* Dependent loads per latency sample. */
+    uint32_t chaseSteps = 1 << 20;
+    /* Bytes streamed per bandwidth sample. */
+    size_t bandwidthBytes = size_t(256) << 20;
+    /* Samples per node pair, the best one is kept. 0 counts as 1. */
+    uint32_t samples = 3;
+};
+
+
+/* Node pair matrices, numaNodes.size() * numaNodes.size() row-major,
+   the row is the node running the threads and the column the node holding the memory. */
+struct NumaProbeResult {
+    /* Dependent load latency of one core in ns. */
+    std::vector<float> latencies;
+    /* Read bandwidth of every core of the row node in GB/s. */
+    std::vector<float> readBandwidths;
+    /* Copy bandwidth of every core of the row node in GB/s, read and write bytes both count. */
+    std::vector<float> copyBandwidths;
+};
+
+
+/* Measure every node pair with threads pinned to the row node and memory bound to the column node. */
+NumaProbeResult probeNuma(const CpuTopology& cpu, const NumaProbeOptions& options = NumaProbeOptions());
+
+/* Persist the probe, please see MeasurementCache.h. */
+bool saveNumaProbe(const std::string& path, const CpuTopology& cpu, const NumaProbeResult& result);
+
+/* Load the probe, fails if it was measured on another host or another node count. */
+bool loadNumaProbe(const std::string& path, const CpuTopology& cpu, NumaProbeResult& result);
+
+/* Default file of the probe in CpuTopology::cacheDirectory(). */
+std::string numaProbeCachePath(const CpuTopology& cpu);
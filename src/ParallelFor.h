@@ -0,0 +1,114 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+
+
+/* Chunk [first, second) of [begin, end) for the worker at position of count workers.
+   Equal chunks in topology order split the range across sockets, then NUMA nodes, complex groups and cores
+   in proportion to their workers, and a worker gets the same chunk whenever range and pool are the same. */
+inline std::pair<size_t, size_t> topologyChunk(size_t begin, size_t end, uint32_t position, uint32_t count) {
+    auto length = end - begin;
+    auto chunkBegin = begin + length / count * position + std::min<size_t>(position, length % count);
+    auto chunkEnd = chunkBegin + length / count + (position < length % count ? 1 : 0);
+    return { chunkBegin, chunkEnd };
+}
+
+
+/* Call body(first, last) on every worker of pool with its topologyChunk() of [begin, end), and wait.
+   Chunks are submitted with ThreadPool::submitTo() and never stolen, so pages first touched by a
+   parallelFor stay on the NUMA node (and lines in the L2) of the worker which keeps using them. */
+template <typename F>
+void parallelFor(ThreadPool& pool, size_t begin, size_t end, F&& body) {
+    if (begin >= end) {
+        return;
+    }
+    const auto count = static_cast<uint32_t>(pool.size());
+    std::atomic<uint32_t> pending{ count };
+    for (uint32_t position = 0; position < count; ++position) {
+        auto chunk = topologyChunk(begin, end, position, count);
+        pool.submitTo(pool.workerAt(position), [&body, &pending, chunk]() {
+            if (chunk.first < chunk.second) {
+                body(chunk.first, chunk.second);
+            }
+            pending.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    while (pending.load(std::memory_order_acquire)) {
+        if (!pool.runPendingTask()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+
+/* combine(identity, map(first, last)) over the topologyChunk()s of [begin, end), combined hierarchically:
+   the last worker of a complex group to finish folds the group's partial results while they are in its L3,
+   the last complex group of a NUMA node folds the node, then socket and pool. combine must be associative;
+   partial results are combined in topology order, so the result does not depend on timing. T must be default constructible. */
+template <typename T, typename Map, typename Combine>
+T parallelReduce(ThreadPool& pool, size_t begin, size_t end, T identity, Map&& map, Combine&& combine) {
+    if (begin >= end) {
+        return identity;
+    }
+    constexpr int levels = static_cast<int>(ThreadPool::Level::pool) + 1;
+    const auto count = static_cast<uint32_t>(pool.size());
+
+    struct alignas(64) Slot {
+        T value;
+        /* Children which have not reported yet, the one taking it to 0 combines them. */
+        std::atomic<uint32_t> pending{ 0 };
+    };
+    // Level l result of the domain starting at position p is slots[(l + 1) * count + p], level -1 holds the chunks.
+    std::unique_ptr<Slot[]> slots(new Slot[size_t(levels + 1) * count]);
+    auto slot = [&](int level, uint32_t position) -> Slot& { return slots[size_t(level + 1) * count + position]; };
+    auto range = [&](int level, uint32_t position) {
+        return level < 0 ? std::make_pair(position, position + 1) : pool.domainRange(pool.workerAt(position), static_cast<ThreadPool::Level>(level));
+    };
+
+    for (int level = 0; level < levels; ++level) {
+        for (uint32_t position = 0; position < count; position = range(level, position).second) {
+            uint32_t children = 0;
+            auto domain = range(level, position);
+            for (auto child = domain.first; child < domain.second; child = range(level - 1, child).second) {
+                ++children;
+            }
+            slot(level, position).pending.store(children, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint32_t> pending{ count };
+    for (uint32_t position = 0; position < count; ++position) {
+        auto chunk = topologyChunk(begin, end, position, count);
+        pool.submitTo(pool.workerAt(position), [&, position, chunk]() {
+            slot(-1, position).value = chunk.first < chunk.second ? map(chunk.first, chunk.second) : identity;
+            for (int level = 0; level < levels; ++level) {
+                auto domain = range(level, position);
+                auto& parent = slot(level, domain.first);
+                if (parent.pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                    break;
+                }
+                auto value = identity;
+                for (auto child = domain.first; child < domain.second; child = range(level - 1, child).second) {
+                    value = combine(value, slot(level - 1, child).value);
+                }
+                parent.value = std::move(value);
+            }
+            pending.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    while (pending.load(std::memory_order_acquire)) {
+        if (!pool.runPendingTask()) {
+            std::this_thread::yield();
+        }
+    }
+    return slot(levels - 1, 0).value;
+}
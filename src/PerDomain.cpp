@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <limits>
+
+#include "NumaAllocator.h"
+#include "PerDomain.h"
+
+
+DomainSlots::DomainSlots(const CpuTopology& cpu, DomainLevel level, size_t size, size_t alignment) {
+    constexpr auto none = CpuTopology::FlatTopologyInfo::none;
+    const auto& flat = cpu.FlatTopology;
+
+    // Largest line of any cache, a false sharing free stride on every level.
+    size_t line = 0;
+    for (const auto& cache : cpu.caches) {
+        if (cache.line != std::numeric_limits<uint32_t>::max()) {
+            line = std::max<size_t>(line, cache.line);
+        }
+    }
+    if (line == 0) {
+        line = 64;
+    }
+    line = std::max(line, alignment);
+    slotStride = (std::max<size_t>(size, 1) + line - 1) / line * line;
+
+    std::vector<uint32_t> sysNumaNodes;
+    switch (level) {
+    case DomainLevel::core:
+        for (const auto& core : cpu.Topology.cores) {
+            sysNumaNodes.push_back(core.sysNumaNode);
+        }
+        break;
+    case DomainLevel::complexGroup:
+        for (const auto& complexGroup : cpu.Topology.complexGroups) {
+            sysNumaNodes.push_back(complexGroup.sysNumaNode);
+        }
+        break;
+    case DomainLevel::numaNode:
+        for (const auto& numaNode : cpu.Topology.numaNodes) {
+            sysNumaNodes.push_back(numaNode.sysNumaNode);
+        }
+        break;
+    }
+    // Unknown topology, one slot shared by every thread.
+    if (sysNumaNodes.empty()) {
+        sysNumaNodes.push_back(std::numeric_limits<uint32_t>::max());
+    }
+
+    slots.reserve(sysNumaNodes.size());
+    try {
+        for (auto sysNumaNode : sysNumaNodes) {
+            auto& arena = sysNumaNode == std::numeric_limits<uint32_t>::max() ? NumaArena::local() : NumaArena::sysNode(sysNumaNode);
+            slots.push_back(arena.allocate(slotStride, line));
+        }
+    }
+    catch (...) {
+        for (auto slot : slots) {
+            NumaArena::release(slot);
+        }
+        throw;
+    }
+
+    processorDomains.resize(flat.processors.size(), 0);
+    for (size_t i = 0; i < flat.processors.size(); ++i) {
+        const auto& location = flat.processors[i];
+        uint16_t domain = none;
+        switch (level) {
+        case DomainLevel::core: domain = location.core; break;
+        case DomainLevel::complexGroup: domain = location.complexGroup; break;
+        case DomainLevel::numaNode: domain = location.numaNode; break;
+        }
+        if (domain != none && domain < slots.size()) {
+            processorDomains[i] = domain;
+        }
+    }
+}
+
+
+DomainSlots::~DomainSlots() {
+    for (auto slot : slots) {
+        NumaArena::release(slot);
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Topology level a PerDomain container keeps one slot for. */
+enum class DomainLevel {
+    core,
+    complexGroup,
+    numaNode,
+};
+
+
+/* Untyped slots of a PerDomain, one per domain of a level.
+   Every slot is a separate NumaArena block on the domain's NUMA node, aligned to the largest cache line
+   CpuTopology reports and padded to a multiple of it, so no two slots share a line. */
+class DomainSlots {
+public:
+    DomainSlots(const DomainSlots&) = delete;
+    DomainSlots& operator = (const DomainSlots&) = delete;
+
+    /* Number of slots, at least one. */
+    uint32_t size() const { return static_cast<uint32_t>(slots.size()); }
+
+    /* Bytes between the start of two slots' lines, a multiple of the cache line. */
+    size_t stride() const { return slotStride; }
+
+    /* Slot of the calling thread's domain, 0 for a processor outside the topology. */
+    uint32_t localDomain() const {
+        auto processor = currentProcessor();
+        return processor < processorDomains.size() ? processorDomains[processor] : 0;
+    }
+
+protected:
+    DomainSlots(const CpuTopology& cpu, DomainLevel level, size_t size, size_t alignment);
+    ~DomainSlots();
+
+    void* slot(uint32_t domain) const { return slots[domain]; }
+
+private:
+    std::vector<void*> slots;
+    /* Domain per CpuSet::index. */
+    std::vector<uint32_t> processorDomains;
+    size_t slotStride = 0;
+};
+
+
+/* One T per core, complex group or NUMA node of cpu, see DomainSlots for the layout.
+   local() is the slot of the domain the calling thread runs on; threads move, so a slot is shared by every
+   thread that ran in its domain and T must be safe for that (atomics, a lock, or per-domain pinned threads).
+   Slot ids are the domain ids of cpu. */
+template <typename T, DomainLevel level>
+class PerDomain : public DomainSlots {
+public:
+    explicit PerDomain(const CpuTopology& cpu = CpuTopology::process()) : DomainSlots(cpu, level, sizeof(T), alignof(T)) {
+        for (uint32_t i = 0; i < size(); ++i) {
+            new (slot(i)) T();
+        }
+    }
+
+    ~PerDomain() {
+        for (uint32_t i = 0; i < size(); ++i) {
+            (*this)[i].~T();
+        }
+    }
+
+    T& local() { return (*this)[localDomain()]; }
+    const T& local() const { return (*this)[localDomain()]; }
+
+    T& operator [] (uint32_t domain) { return *static_cast<T*>(slot(domain)); }
+    const T& operator [] (uint32_t domain) const { return *static_cast<const T*>(slot(domain)); }
+
+    /* Call f(slot) for every slot in domain order. */
+    template <typename F>
+    void forEach(F&& f) {
+        for (uint32_t i = 0; i < size(); ++i) {
+            f((*this)[i]);
+        }
+    }
+
+    template <typename F>
+    void forEach(F&& f) const {
+        for (uint32_t i = 0; i < size(); ++i) {
+            f((*this)[i]);
+        }
+    }
+
+    /* Fold every slot into init with f(accumulated, slot). */
+    template <typename R, typename F>
+    R reduce(R init, F&& f) const {
+        for (uint32_t i = 0; i < size(); ++i) {
+            init = f(init, (*this)[i]);
+        }
+        return init;
+    }
+};
+
+template <typename T>
+using PerCore = PerDomain<T, DomainLevel::core>;
+
+template <typename T>
+using PerComplexGroup = PerDomain<T, DomainLevel::complexGroup>;
+
+template <typename T>
+using PerNumaNode = PerDomain<T, DomainLevel::numaNode>;
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <tuple>
+
+#include "Placement.h"
+
+
+using CoreInfo = CpuTopology::TopologyInfo::CoreInfo;
+
+
+// Unknown classes rank below every reported one.
+static uint64_t rank(uint32_t value) {
+    return value == std::numeric_limits<uint32_t>::max() ? 0 : value + uint64_t(1);
+}
+
+
+// Cores sorted by socket, NUMA node, complex group and core id, the order of ThreadPool workers.
+static std::vector<const CoreInfo*> domainOrder(const CpuTopology& cpu) {
+    auto key = [](const CoreInfo* core) {
+        constexpr auto none = std::numeric_limits<uint32_t>::max();
+        return std::make_tuple(
+            core->socket ? core->socket->id : none,
+            core->numaNode ? core->numaNode->id : none,
+            core->complexGroup ? core->complexGroup->id : none,
+            core->id);
+    };
+    std::vector<const CoreInfo*> cores;
+    for (const auto& core : cpu.Topology.cores) {
+        cores.push_back(&core);
+    }
+    std::stable_sort(cores.begin(), cores.end(), [&](const CoreInfo* a, const CoreInfo* b) { return key(a) < key(b); });
+    return cores;
+}
+
+
+// Merge sequences by taking one element of each in turn.
+template <typename T>
+static std::vector<T> roundRobin(const std::vector<std::vector<T>>& sequences) {
+    std::vector<T> result;
+    for (size_t i = 0; ; ++i) {
+        auto size = result.size();
+        for (const auto& sequence : sequences) {
+            if (i < sequence.size()) {
+                result.push_back(sequence[i]);
+            }
+        }
+        if (result.size() == size) {
+            return result;
+        }
+    }
+}
+
+
+// Interleave domain-ordered cores level by level: sockets, then NUMA nodes, then complex groups.
+static std::vector<const CoreInfo*> interleave(const std::vector<const CoreInfo*>& cores, int depth) {
+    if (depth == 3 || cores.empty()) {
+        return cores;
+    }
+    auto domain = [depth](const CoreInfo* core) -> const void* {
+        switch (depth) {
+        case 0: return core->socket;
+        case 1: return core->numaNode;
+        default: return core->complexGroup;
+        }
+    };
+
+    // Domains are contiguous runs in domain order.
+    std::vector<std::vector<const CoreInfo*>> domains;
+    for (size_t begin = 0; begin < cores.size();) {
+        auto end = begin + 1;
+        while (end < cores.size() && domain(cores[end]) == domain(cores[begin])) {
+            ++end;
+        }
+        domains.push_back(interleave(std::vector<const CoreInfo*>(cores.begin() + begin, cores.begin() + end), depth + 1));
+        begin = end;
+    }
+    return roundRobin(domains);
+}
+
+
+// Logical processors of cores, thread t of every core before thread t + 1 of any.
+static std::vector<CpuSet> firstThreadsFirst(const std::vector<const CoreInfo*>& cores) {
+    std::vector<std::vector<CpuSet>> threads;
+    for (const auto* core : cores) {
+        std::vector<CpuSet> processors;
+        for (auto processor : core->sysLogicalProcessors) {
+            processors.emplace_back();
+            processors.back().set(CpuSet::index(core->sysProcessorGroup, processor));
+        }
+        threads.push_back(std::move(processors));
+    }
+    return roundRobin(threads);
+}
+
+
+std::vector<CpuSet> planPlacement(uint32_t threads, PlacementPolicy policy, const CpuTopology& cpu) {
+    std::vector<CpuSet> slots;
+    switch (policy) {
+    case PlacementPolicy::compact:
+        for (const auto* core : domainOrder(cpu)) {
+            for (auto processor : core->sysLogicalProcessors) {
+                slots.emplace_back();
+                slots.back().set(CpuSet::index(core->sysProcessorGroup, processor));
+            }
+        }
+        break;
+    case PlacementPolicy::spread:
+        slots = firstThreadsFirst(interleave(domainOrder(cpu), 0));
+        break;
+    case PlacementPolicy::onePerComplexGroup: {
+        // The first core of every complex group in spread order stands for its group.
+        std::vector<const CpuTopology::TopologyInfo::ComplexGroupInfo*> seen;
+        for (const auto* core : interleave(domainOrder(cpu), 0)) {
+            if (core->complexGroup && std::find(seen.cbegin(), seen.cend(), core->complexGroup) == seen.cend()) {
+                seen.push_back(core->complexGroup);
+                slots.push_back(core->complexGroup->cpuSet);
+            }
+        }
+        break;
+    }
+    case PlacementPolicy::physicalCores:
+        for (const auto* core : domainOrder(cpu)) {
+            if (!core->sysLogicalProcessors.empty()) {
+                slots.emplace_back();
+                slots.back().set(CpuSet::index(core->sysProcessorGroup, core->sysLogicalProcessors.front()));
+            }
+        }
+        break;
+    case PlacementPolicy::highestSchedulingClass: {
+        auto cores = domainOrder(cpu);
+        std::stable_sort(cores.begin(), cores.end(), [&](const CoreInfo* a, const CoreInfo* b) {
+            return std::make_pair(rank(a->schedulingClass), rank(a->efficiencyClass)) >
+                std::make_pair(rank(b->schedulingClass), rank(b->efficiencyClass));
+        });
+        slots = firstThreadsFirst(cores);
+        break;
+    }
+    }
+
+    std::vector<CpuSet> plan(threads);
+    if (!slots.empty()) {
+        for (uint32_t t = 0; t < threads; ++t) {
+            plan[t] = slots[t % slots.size()];
+        }
+    }
+    return plan;
+}
+
+
+// Processors of the cores whose class ranks highest (or lowest), whole cpuSet when every core ranks the same.
+// With a single efficiency class, the split falls back to the scheduling class.
+static CpuSet classProcessors(const CpuTopology& cpu, bool highest) {
+    if (cpu.Topology.cores.empty()) {
+        return cpu.Topology.cpuSet;
+    }
+    auto bounds = [&](uint32_t CoreInfo::* member) {
+        auto low = rank(cpu.Topology.cores.front().*member);
+        auto high = low;
+        for (const auto& core : cpu.Topology.cores) {
+            low = std::min(low, rank(core.*member));
+            high = std::max(high, rank(core.*member));
+        }
+        return std::make_pair(low, high);
+    };
+
+    auto efficiency = bounds(&CoreInfo::efficiencyClass);
+    auto scheduling = bounds(&CoreInfo::schedulingClass);
+    CpuSet result;
+    for (const auto& core : cpu.Topology.cores) {
+        if (efficiency.first != efficiency.second) {
+            if (rank(core.efficiencyClass) == (highest ? efficiency.second : efficiency.first)) {
+                result |= core.cpuSet;
+            }
+        }
+        else if (highest == (rank(core.schedulingClass) == scheduling.second)) {
+            result |= core.cpuSet;
+        }
+    }
+    return result.empty() ? cpu.Topology.cpuSet : result;
+}
+
+
+CpuSet latencyCriticalProcessors(const CpuTopology& cpu) {
+    return classProcessors(cpu, true);
+}
+
+
+CpuSet backgroundProcessors(const CpuTopology& cpu) {
+    return classProcessors(cpu, false);
+}
+
+
+const char* placementPolicyName(PlacementPolicy policy) {
+    switch (policy) {
+    case PlacementPolicy::compact: return "compact";
+    case PlacementPolicy::spread: return "spread";
+    case PlacementPolicy::onePerComplexGroup: return "one per complex group";
+    case PlacementPolicy::physicalCores: return "physical cores";
+    case PlacementPolicy::highestSchedulingClass: return "highest scheduling class";
+    }
+    return "unknown";
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+
+#include <cstdint>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* How planPlacement() spreads threads over the topology. */
+enum class PlacementPolicy {
+    /* Fill every SMT sibling of a core, then the next core of the same complex group,
+       NUMA node and socket. Threads share caches, memory bandwidth is that of one domain. */
+    compact,
+    /* Round robin across sockets, then NUMA nodes, then complex groups, then cores.
+       SMT siblings are only used once every core has a thread. Maximizes bandwidth and cache capacity. */
+    spread,
+    /* Each thread owns a whole complex group (all processors sharing one L3), in spread order.
+       More threads than complex groups share them round robin. */
+    onePerComplexGroup,
+    /* The first logical processor of each core in compact order, SMT siblings are never used.
+       More threads than cores share them round robin. */
+    physicalCores,
+    /* Cores by descending schedulingClass (CPPC preferred cores), then descending efficiencyClass
+       (performance cores on hybrid parts), first threads before SMT siblings. */
+    highestSchedulingClass,
+};
+
+
+/* One CpuSet per thread, in thread order. Every set is one logical processor except for
+   PlacementPolicy::onePerComplexGroup. A topology without cores yields empty sets, i.e. no pinning.
+   Plans against the process view by default so disallowed processors are never used. */
+std::vector<CpuSet> planPlacement(uint32_t threads, PlacementPolicy policy, const CpuTopology& cpu = CpuTopology::process());
+
+/* Processors for latency-critical threads such as request handlers: the cores of the highest efficiencyClass
+   (P-cores of a hybrid CPU). On a CPU with a single efficiency class, the cores of the highest schedulingClass
+   (CPPC preferred cores). Every processor of cpu when neither class tells cores apart. */
+CpuSet latencyCriticalProcessors(const CpuTopology& cpu = CpuTopology::process());
+
+/* Processors for background threads such as compaction and logging: the cores of the lowest efficiencyClass
+   (E-cores). On a CPU with a single efficiency class, every core outside the highest schedulingClass so the
+   preferred cores stay free. Every processor of cpu when neither class tells cores apart. */
+CpuSet backgroundProcessors(const CpuTopology& cpu = CpuTopology::process());
+
+/* Name of a policy, for logs and benchmarks. */
+const char* placementPolicyName(PlacementPolicy policy);
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+
+#include "ProbeUtils.h"
+
+
+double chaseNanoseconds(void* start, uint32_t steps, uint32_t samples) {
+    auto best = std::numeric_limits<double>::max();
+    for (uint32_t sample = 0; sample < samples; ++sample) {
+        void* sink = nullptr;
+        auto elapsed = elapsedSeconds([&]() {
+            auto p = start;
+            for (uint32_t step = 0; step < steps; ++step) {
+                p = *static_cast<void**>(p);
+            }
+            sink = p;
+        });
+        // Keeps the loop, a chase never ends on nullptr.
+        if (sink) {
+            best = std::min(best, elapsed * 1e9 / steps);
+        }
+    }
+    return best;
+}
+
+
+double runPinned(const std::vector<CpuSet>& cpuSets, const std::function<void(size_t)>& setup, const std::function<void(size_t)>& work) {
+    std::atomic<size_t> ready{ 0 };
+    std::atomic<bool> go{ false };
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < cpuSets.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            if (!cpuSets[t].empty()) {
+                bindCurrentThread(cpuSets[t]);
+            }
+            if (setup) {
+                setup(t);
+            }
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            work(t);
+        });
+    }
+    while (ready.load() < cpuSets.size()) {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
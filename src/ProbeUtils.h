@@ -0,0 +1,30 @@
+#pragma once
+
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "CpuSet.h"
+
+
+/* Timing helpers of the cache and NUMA probes, the benchmarks run their plans through runPinned() too. */
+
+/* Seconds taken by f. */
+template <typename F>
+double elapsedSeconds(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Follow steps links from start, every link holding the address of the next one.
+   Returns the best ns per load of samples runs on the calling thread. */
+double chaseNanoseconds(void* start, uint32_t steps, uint32_t samples);
+
+/* Run work(t) on one thread per entry of cpuSets, pinned to it unless it is empty, after setup(t) finished
+   on every thread, setup may be empty. Returns the seconds between the common start and the last finish. */
+double runPinned(const std::vector<CpuSet>& cpuSets, const std::function<void(size_t)>& setup, const std::function<void(size_t)>& work);
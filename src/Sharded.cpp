@@ -0,0 +1,76 @@
+#include "Sharded.h"
+
+
+int64_t ShardedCounter::value() const {
+    return shards.reduce(int64_t(0), [](int64_t sum, const std::atomic<int64_t>& shard) {
+        return sum + shard.load(std::memory_order_relaxed);
+    });
+}
+
+
+void ShardedCounter::reset() {
+    shards.forEach([](std::atomic<int64_t>& shard) { shard.store(0, std::memory_order_relaxed); });
+}
+
+
+ShardedFreeList::ShardedFreeList(const CpuTopology& cpu) : shards(cpu) {
+    constexpr auto none = CpuTopology::FlatTopologyInfo::none;
+    const auto& numaNodes = cpu.FlatTopology.complexGroupNumaNodes;
+    auto numaNode = [&](uint32_t shard) { return shard < numaNodes.size() ? numaNodes[shard] : none; };
+
+    stealOrder.resize(shards.size());
+    for (uint32_t i = 0; i < shards.size(); ++i) {
+        for (uint32_t j = 0; j < shards.size(); ++j) {
+            if (j != i && numaNode(j) == numaNode(i)) {
+                stealOrder[i].push_back(j);
+            }
+        }
+        for (uint32_t j = 0; j < shards.size(); ++j) {
+            if (j != i && numaNode(j) != numaNode(i)) {
+                stealOrder[i].push_back(j);
+            }
+        }
+    }
+}
+
+
+void ShardedFreeList::push(void* block) {
+    auto& shard = shards.local();
+    std::lock_guard<std::mutex> guard(shard.lock);
+    *static_cast<void**>(block) = shard.head;
+    shard.head = block;
+    ++shard.count;
+}
+
+
+void* ShardedFreeList::pop() {
+    auto local = shards.localDomain();
+    if (auto block = popShard(shards[local])) {
+        return block;
+    }
+    for (auto victim : stealOrder[local]) {
+        if (auto block = popShard(shards[victim])) {
+            return block;
+        }
+    }
+    return nullptr;
+}
+
+
+size_t ShardedFreeList::size() const {
+    return shards.reduce(size_t(0), [](size_t sum, const Shard& shard) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        return sum + shard.count;
+    });
+}
+
+
+void* ShardedFreeList::popShard(Shard& shard) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto block = shard.head;
+    if (block) {
+        shard.head = *static_cast<void**>(block);
+        --shard.count;
+    }
+    return block;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "PerDomain.h"
+
+
+/* Counter with one shard per core: add() touches only the calling core's line, value() sums every shard.
+   For statistics bumped from many threads and read rarely, value() is not a snapshot of one instant. */
+class ShardedCounter {
+public:
+    explicit ShardedCounter(const CpuTopology& cpu = CpuTopology::process()) : shards(cpu) {}
+
+    void add(int64_t value = 1) { shards.local().fetch_add(value, std::memory_order_relaxed); }
+
+    int64_t value() const;
+
+    void reset();
+
+private:
+    PerCore<std::atomic<int64_t>> shards;
+};
+
+
+/* Intrusive LIFO of free blocks with one shard per complex group.
+   push() gives a block to the calling thread's complex group, pop() takes one from there first,
+   then steals from the other complex groups of the same NUMA node and only then from the rest,
+   so a block usually goes back to the L3 that last touched it. The list links blocks through their first
+   word, every block must be at least sizeof(void*) bytes; it never allocates or frees them. */
+class ShardedFreeList {
+public:
+    explicit ShardedFreeList(const CpuTopology& cpu = CpuTopology::process());
+
+    ShardedFreeList(const ShardedFreeList&) = delete;
+    ShardedFreeList& operator = (const ShardedFreeList&) = delete;
+
+    void push(void* block);
+
+    /* nullptr if every shard is empty. */
+    void* pop();
+
+    /* Blocks in every shard, only exact while no thread pushes or pops. */
+    size_t size() const;
+
+private:
+    struct Shard {
+        mutable std::mutex lock;
+        void* head = nullptr;
+        size_t count = 0;
+    };
+
+    /* Pop from one shard, nullptr if it is empty. */
+    void* popShard(Shard& shard);
+
+    PerComplexGroup<Shard> shards;
+    /* Shards in steal order for each shard: same NUMA node first, then the others, the shard itself excluded. */
+    std::vector<std::vector<uint32_t>> stealOrder;
+};
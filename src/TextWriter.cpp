@@ -0,0 +1,93 @@
+#include <algorithm>
+
+#include "TextWriter.h"
+
+
+void TextWriter::flush() {
+    if (used) {
+        sink(buffer, used);
+        used = 0;
+    }
+    if (file) {
+        std::fflush(file);
+    }
+    else if (stream) {
+        stream->flush();
+    }
+}
+
+
+void TextWriter::sink(const char* data, size_t size) {
+    if (file) {
+        std::fwrite(data, 1, size, file);
+    }
+    else if (stream) {
+        stream->write(data, static_cast<std::streamsize>(size));
+    }
+}
+
+
+TextWriter& TextWriter::operator << (double value) {
+    char text[32];
+    auto length = std::snprintf(text, sizeof(text), "%g", value);
+    if (length > 0) {
+        write(text, std::min(static_cast<size_t>(length), sizeof(text) - 1));
+    }
+    return *this;
+}
+
+
+TextWriter& TextWriter::hex(uint64_t value, uint32_t digits) {
+    static const char hexDigits[] = "0123456789abcdef";
+    char text[16];
+    uint32_t count = 0;
+    do {
+        text[sizeof(text) - 1 - count++] = hexDigits[value & 0xF];
+        value >>= 4;
+    } while (value);
+    for (; count < digits && count < sizeof(text); ++count) {
+        text[sizeof(text) - 1 - count] = '0';
+    }
+    write(text + sizeof(text) - count, count);
+    return *this;
+}
+
+
+void writeCpuList(TextWriter& out, const CpuSet& set) {
+    const char* separator = "";
+    for (auto first = set.first(); first < CpuSet::maxProcessors;) {
+        auto last = first;
+        while (set.test(last + 1)) {
+            ++last;
+        }
+        out << separator << first;
+        if (last != first) {
+            out << '-' << last;
+        }
+        separator = ",";
+        first = set.next(last + 1);
+    }
+}
+
+
+void writeCpuMask(TextWriter& out, const CpuSet& set) {
+    // 32 bit words from the highest non-empty one down.
+    int32_t word = static_cast<int32_t>(CpuSet::maxProcessors / 32) - 1;
+    auto word32 = [&](int32_t i) {
+        return static_cast<uint32_t>(set.bits[i / 2] >> (i % 2 * 32));
+    };
+    while (word > 0 && !word32(word)) {
+        --word;
+    }
+    if (word == 0 && !word32(0)) {
+        out << "0x0";
+        return;
+    }
+    for (; word >= 0; --word) {
+        out << "0x";
+        out.hex(word32(word), 8);
+        if (word) {
+            out << ',';
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+#include "CpuSet.h"
+
+
+/* Narrow buffered text output for the command line tools.
+   Values are formatted straight into a fixed buffer which goes out when it fills up, on flush and on destruction,
+   so writing a number or a string allocates nothing. */
+class TextWriter {
+public:
+    explicit TextWriter(std::FILE* file) : file(file) {}
+    explicit TextWriter(std::ostream& stream) : stream(&stream) {}
+    ~TextWriter() { flush(); }
+
+    TextWriter(const TextWriter&) = delete;
+    TextWriter& operator = (const TextWriter&) = delete;
+
+    void write(const char* data, size_t size) {
+        if (used + size > sizeof(buffer)) {
+            flush();
+            if (size > sizeof(buffer)) {
+                sink(data, size);
+                return;
+            }
+        }
+        std::memcpy(buffer + used, data, size);
+        used += size;
+    }
+
+    void flush();
+
+    TextWriter& operator << (char c) {
+        if (used == sizeof(buffer)) {
+            flush();
+        }
+        buffer[used++] = c;
+        return *this;
+    }
+
+    TextWriter& operator << (const char* text) {
+        write(text, std::strlen(text));
+        return *this;
+    }
+
+    TextWriter& operator << (const std::string& text) {
+        write(text.data(), text.size());
+        return *this;
+    }
+
+    /* 1 or 0, as std::ostream writes it. */
+    TextWriter& operator << (bool value) {
+        return *this << (value ? '1' : '0');
+    }
+
+    template <typename T, std::enable_if_t<std::is_integral<T>::value, int> = 0>
+    TextWriter& operator << (T value) {
+        if (std::is_signed<T>::value && value < 0) {
+            *this << '-';
+            return writeUnsigned(0 - static_cast<uint64_t>(value));
+        }
+        return writeUnsigned(static_cast<uint64_t>(value));
+    }
+
+    /* Shortest of fixed or scientific with 6 significant digits, as std::ostream writes it. */
+    TextWriter& operator << (double value);
+
+    /* Lower case hexadecimal, zero padded to at least digits. */
+    TextWriter& hex(uint64_t value, uint32_t digits = 0);
+
+private:
+    TextWriter& writeUnsigned(uint64_t value) {
+        char digits[20];
+        auto end = digits + sizeof(digits);
+        auto begin = end;
+        do {
+            *--begin = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value);
+        write(begin, static_cast<size_t>(end - begin));
+        return *this;
+    }
+
+    void sink(const char* data, size_t size);
+
+    std::FILE* file = nullptr;
+    std::ostream* stream = nullptr;
+    size_t used = 0;
+    char buffer[16 * 1024];
+};
+
+
+/* Kernel cpulist format of set, e.g. "0-3,8,10-11". */
+void writeCpuList(TextWriter& out, const CpuSet& set);
+
+/* Hexadecimal mask of set in 32 bit words, most significant first, e.g. "0x00000001,0x0000ff00",
+   the cpuset format of hwloc. An empty set is "0x0". */
+void writeCpuMask(TextWriter& out, const CpuSet& set);
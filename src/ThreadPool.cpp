@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <tuple>
+
+#include "ThreadPool.h"
+
+
+// Pool and worker index of the calling thread.
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentIndex = 0;
+
+
+ThreadPool::ThreadPool(Granularity granularity, const CpuTopology& cpu) {
+    const size_t limit = cpu.effectiveParallelism();
+    if (granularity == Granularity::core) {
+        for (const auto& core : cpu.Topology.cores) {
+            if (workers.size() == limit) {
+                break;
+            }
+            auto worker = std::make_unique<Worker>();
+            worker->core = core.id;
+            worker->cpuSet = core.cpuSet;
+            workers.push_back(std::move(worker));
+        }
+    }
+    else {
+        // Thread t of every core before thread t + 1 of any, a quota below the processor count skips SMT siblings.
+        for (size_t thread = 0; workers.size() < limit; ++thread) {
+            auto added = workers.size();
+            for (const auto& core : cpu.Topology.cores) {
+                if (thread < core.sysLogicalProcessors.size() && workers.size() < limit) {
+                    auto worker = std::make_unique<Worker>();
+                    worker->core = core.id;
+                    worker->cpuSet.set(CpuSet::index(core.sysProcessorGroup, core.sysLogicalProcessors[thread]));
+                    workers.push_back(std::move(worker));
+                }
+            }
+            if (workers.size() == added) {
+                break;
+            }
+        }
+    }
+
+    // Unknown topology, still run one unpinned worker.
+    if (workers.empty()) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+
+    // Sort workers by socket, NUMA node, complex group and core so that each domain is contiguous.
+    auto domainKey = [&](uint32_t index) {
+        constexpr auto none = std::numeric_limits<uint32_t>::max();
+        auto coreID = workers[index]->core;
+        if (coreID >= cpu.Topology.cores.size()) {
+            return std::make_tuple(none, none, none, none);
+        }
+        const auto& core = cpu.Topology.cores[coreID];
+        return std::make_tuple(
+            core.socket ? core.socket->id : none,
+            core.numaNode ? core.numaNode->id : none,
+            core.complexGroup ? core.complexGroup->id : none,
+            core.id);
+    };
+
+    stealOrder.resize(workers.size());
+    for (uint32_t i = 0; i < stealOrder.size(); ++i) {
+        stealOrder[i] = i;
+    }
+    std::stable_sort(stealOrder.begin(), stealOrder.end(),
+        [&](uint32_t a, uint32_t b) { return domainKey(a) < domainKey(b); });
+
+    // Equal key prefix of two workers, the deepest shared level first: core, complex group, NUMA node, socket.
+    auto sameDomain = [&](uint32_t a, uint32_t b, int level) {
+        auto ka = domainKey(a);
+        auto kb = domainKey(b);
+        switch (level) {
+        case 0: return ka == kb;
+        case 1: return std::get<0>(ka) == std::get<0>(kb) && std::get<1>(ka) == std::get<1>(kb) && std::get<2>(ka) == std::get<2>(kb);
+        case 2: return std::get<0>(ka) == std::get<0>(kb) && std::get<1>(ka) == std::get<1>(kb);
+        case 3: return std::get<0>(ka) == std::get<0>(kb);
+        default: return true;
+        }
+    };
+
+    const auto count = static_cast<uint32_t>(stealOrder.size());
+    for (uint32_t p = 0; p < count; ++p) {
+        workers[stealOrder[p]]->position = p;
+    }
+    for (int level = 0; level < 5; ++level) {
+        uint32_t begin = 0;
+        while (begin < count) {
+            auto end = begin + 1;
+            while (end < count && sameDomain(stealOrder[begin], stealOrder[end], level)) {
+                ++end;
+            }
+            for (auto p = begin; p < end; ++p) {
+                workers[stealOrder[p]]->stealRanges[level] = { begin, end };
+            }
+            begin = end;
+        }
+    }
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i]->thread = std::thread([this, i]() { run(i); });
+    }
+}
+
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> guard(idleLock);
+        stop = true;
+    }
+    idle.notify_all();
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+
+void ThreadPool::submit(Task task) {
+    unfinished.fetch_add(1);
+
+    auto index = currentWorker();
+    if (index == workers.size()) {
+        index = nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    }
+    {
+        decltype(auto) worker = *workers[index];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1);
+
+    if (sleepers.load()) {
+        std::lock_guard<std::mutex> guard(idleLock);
+        idle.notify_one();
+    }
+}
+
+
+void ThreadPool::submitTo(size_t index, Task task) {
+    unfinished.fetch_add(1);
+    {
+        decltype(auto) worker = *workers[index];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.pinnedTasks.push_back(std::move(task));
+        worker.pinned.fetch_add(1);
+    }
+
+    // notify_one() could wake a worker which cannot take the task, the others go back to sleep on their predicate.
+    if (sleepers.load()) {
+        std::lock_guard<std::mutex> guard(idleLock);
+        idle.notify_all();
+    }
+}
+
+
+bool ThreadPool::runPendingTask() {
+    Task task;
+    if (!findTask(currentWorker(), task)) {
+        return false;
+    }
+    task();
+    unfinished.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+
+void ThreadPool::wait() {
+    while (unfinished.load(std::memory_order_acquire)) {
+        if (!runPendingTask()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+
+size_t ThreadPool::currentWorker() const {
+    return currentPool == this ? currentIndex : workers.size();
+}
+
+
+void ThreadPool::run(size_t index) {
+    currentPool = this;
+    currentIndex = index;
+
+    decltype(auto) worker = *workers[index];
+    if (!worker.cpuSet.empty()) {
+        bindCurrentThread(worker.cpuSet);
+    }
+
+    // Spin a little before sleeping, fork-join tasks usually show up within microseconds.
+    constexpr int spins = 64;
+    Task task;
+    while (true) {
+        bool found = false;
+        for (int i = 0; i < spins && !found; ++i) {
+            found = findTask(index, task);
+            if (!found) {
+                std::this_thread::yield();
+            }
+        }
+
+        if (found) {
+            task();
+            task = nullptr;
+            unfinished.fetch_sub(1, std::memory_order_release);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(idleLock);
+        sleepers.fetch_add(1);
+        idle.wait(guard, [this, &worker]() { return stop || queued.load() > 0 || worker.pinned.load() > 0; });
+        sleepers.fetch_sub(1);
+        if (stop) {
+            break;
+        }
+    }
+}
+
+
+bool ThreadPool::popTask(size_t index, Task& task) {
+    decltype(auto) worker = *workers[index];
+    std::lock_guard<std::mutex> guard(worker.lock);
+    if (!worker.pinnedTasks.empty()) {
+        task = std::move(worker.pinnedTasks.front());
+        worker.pinnedTasks.pop_front();
+        worker.pinned.fetch_sub(1);
+    }
+    else if (!worker.tasks.empty()) {
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        queued.fetch_sub(1);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+
+bool ThreadPool::stealTask(size_t index, Task& task) {
+    decltype(auto) victim = *workers[index];
+    if (!victim.lock.try_lock()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(victim.lock, std::adopt_lock);
+    if (victim.tasks.empty()) {
+        return false;
+    }
+    task = std::move(victim.tasks.front());
+    victim.tasks.pop_front();
+    queued.fetch_sub(1);
+    return true;
+}
+
+
+bool ThreadPool::findTask(size_t index, Task& task) {
+    // Only stealable tasks and the worker's own pinned tasks count, another worker's pinned task is not work for it.
+    auto pinned = index < workers.size() ? workers[index]->pinned.load(std::memory_order_relaxed) : 0;
+    if (queued.load(std::memory_order_relaxed) <= 0 && pinned <= 0) {
+        return false;
+    }
+
+    // Not a worker, scan every deque starting from the round robin position.
+    if (index == workers.size()) {
+        auto start = nextWorker.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < workers.size(); ++i) {
+            if (stealTask((start + i) % workers.size(), task)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (popTask(index, task)) {
+        return true;
+    }
+
+    // Steal from the closest domain first, each level skips the range already scanned.
+    decltype(auto) worker = *workers[index];
+    auto innerBegin = worker.position;
+    auto innerEnd = worker.position + 1;
+    for (const auto& range : worker.stealRanges) {
+        for (auto p = innerEnd; p < range.second; ++p) {
+            if (stealTask(stealOrder[p], task)) {
+                return true;
+            }
+        }
+        for (auto p = range.first; p < innerBegin; ++p) {
+            if (stealTask(stealOrder[p], task)) {
+                return true;
+            }
+        }
+        innerBegin = range.first;
+        innerEnd = range.second;
+    }
+    return false;
+}
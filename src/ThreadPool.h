@@ -0,0 +1,151 @@
+#pragma once
+
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Work-stealing thread pool laid out on TopologyInfo.
+   Every worker is pinned to one physical core or one logical processor and owns a deque.
+   The owner pops its newest task, idle workers steal the oldest task of a victim
+   in topology order: SMT sibling, complex group (shared L3), NUMA node, socket, anything. */
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    enum class Granularity {
+        /* One worker per physical core, pinned to all logical processors of the core. */
+        core,
+        /* One worker per logical processor, pinned to that logical processor. */
+        logicalProcessor,
+    };
+
+    /* Workers are capped at cpu.effectiveParallelism(), logical processor workers fill the first
+       thread of every core before any SMT sibling. The default topology is the process view. */
+    explicit ThreadPool(Granularity granularity = Granularity::core, const CpuTopology& cpu = CpuTopology::process());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+    /* Number of workers. */
+    size_t size() const { return workers.size(); }
+
+    /* Nesting levels of the topology order, a domain of each level holds consecutive positions. */
+    enum class Level {
+        core,
+        complexGroup,
+        numaNode,
+        socket,
+        pool,
+    };
+
+    /* Queue a task. Tasks submitted from a worker go to its own deque,
+       tasks from other threads are distributed round robin. */
+    void submit(Task task);
+
+    /* Queue a task which only worker runs, it is never stolen. For work whose data should stay
+       in one core's caches or was first touched from it. */
+    void submitTo(size_t worker, Task task);
+
+    /* Run one queued task on the calling thread, returns false if nothing was found.
+       Lets a thread waiting on nested tasks help instead of blocking a worker. */
+    bool runPendingTask();
+
+    /* Block until every submitted task has finished. */
+    void wait();
+
+    /* Worker index of the calling thread in this pool, size() if it is not a worker. */
+    size_t currentWorker() const;
+
+    /* Workers sorted by socket, NUMA node, complex group and core: position of a worker, and worker at a position. */
+    uint32_t position(size_t worker) const { return workers[worker]->position; }
+    size_t workerAt(uint32_t position) const { return stealOrder[position]; }
+
+    /* Positions [first, second) of the workers sharing the domain of level with worker. */
+    std::pair<uint32_t, uint32_t> domainRange(size_t worker, Level level) const {
+        return workers[worker]->stealRanges[static_cast<int>(level)];
+    }
+
+private:
+    struct Worker {
+        /* Core id in TopologyInfo. */
+        uint32_t core = std::numeric_limits<uint32_t>::max();
+        /* Logical processors this worker is pinned to. */
+        CpuSet cpuSet;
+        /* Nested victim ranges in stealOrder, from the SMT siblings to the whole pool.
+           Each level is scanned without the range of the previous one. */
+        std::pair<uint32_t, uint32_t> stealRanges[5];
+        /* Position in stealOrder. */
+        uint32_t position = 0;
+
+        std::mutex lock;
+        std::deque<Task> tasks;
+        /* submitTo() tasks, run before tasks and never stolen. */
+        std::deque<Task> pinnedTasks;
+        /* Size of pinnedTasks, read without the lock. */
+        std::atomic<int64_t> pinned{ 0 };
+        std::thread thread;
+    };
+
+    void run(size_t index);
+    bool popTask(size_t index, Task& task);
+    bool stealTask(size_t index, Task& task);
+    bool findTask(size_t index, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    /* Worker indices sorted by socket, NUMA node, complex group and core,
+       so every topology domain is a contiguous range. */
+    std::vector<uint32_t> stealOrder;
+
+    /* Stealable tasks queued and not yet picked, pinned tasks are counted by their worker. */
+    std::atomic<int64_t> queued{ 0 };
+    /* Tasks submitted and not yet finished. */
+    std::atomic<int64_t> unfinished{ 0 };
+    std::atomic<uint32_t> sleepers{ 0 };
+    std::atomic<uint32_t> nextWorker{ 0 };
+    std::atomic<bool> stop{ false };
+    std::mutex idleLock;
+    std::condition_variable idle;
+};
+
+
+/* Fork-join helper, wait() runs pool tasks until every task of the group has finished. */
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool(pool) {}
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator = (const TaskGroup&) = delete;
+
+    template <typename F>
+    void run(F&& f) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        pool.submit([this, f = std::forward<F>(f)]() mutable {
+            f();
+            pending.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    void wait() {
+        while (pending.load(std::memory_order_acquire)) {
+            if (!pool.runPendingTask()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    ThreadPool& pool;
+    std::atomic<int64_t> pending{ 0 };
+};
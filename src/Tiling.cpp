@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Tiling.h"
+
+
+using CacheInfo = CpuTopology::CacheInfo;
+using CoreInfo = CpuTopology::TopologyInfo::CoreInfo;
+
+
+// Budget of the data or unified cache of level, measured capacity first.
+static CacheBudget budget(const CoreInfo& core, uint32_t level, uint32_t activeThreads) {
+    constexpr auto unknown = std::numeric_limits<uint32_t>::max();
+    CacheBudget result;
+    for (size_t i = 0; i < core.caches.size(); ++i) {
+        const auto& cache = core.caches[i];
+        if (cache.level != level || cache.type == CpuTopology::CacheType::instruction || cache.size == unknown) {
+            continue;
+        }
+        size_t bytes = cache.size;
+        if (i < core.measuredCaches.size() && core.measuredCaches[i].effectiveSize) {
+            bytes = core.measuredCaches[i].effectiveSize;
+        }
+        // No more threads than the cache's logical processors can share it, however many run elsewhere.
+        auto sharers = cache.shared != unknown && cache.shared ? cache.shared : 1;
+        if (activeThreads) {
+            sharers = std::min(sharers, activeThreads);
+        }
+        bytes /= sharers;
+        // One way stays free for the stack, the loop counters and whatever else the thread touches.
+        // Fully associative caches report 0 or 0xFF ways.
+        if (cache.associativity > 1 && cache.associativity < 0xFF) {
+            bytes = bytes / cache.associativity * (cache.associativity - 1);
+        }
+        result.level = level;
+        result.bytes = bytes;
+        result.line = cache.line != unknown && cache.line ? cache.line : 64;
+        break;
+    }
+    return result;
+}
+
+
+TileAdvice adviseTiles(size_t elementSize, uint32_t operands, uint32_t activeThreads, const CoreInfo& core) {
+    TileAdvice advice;
+    advice.l1 = budget(core, 1, activeThreads);
+    advice.l2 = budget(core, 2, activeThreads);
+    advice.l3 = budget(core, 3, activeThreads);
+
+    elementSize = std::max<size_t>(elementSize, 1);
+    operands = std::max<uint32_t>(operands, 1);
+    auto tile = [&](const CacheBudget& level, size_t& elements, size_t& side) {
+        const auto perLine = std::max<size_t>(level.line / elementSize, 1);
+        elements = level.bytes / operands / elementSize / perLine * perLine;
+        side = static_cast<size_t>(std::sqrt(static_cast<double>(elements)));
+        if (side > perLine) {
+            side = side / perLine * perLine;
+        }
+    };
+    tile(advice.l1, advice.l1Elements, advice.l1Side);
+    tile(advice.l2, advice.l2Elements, advice.l2Side);
+    tile(advice.l3, advice.l3Elements, advice.l3Side);
+
+    if (advice.l1.bytes) {
+        advice.partitionFanout = 1;
+        while (size_t(advice.partitionFanout) * 2 * advice.l1.line <= advice.l1.bytes / 2) {
+            advice.partitionFanout *= 2;
+        }
+    }
+    return advice;
+}
+
+
+TileAdvice adviseTiles(size_t elementSize, uint32_t operands, uint32_t activeThreads, const CpuTopology& cpu) {
+    auto location = cpu.FlatTopology.current();
+    if (location) {
+        return adviseTiles(elementSize, operands, activeThreads, cpu.Topology.cores[location->core]);
+    }
+    if (!cpu.Topology.cores.empty()) {
+        return adviseTiles(elementSize, operands, activeThreads, cpu.Topology.cores.front());
+    }
+    return adviseTiles(elementSize, operands, activeThreads, CoreInfo());
+}
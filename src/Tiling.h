@@ -0,0 +1,135 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Share of one cache level a thread can fill with tiles. */
+struct CacheBudget {
+    /* Cache level, 0 if the core reports no such cache. */
+    uint32_t level = 0;
+    /* Bytes of the level one thread may use: measured effective size when probed (see CacheProbe.h), else the
+       reported size, divided by the threads sharing the level and less one way for everything else. */
+    size_t bytes = 0;
+    /* Line size in bytes. */
+    uint32_t line = 64;
+};
+
+
+/* Block sizes for loops over operands elements of elementSize bytes each, all resident at the same time. */
+struct TileAdvice {
+    CacheBudget l1;
+    CacheBudget l2;
+    /* The core's share of its complex group's L3. */
+    CacheBudget l3;
+
+    /* Elements of one operand tile per level, a whole number of lines. */
+    size_t l1Elements = 0;
+    size_t l2Elements = 0;
+    size_t l3Elements = 0;
+
+    /* Side of a square 2D tile of one operand per level, a multiple of the elements of a line when it is larger. */
+    size_t l1Side = 0;
+    size_t l2Side = 0;
+    size_t l3Side = 0;
+
+    /* Radix partitioning fan-out: a power of two with one line buffer per partition held in half of L1. */
+    uint32_t partitionFanout = 0;
+};
+
+
+/* Tiles for the core the calling thread runs on, or for core.
+   activeThreads is the number of threads expected to run at once, 0 assumes every logical processor is busy.
+   Each level is split between min(activeThreads, CacheInfo::shared) threads, so 16 threads on 8 SMT cores
+   still give each thread half an L1 and L2, and L3 is split between the threads of the complex group the same way. */
+TileAdvice adviseTiles(size_t elementSize, uint32_t operands, uint32_t activeThreads = 0, const CpuTopology& cpu = CpuTopology::process());
+TileAdvice adviseTiles(size_t elementSize, uint32_t operands, uint32_t activeThreads, const CpuTopology::TopologyInfo::CoreInfo& core);
+
+
+/* out (cols x rows) = transpose of in (rows x cols), both row-major, in block x block tiles. */
+template <typename T>
+void transposeBlocked(const T* in, T* out, size_t rows, size_t cols, size_t block) {
+    block = std::max<size_t>(block, 1);
+    for (size_t rowBlock = 0; rowBlock < rows; rowBlock += block) {
+        for (size_t colBlock = 0; colBlock < cols; colBlock += block) {
+            const auto rowEnd = std::min(rowBlock + block, rows);
+            const auto colEnd = std::min(colBlock + block, cols);
+            for (auto row = rowBlock; row < rowEnd; ++row) {
+                for (auto col = colBlock; col < colEnd; ++col) {
+                    out[col * rows + row] = in[row * cols + col];
+                }
+            }
+        }
+    }
+}
+
+
+/* c (m x n) += a (m x k) * b (k x n), row-major. kBlock x nBlock panels of b are reused across mBlock rows of a,
+   the inner loop runs along a row of b and c so it vectorizes. Pick mBlock and kBlock so an mBlock x kBlock block
+   of a stays in L2 and nBlock so a row of the b panel and of c stay in L1. */
+template <typename T>
+void gemmBlocked(const T* a, const T* b, T* c, size_t m, size_t n, size_t k, size_t mBlock, size_t nBlock, size_t kBlock) {
+    mBlock = std::max<size_t>(mBlock, 1);
+    nBlock = std::max<size_t>(nBlock, 1);
+    kBlock = std::max<size_t>(kBlock, 1);
+    for (size_t kk = 0; kk < k; kk += kBlock) {
+        const auto kEnd = std::min(kk + kBlock, k);
+        for (size_t ii = 0; ii < m; ii += mBlock) {
+            const auto iEnd = std::min(ii + mBlock, m);
+            for (size_t jj = 0; jj < n; jj += nBlock) {
+                const auto jEnd = std::min(jj + nBlock, n);
+                for (auto i = ii; i < iEnd; ++i) {
+                    auto cRow = c + i * n;
+                    for (auto p = kk; p < kEnd; ++p) {
+                        const auto aValue = a[i * k + p];
+                        auto bRow = b + p * n;
+                        for (auto j = jj; j < jEnd; ++j) {
+                            cRow[j] += aValue * bRow[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/* One radix partitioning pass of keys on the bits above shift into out (keys.size() elements), fanout a power of two.
+   Every partition fills a line-sized buffer before it goes out, so the pass writes whole lines and touches one
+   buffer line per key instead of a random line of out. offsets gets fanout + 1 entries, partition p is
+   out[offsets[p], offsets[p + 1]). */
+template <typename T, typename Key>
+void radixPartition(const T* keys, size_t count, T* out, uint32_t fanout, uint32_t shift, Key&& key,
+    std::vector<size_t>& offsets, size_t line = 64) {
+    const uint64_t mask = fanout - 1;
+    offsets.assign(fanout + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        ++offsets[((key(keys[i]) >> shift) & mask) + 1];
+    }
+    for (uint32_t p = 0; p < fanout; ++p) {
+        offsets[p + 1] += offsets[p];
+    }
+
+    const size_t perLine = std::max<size_t>(line / sizeof(T), 1);
+    std::vector<T> buffers(static_cast<size_t>(fanout) * perLine);
+    std::vector<size_t> filled(fanout, 0);
+    std::vector<size_t> cursors(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        const auto p = static_cast<size_t>((key(keys[i]) >> shift) & mask);
+        buffers[p * perLine + filled[p]] = keys[i];
+        if (++filled[p] == perLine) {
+            std::memcpy(out + cursors[p], &buffers[p * perLine], perLine * sizeof(T));
+            cursors[p] += perLine;
+            filled[p] = 0;
+        }
+    }
+    for (uint32_t p = 0; p < fanout; ++p) {
+        std::memcpy(out + cursors[p], &buffers[p * perLine], filled[p] * sizeof(T));
+    }
+}
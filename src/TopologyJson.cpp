@@ -0,0 +1,259 @@
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "TopologyJson.h"
+
+
+// JSON string with quotes and control characters escaped, cpuid names are padded with NULs.
+static void writeQuoted(TextWriter& out, const std::string& value) {
+    out << '"';
+    for (auto c : value) {
+        if (c == '\0') {
+            break;
+        }
+        else if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            out << "\\u";
+            out.hex(static_cast<unsigned char>(c), 4);
+        }
+        else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+
+template <typename T>
+static void writeValue(TextWriter& out, T value) {
+    out << value;
+}
+
+
+// JSON has no inf or nan, a measurement that never completed is written as null.
+static void writeValue(TextWriter& out, float value) {
+    if (std::isfinite(value)) {
+        out << value;
+    }
+    else {
+        out << "null";
+    }
+}
+
+
+template <typename T>
+static void writeArray(TextWriter& out, const std::vector<T>& values) {
+    out << '[';
+    for (size_t i = 0; i < values.size(); ++i) {
+        out << (i ? "," : "");
+        writeValue(out, values[i]);
+    }
+    out << ']';
+}
+
+
+// Ids of linked levels.
+template <typename T>
+static void writeIds(TextWriter& out, const std::vector<T*>& links) {
+    out << '[';
+    for (size_t i = 0; i < links.size(); ++i) {
+        out << (i ? "," : "") << links[i]->id;
+    }
+    out << ']';
+}
+
+
+template <typename T>
+static void writeId(TextWriter& out, const T* link) {
+    if (link) {
+        out << link->id;
+    }
+    else {
+        out << "null";
+    }
+}
+
+
+static void writeCaches(TextWriter& out, const std::vector<CpuTopology::CacheInfo>& caches) {
+    static const char* const types[] = { "unknown", "unified", "instruction", "data" };
+    out << '[';
+    for (size_t i = 0; i < caches.size(); ++i) {
+        const auto& cache = caches[i];
+        auto type = static_cast<size_t>(cache.type);
+        out << (i ? "," : "")
+            << "{\"type\":\"" << (type < sizeof(types) / sizeof(types[0]) ? types[type] : "unknown") << '"'
+            << ",\"level\":" << cache.level
+            << ",\"size\":" << cache.size
+            << ",\"line\":" << cache.line
+            << ",\"associativity\":" << cache.associativity
+            << ",\"shared\":" << cache.shared << '}';
+    }
+    out << ']';
+}
+
+
+void writeTopologyJson(TextWriter& out, const CpuTopology& cpu) {
+    const auto& Topology = cpu.Topology;
+
+    out << "{\"fingerprint\":\"";
+    out.hex(cpu.fingerprint());
+    out << "\",\"name\":";
+    writeQuoted(out, cpu.name);
+    out << ",\"vendor\":";
+    writeQuoted(out, cpu.vendor);
+    out << ",\"family\":" << cpu.family
+        << ",\"model\":" << cpu.model
+        << ",\"isa\":[";
+    const char* separator = "";
+    for (uint32_t i = 0; i < static_cast<uint32_t>(IsaFeature::count); ++i) {
+        if (cpu.isa.has(static_cast<IsaFeature>(i))) {
+            out << separator << '"' << isaFeatureName(static_cast<IsaFeature>(i)) << '"';
+            separator = ",";
+        }
+    }
+    out << ']'
+        << ",\"socketCount\":" << cpu.sockets
+        << ",\"processorGroups\":" << cpu.processorGroups
+        << ",\"numaNodeCount\":" << cpu.numaNodes
+        << ",\"physicalCores\":" << cpu.physicalCores
+        << ",\"logicalProcessors\":" << cpu.logicalProcessors
+        << ",\"complexGroupCount\":" << cpu.complexGroups
+        << ",\"systemMemory\":" << cpu.systemMemory;
+
+    out << ",\"caches\":";
+    writeCaches(out, cpu.caches);
+
+    out << ",\"cores\":[";
+    for (size_t i = 0; i < Topology.cores.size(); ++i) {
+        const auto& core = Topology.cores[i];
+        out << (i ? "," : "") << "{\"id\":" << core.id << ",\"complexGroup\":";
+        writeId(out, core.complexGroup);
+        out << ",\"numaNode\":";
+        writeId(out, core.numaNode);
+        out << ",\"socket\":";
+        writeId(out, core.socket);
+        out << ",\"sysNumaNode\":" << core.sysNumaNode
+            << ",\"sysProcessorGroup\":" << core.sysProcessorGroup
+            << ",\"efficiencyClass\":" << core.efficiencyClass
+            << ",\"schedulingClass\":" << core.schedulingClass
+            << ",\"SMT\":" << (core.SMT ? "true" : "false")
+            << ",\"sysLogicalProcessors\":";
+        writeArray(out, core.sysLogicalProcessors);
+        out << ",\"caches\":";
+        writeCaches(out, core.caches);
+        out << '}';
+    }
+
+    out << "],\"complexGroups\":[";
+    for (size_t i = 0; i < Topology.complexGroups.size(); ++i) {
+        const auto& complexGroup = Topology.complexGroups[i];
+        out << (i ? "," : "") << "{\"id\":" << complexGroup.id << ",\"numaNode\":";
+        writeId(out, complexGroup.numaNode);
+        out << ",\"socket\":";
+        writeId(out, complexGroup.socket);
+        out << ",\"sysNumaNode\":" << complexGroup.sysNumaNode
+            << ",\"sysProcessorGroup\":" << complexGroup.sysProcessorGroup
+            << ",\"sysLogicalProcessors\":";
+        writeArray(out, complexGroup.sysLogicalProcessors);
+        out << ",\"cores\":";
+        writeIds(out, complexGroup.cores);
+        out << '}';
+    }
+
+    out << "],\"numaNodes\":[";
+    for (size_t i = 0; i < Topology.numaNodes.size(); ++i) {
+        const auto& numaNode = Topology.numaNodes[i];
+        out << (i ? "," : "") << "{\"id\":" << numaNode.id
+            << ",\"sysNumaNode\":" << numaNode.sysNumaNode << ",\"socket\":";
+        writeId(out, numaNode.socket);
+        out << ",\"sysProcessorGroup\":" << numaNode.sysProcessorGroup
+            << ",\"availableMemory\":" << numaNode.availableMemory
+            << ",\"sysLogicalProcessors\":";
+        writeArray(out, numaNode.sysLogicalProcessors);
+        out << ",\"cores\":";
+        writeIds(out, numaNode.cores);
+        out << ",\"complexGroups\":";
+        writeIds(out, numaNode.complexGroups);
+        out << '}';
+    }
+
+    out << "],\"sockets\":[";
+    for (size_t i = 0; i < Topology.sockets.size(); ++i) {
+        const auto& socket = Topology.sockets[i];
+        out << (i ? "," : "") << "{\"id\":" << socket.id << ",\"processorGroups\":[";
+        for (size_t j = 0; j < socket.processorsStructs.size(); ++j) {
+            const auto& processorStruct = socket.processorsStructs[j];
+            out << (j ? "," : "") << "{\"sysProcessorGroup\":" << processorStruct.sysProcessorGroup
+                << ",\"sysLogicalProcessors\":";
+            writeArray(out, processorStruct.sysLogicalProcessors);
+            out << '}';
+        }
+        out << "],\"cores\":";
+        writeIds(out, socket.cores);
+        out << ",\"complexGroups\":";
+        writeIds(out, socket.complexGroups);
+        out << ",\"numaNodes\":";
+        writeIds(out, socket.numaNodes);
+        out << ",\"sysNumaNodes\":";
+        writeArray(out, socket.sysNumaNodes);
+        out << '}';
+    }
+
+    out << "],\"memoryNodes\":[";
+    for (size_t i = 0; i < Topology.memoryNodes.size(); ++i) {
+        const auto& memoryNode = Topology.memoryNodes[i];
+        out << (i ? "," : "") << "{\"id\":" << memoryNode.id
+            << ",\"sysNumaNode\":" << memoryNode.sysNumaNode << ",\"numaNode\":";
+        writeId(out, memoryNode.numaNode);
+        out << ",\"nearestNumaNode\":";
+        writeId(out, memoryNode.nearestNumaNode);
+        out << ",\"memoryTier\":";
+        if (memoryNode.memoryTier != std::numeric_limits<uint32_t>::max()) {
+            out << memoryNode.memoryTier;
+        }
+        else {
+            out << "null";
+        }
+        out << ",\"totalMemory\":" << memoryNode.totalMemory
+            << ",\"availableMemory\":" << memoryNode.availableMemory
+            << ",\"readBandwidth\":" << memoryNode.readBandwidth
+            << ",\"writeBandwidth\":" << memoryNode.writeBandwidth
+            << ",\"readLatency\":" << memoryNode.readLatency
+            << ",\"writeLatency\":" << memoryNode.writeLatency
+            << ",\"initiators\":";
+        writeArray(out, memoryNode.initiators);
+        out << ",\"distances\":";
+        writeArray(out, memoryNode.distances);
+        out << ",\"hugePages\":[";
+        for (size_t j = 0; j < memoryNode.hugePages.size(); ++j) {
+            const auto& hugePage = memoryNode.hugePages[j];
+            out << (j ? "," : "") << "{\"size\":" << hugePage.size
+                << ",\"total\":" << hugePage.total << ",\"free\":" << hugePage.free << '}';
+        }
+        out << "]}";
+    }
+    out << ']';
+
+    // Row-major matrices, empty when not measured.
+    out << ",\"coreLatencies\":";
+    writeArray(out, Topology.coreLatencies);
+    out << ",\"numaDistances\":";
+    writeArray(out, Topology.numaDistances);
+    out << ",\"numaLatencies\":";
+    writeArray(out, Topology.numaLatencies);
+    out << ",\"numaReadBandwidths\":";
+    writeArray(out, Topology.numaReadBandwidths);
+    out << ",\"numaCopyBandwidths\":";
+    writeArray(out, Topology.numaCopyBandwidths);
+    out << "}\n";
+}
+
+
+void writeTopologyJson(std::ostream& out, const CpuTopology& cpu) {
+    TextWriter writer(out);
+    writeTopologyJson(writer, cpu);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+
+#include <ostream>
+
+#include "CpuTopology.h"
+#include "TextWriter.h"
+
+
+/* Write cpu as one JSON object, the same data as a snapshot.
+   Links between levels are written as ids, null links as null. The counts of levels written as arrays
+   are socketCount, numaNodeCount and complexGroupCount. */
+void writeTopologyJson(TextWriter& out, const CpuTopology& cpu);
+void writeTopologyJson(std::ostream& out, const CpuTopology& cpu);
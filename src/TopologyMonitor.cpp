@@ -0,0 +1,195 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
+#include "TopologyMonitor.h"
+
+
+// Processors the system has online and what the process may use, a refresh happens when any of them changes.
+struct SystemProcessors {
+    CpuSet online;
+    CpuTopology::ProcessLimits limits;
+};
+
+
+static SystemProcessors ReadSystemProcessors() {
+    SystemProcessors processors;
+#if defined(_WIN32)
+    auto groups = std::min<uint32_t>(GetActiveProcessorGroupCount(), CpuSet::words);
+    for (uint32_t group = 0; group < groups; ++group) {
+        auto count = GetActiveProcessorCount(static_cast<WORD>(group));
+        processors.online.bits[group] = count >= CpuSet::wordBits ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+    }
+#elif defined(__linux__)
+    // Same tree as CpuTopology::get(), a replayed capture never changes.
+    auto root = std::getenv("CPU_TOPOLOGY_ROOT");
+    std::ifstream file(std::string(root ? root : "") + "/sys/devices/system/cpu/online");
+    std::string list;
+    if (std::getline(file, list)) {
+        processors.online = CpuSet::fromList(list.c_str());
+    }
+#endif
+    processors.limits = CpuTopology::processLimits();
+    return processors;
+}
+
+
+struct TopologyMonitor::State {
+    // Serializes refreshes and their notifications.
+    std::mutex refreshLock;
+    std::atomic<std::thread::id> notifyingThread{ std::thread::id() };
+    bool initialized = false;
+    SystemProcessors last;
+    // Owns every publication, see the class comment.
+    std::vector<std::unique_ptr<const Topologies>> topologies;
+
+    std::mutex subscribersLock;
+    std::vector<std::pair<uint64_t, std::shared_ptr<Callback>>> subscribers;
+    uint64_t nextID = 1;
+
+    std::mutex threadLock;
+    std::condition_variable wake;
+    std::chrono::milliseconds interval{ 1000 };
+    bool stopping = false;
+    // Claimed by the start() that creates the thread, a concurrent start() only updates the interval.
+    bool starting = false;
+    std::thread thread;
+
+    ~State() {
+        stop();
+        // Readers during static destruction fall back to get().
+        published.store(nullptr, std::memory_order_release);
+    }
+};
+
+
+TopologyMonitor::State& TopologyMonitor::state() {
+    static State instance;
+    return instance;
+}
+
+
+void TopologyMonitor::start(std::chrono::milliseconds interval) {
+    auto& s = state();
+    {
+        std::lock_guard<std::mutex> guard(s.threadLock);
+        s.interval = interval;
+        if (s.thread.joinable() || s.starting) {
+            s.wake.notify_all();
+            return;
+        }
+        s.stopping = false;
+        s.starting = true;
+    }
+
+    // Take the baseline now so the first poll compares against the system at start().
+    refresh();
+
+    std::lock_guard<std::mutex> guard(s.threadLock);
+    s.starting = false;
+    // stop() ran meanwhile.
+    if (s.stopping) {
+        return;
+    }
+    s.thread = std::thread([&s]() {
+        std::unique_lock<std::mutex> lock(s.threadLock);
+        while (!s.wake.wait_for(lock, s.interval, [&s]() { return s.stopping; })) {
+            lock.unlock();
+            refresh();
+            lock.lock();
+        }
+    });
+}
+
+
+void TopologyMonitor::stop() {
+    auto& s = state();
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> guard(s.threadLock);
+        s.stopping = true;
+        thread = std::move(s.thread);
+    }
+    s.wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+
+bool TopologyMonitor::refresh() {
+    auto& s = state();
+    std::lock_guard<std::mutex> guard(s.refreshLock);
+
+    auto processors = ReadSystemProcessors();
+    if (!s.initialized) {
+        s.last.online = current().Topology.cpuSet;
+        s.last.limits = processors.limits;
+        s.initialized = true;
+    }
+    if (processors.online == s.last.online && processors.limits.allowed == s.last.limits.allowed &&
+        processors.limits.cpuQuota == s.last.limits.cpuQuota) {
+        return false;
+    }
+    s.last = processors;
+
+    const auto& previous = current();
+    auto topologies = std::make_unique<Topologies>();
+    topologies->machine.reset(new CpuTopology());
+    topologies->process.reset(new CpuTopology(*topologies->machine, processors.limits));
+    const auto& next = *topologies->machine;
+    s.topologies.push_back(std::move(topologies));
+    published.store(s.topologies.back().get(), std::memory_order_release);
+    generations.fetch_add(1, std::memory_order_release);
+
+    // Callbacks run outside subscribersLock so they may subscribe and unsubscribe.
+    std::vector<std::pair<uint64_t, std::shared_ptr<Callback>>> subscribers;
+    {
+        std::lock_guard<std::mutex> subscribersGuard(s.subscribersLock);
+        subscribers = s.subscribers;
+    }
+    s.notifyingThread.store(std::this_thread::get_id());
+    for (const auto& subscriber : subscribers) {
+        (*subscriber.second)(previous, next);
+    }
+    s.notifyingThread.store(std::thread::id());
+    return true;
+}
+
+
+uint64_t TopologyMonitor::subscribe(Callback callback) {
+    auto& s = state();
+    std::lock_guard<std::mutex> guard(s.subscribersLock);
+    auto id = s.nextID++;
+    s.subscribers.emplace_back(id, std::make_shared<Callback>(std::move(callback)));
+    return id;
+}
+
+
+void TopologyMonitor::unsubscribe(uint64_t id) {
+    auto& s = state();
+    {
+        std::lock_guard<std::mutex> guard(s.subscribersLock);
+        s.subscribers.erase(std::remove_if(s.subscribers.begin(), s.subscribers.end(),
+            [id](const auto& subscriber) { return subscriber.first == id; }), s.subscribers.end());
+    }
+    // Wait out a notification in flight unless it is the one calling us.
+    if (s.notifyingThread.load() != std::this_thread::get_id()) {
+        std::lock_guard<std::mutex> guard(s.refreshLock);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "CpuTopology.h"
+
+
+/* Opt-in live refresh of the topology.
+   A background thread polls the online processors and CpuTopology::processLimits() (hot-plug, cgroup
+   cpuset or quota resizes, SMT toggles) and rebuilds the topology when any of them changed. The new topology is published
+   RCU-style: readers take an immutable CpuTopology with a single atomic load and never lock.
+   Published topologies are never freed while the process runs, a reference from current() stays valid,
+   refreshes only follow hardware or cgroup changes so the retained memory stays small. */
+class TopologyMonitor {
+public:
+    /* previous is the topology replaced by next, both stay valid after the callback returns.
+       currentProcess() already returns the process view of next. */
+    using Callback = std::function<void(const CpuTopology& previous, const CpuTopology& next)>;
+
+    /* Latest published topology, CpuTopology::get() until a refresh published another one. */
+    static const CpuTopology& current() {
+        auto topologies = published.load(std::memory_order_acquire);
+        return topologies ? *topologies->machine : CpuTopology::get();
+    }
+
+    /* Process view of current(), CpuTopology::process() until a refresh published another one. */
+    static const CpuTopology& currentProcess() {
+        auto topologies = published.load(std::memory_order_acquire);
+        return topologies ? *topologies->process : CpuTopology::process();
+    }
+
+    /* Number of topologies published by refreshes so far. */
+    static uint64_t generation() { return generations.load(std::memory_order_acquire); }
+
+    /* Poll every interval on a background thread, calling start() again only changes the interval. */
+    static void start(std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+
+    /* Stop the background thread, current() keeps returning the last published topology. */
+    static void stop();
+
+    /* Check now on the calling thread, returns true if a new topology was published. */
+    static bool refresh();
+
+    /* Call callback on the refreshing thread after each publication, returns an id for unsubscribe().
+       Callbacks may subscribe and unsubscribe but must not call refresh() or stop(). */
+    static uint64_t subscribe(Callback callback);
+
+    /* Remove a callback, a notification already running on another thread is waited for. */
+    static void unsubscribe(uint64_t id);
+
+private:
+    struct State;
+    static State& state();
+
+    /* One publication, the machine topology and its process view. */
+    struct Topologies {
+        std::unique_ptr<const CpuTopology> machine;
+        std::unique_ptr<const CpuTopology> process;
+    };
+
+    static inline std::atomic<const Topologies*> published{ nullptr };
+    static inline std::atomic<uint64_t> generations{ 0 };
+};
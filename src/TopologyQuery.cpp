@@ -0,0 +1,150 @@
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+
+#include "Placement.h"
+#include "TopologyQuery.h"
+
+
+using NumaNodeInfo = CpuTopology::TopologyInfo::NumaNodeInfo;
+
+
+constexpr uint32_t unknown = std::numeric_limits<uint32_t>::max();
+
+
+// Id after "prefix:" in scope, false if scope has another prefix or no number.
+static bool scopeId(const std::string& scope, const char* prefix, uint32_t& id) {
+    const auto length = std::char_traits<char>::length(prefix);
+    if (scope.compare(0, length, prefix) != 0 || scope.size() <= length + 1 || scope[length] != ':') {
+        return false;
+    }
+    char* end = nullptr;
+    auto value = std::strtoul(scope.c_str() + length + 1, &end, 10);
+    if (*end != '\0' || value >= unknown) {
+        return false;
+    }
+    id = static_cast<uint32_t>(value);
+    return true;
+}
+
+
+// CpuSet of element id of levels, false if there is none.
+template <typename T>
+static bool levelCpuSet(const std::vector<T>& levels, uint32_t id, CpuSet& set) {
+    if (id >= levels.size()) {
+        return false;
+    }
+    set = levels[id].cpuSet;
+    return true;
+}
+
+
+bool scopeCpuSet(const CpuTopology& cpu, const std::string& scope, CpuSet& set) {
+    const auto& Topology = cpu.Topology;
+    uint32_t id = 0;
+    if (scope == "machine") {
+        set = Topology.cpuSet;
+        return true;
+    }
+    if (scope == "latency-critical") {
+        set = latencyCriticalProcessors(cpu);
+        return true;
+    }
+    if (scope == "background") {
+        set = backgroundProcessors(cpu);
+        return true;
+    }
+    if (scopeId(scope, "socket", id)) {
+        return levelCpuSet(Topology.sockets, id, set);
+    }
+    if (scopeId(scope, "numa", id)) {
+        return levelCpuSet(Topology.numaNodes, id, set);
+    }
+    if (scopeId(scope, "complex", id)) {
+        return levelCpuSet(Topology.complexGroups, id, set);
+    }
+    if (scopeId(scope, "core", id)) {
+        return levelCpuSet(Topology.cores, id, set);
+    }
+    if (scopeId(scope, "pu", id)) {
+        set.clear();
+        set.set(id);
+        set &= Topology.cpuSet;
+        return !set.empty();
+    }
+    if (scope.compare(0, 7, "device:") == 0) {
+        uint32_t sysNumaNode = unknown;
+        if (!deviceNumaNode(scope.substr(7), sysNumaNode)) {
+            return false;
+        }
+        auto numaNode = sysNumaNode == unknown && Topology.numaNodes.size() == 1 ?
+            &Topology.numaNodes.front() : nearestNumaNode(cpu, sysNumaNode);
+        if (!numaNode) {
+            return false;
+        }
+        set = numaNode->cpuSet;
+        return true;
+    }
+    return false;
+}
+
+
+bool deviceNumaNode(const std::string& device, uint32_t& sysNumaNode) {
+    sysNumaNode = unknown;
+#if defined(__linux__)
+    if (device.empty()) {
+        return false;
+    }
+    auto root = std::getenv("CPU_TOPOLOGY_ROOT");
+    const std::string prefix = root ? root : "";
+    std::vector<std::string> paths;
+    if (device.find('/') != std::string::npos) {
+        paths.push_back(device);
+    }
+    else {
+        paths.push_back(prefix + "/sys/bus/pci/devices/" + device);
+        paths.push_back(prefix + "/sys/class/net/" + device + "/device");
+        paths.push_back(prefix + "/sys/class/infiniband/" + device + "/device");
+        paths.push_back(prefix + "/sys/class/nvme/" + device + "/device");
+        paths.push_back(prefix + "/sys/block/" + device + "/device");
+    }
+    // Class devices link to their bus device, which has numa_node, some block devices sit one level further down.
+    for (const auto& path : paths) {
+        for (const char* file : { "/numa_node", "/device/numa_node" }) {
+            std::ifstream stream(path + file);
+            long node = -1;
+            if (stream >> node) {
+                sysNumaNode = node >= 0 ? static_cast<uint32_t>(node) : unknown;
+                return true;
+            }
+        }
+    }
+#else
+    (void)device;
+#endif
+    return false;
+}
+
+
+const NumaNodeInfo* nearestNumaNode(const CpuTopology& cpu, uint32_t sysNumaNode) {
+    const auto& Topology = cpu.Topology;
+    for (const auto& numaNode : Topology.numaNodes) {
+        if (numaNode.sysNumaNode == sysNumaNode) {
+            return &numaNode;
+        }
+    }
+    // CPU-less memory, or a node the process view dropped: its memory node knows the nearest kept one.
+    auto memoryNode = Topology.memoryNode(sysNumaNode);
+    return memoryNode ? memoryNode->nearestNumaNode : nullptr;
+}
+
+
+std::vector<uint32_t> coresOf(const CpuTopology& cpu, const CpuSet& set) {
+    std::vector<uint32_t> cores;
+    for (const auto& core : cpu.Topology.cores) {
+        if (core.cpuSet.intersects(set)) {
+            cores.push_back(core.id);
+        }
+    }
+    return cores;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CpuTopology.h"
+
+
+/* Logical processors of a scope named on the command line:
+   "machine", "socket:N", "numa:N", "complex:N" and "core:N" with TopologyInfo ids, "pu:N" with a CpuSet index,
+   "device:X" for the NUMA node with processors nearest to device X (see deviceNumaNode()), the only node
+   if the device has none and the host has one,
+   "latency-critical" and "background" as latencyCriticalProcessors() and backgroundProcessors() choose them.
+   Returns false for an unknown scope, a missing id or a device without a NUMA node. */
+bool scopeCpuSet(const CpuTopology& cpu, const std::string& scope, CpuSet& set);
+
+/* System NUMA node of a device: a PCI address such as "0000:3b:00.0", a network interface, an InfiniBand or
+   NVMe device, a block device, or a sysfs path. Read under CPU_TOPOLOGY_ROOT like the topology.
+   Returns false if the device is not found, always on Windows. sysNumaNode is max uint32_t when the kernel
+   does not know the node of the device, as on hosts without NUMA information in firmware. */
+bool deviceNumaNode(const std::string& device, uint32_t& sysNumaNode);
+
+/* The NUMA node of sysNumaNode if cpu has it, else MemoryNodeInfo::nearestNumaNode of the node,
+   e.g. for CXL or HBM memory without processors or a node outside the process view.
+   Null if cpu knows neither. */
+const CpuTopology::TopologyInfo::NumaNodeInfo* nearestNumaNode(const CpuTopology& cpu, uint32_t sysNumaNode);
+
+/* Ids of the cores with a logical processor in set. */
+std::vector<uint32_t> coresOf(const CpuTopology& cpu, const CpuSet& set);
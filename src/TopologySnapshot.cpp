@@ -0,0 +1,544 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MeasurementCache.h"
+#include "TopologySnapshot.h"
+
+
+// Logical id written for a null pointer.
+constexpr uint32_t snapshotNone = std::numeric_limits<uint32_t>::max();
+
+// Sections start on a cache line.
+constexpr uint64_t snapshotAlignment = 64;
+
+
+// Record size of a section, what SnapshotWriter::add stores as its elementSize.
+static uint32_t sectionElementSize(SnapshotSection section) {
+    switch (section) {
+    case SnapshotSection::cores: return sizeof(SnapshotCore);
+    case SnapshotSection::complexGroups: return sizeof(SnapshotComplexGroup);
+    case SnapshotSection::numaNodes: return sizeof(SnapshotNumaNode);
+    case SnapshotSection::sockets: return sizeof(SnapshotSocket);
+    case SnapshotSection::socketProcessors: return sizeof(SnapshotSocketProcessors);
+    case SnapshotSection::indices: return sizeof(uint32_t);
+    case SnapshotSection::coreCaches: return sizeof(SnapshotCache);
+    case SnapshotSection::systemCaches: return sizeof(SnapshotCache);
+    case SnapshotSection::coreLatencies: return sizeof(float);
+    case SnapshotSection::numaDistances: return sizeof(uint32_t);
+    case SnapshotSection::numaLatencies: return sizeof(float);
+    case SnapshotSection::numaReadBandwidths: return sizeof(float);
+    case SnapshotSection::numaCopyBandwidths: return sizeof(float);
+    case SnapshotSection::memoryNodes: return sizeof(SnapshotMemoryNode);
+    case SnapshotSection::hugePages: return sizeof(SnapshotHugePages);
+    default: return 0;
+    }
+}
+
+
+// Accumulates the sections of a snapshot before they are laid out behind the header.
+struct SnapshotWriter {
+    std::vector<char> sections[static_cast<size_t>(SnapshotSection::count)];
+    SnapshotArray entries[static_cast<size_t>(SnapshotSection::count)];
+    std::vector<uint32_t> indices;
+
+    template <typename T>
+    void add(SnapshotSection section, const T& value) {
+        auto& bytes = sections[static_cast<size_t>(section)];
+        auto& entry = entries[static_cast<size_t>(section)];
+        bytes.insert(bytes.end(), reinterpret_cast<const char*>(&value), reinterpret_cast<const char*>(&value) + sizeof(T));
+        entry.elementSize = sizeof(T);
+        ++entry.count;
+    }
+
+    template <typename T>
+    void addAll(SnapshotSection section, const std::vector<T>& values) {
+        for (const auto& value : values) {
+            add(section, value);
+        }
+    }
+
+    SnapshotList list(const std::vector<uint32_t>& values) {
+        SnapshotList result = { static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(values.size()) };
+        indices.insert(indices.end(), values.cbegin(), values.cend());
+        return result;
+    }
+
+    template <typename T>
+    SnapshotList ids(const std::vector<T*>& pointers) {
+        SnapshotList result = { static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(pointers.size()) };
+        for (auto pointer : pointers) {
+            indices.push_back(pointer->id);
+        }
+        return result;
+    }
+
+    template <typename T>
+    static uint32_t id(const T* pointer) {
+        return pointer ? pointer->id : snapshotNone;
+    }
+
+    static SnapshotCache cache(const CpuTopology::CacheInfo& info) {
+        return { static_cast<uint32_t>(info.type), info.level, info.associativity, info.size, info.line, info.shared };
+    }
+};
+
+
+bool saveSnapshot(const std::string& path, const CpuTopology& cpu) {
+    const auto& Topology = cpu.Topology;
+    SnapshotWriter writer;
+
+    for (const auto& core : Topology.cores) {
+        SnapshotCore record;
+        record.id = core.id;
+        record.complexGroup = SnapshotWriter::id(core.complexGroup);
+        record.numaNode = SnapshotWriter::id(core.numaNode);
+        record.socket = SnapshotWriter::id(core.socket);
+        record.sysNumaNode = core.sysNumaNode;
+        record.sysProcessorGroup = core.sysProcessorGroup;
+        record.efficiencyClass = core.efficiencyClass;
+        record.schedulingClass = core.schedulingClass;
+        record.SMT = core.SMT;
+        record.sysLogicalProcessors = writer.list(core.sysLogicalProcessors);
+        record.caches = { writer.entries[static_cast<size_t>(SnapshotSection::coreCaches)].count, static_cast<uint32_t>(core.caches.size()) };
+        for (const auto& cache : core.caches) {
+            writer.add(SnapshotSection::coreCaches, SnapshotWriter::cache(cache));
+        }
+        writer.add(SnapshotSection::cores, record);
+    }
+
+    for (const auto& complexGroup : Topology.complexGroups) {
+        SnapshotComplexGroup record;
+        record.id = complexGroup.id;
+        record.numaNode = SnapshotWriter::id(complexGroup.numaNode);
+        record.socket = SnapshotWriter::id(complexGroup.socket);
+        record.sysNumaNode = complexGroup.sysNumaNode;
+        record.sysProcessorGroup = complexGroup.sysProcessorGroup;
+        record.sysLogicalProcessors = writer.list(complexGroup.sysLogicalProcessors);
+        record.cores = writer.ids(complexGroup.cores);
+        writer.add(SnapshotSection::complexGroups, record);
+    }
+
+    for (const auto& numaNode : Topology.numaNodes) {
+        SnapshotNumaNode record;
+        record.id = numaNode.id;
+        record.sysNumaNode = numaNode.sysNumaNode;
+        record.socket = SnapshotWriter::id(numaNode.socket);
+        record.sysProcessorGroup = numaNode.sysProcessorGroup;
+        record.availableMemory = numaNode.availableMemory;
+        record.sysLogicalProcessors = writer.list(numaNode.sysLogicalProcessors);
+        record.cores = writer.ids(numaNode.cores);
+        record.complexGroups = writer.ids(numaNode.complexGroups);
+        writer.add(SnapshotSection::numaNodes, record);
+    }
+
+    for (const auto& socket : Topology.sockets) {
+        SnapshotSocket record;
+        record.id = socket.id;
+        record.processorsStructs = { writer.entries[static_cast<size_t>(SnapshotSection::socketProcessors)].count, static_cast<uint32_t>(socket.processorsStructs.size()) };
+        for (const auto& processorStruct : socket.processorsStructs) {
+            SnapshotSocketProcessors processors;
+            processors.sysProcessorGroup = processorStruct.sysProcessorGroup;
+            processors.sysLogicalProcessors = writer.list(processorStruct.sysLogicalProcessors);
+            writer.add(SnapshotSection::socketProcessors, processors);
+        }
+        record.cores = writer.ids(socket.cores);
+        record.complexGroups = writer.ids(socket.complexGroups);
+        record.numaNodes = writer.ids(socket.numaNodes);
+        record.sysNumaNodes = writer.list(socket.sysNumaNodes);
+        writer.add(SnapshotSection::sockets, record);
+    }
+
+    for (const auto& memoryNode : Topology.memoryNodes) {
+        SnapshotMemoryNode record;
+        record.id = memoryNode.id;
+        record.sysNumaNode = memoryNode.sysNumaNode;
+        record.numaNode = SnapshotWriter::id(memoryNode.numaNode);
+        record.nearestNumaNode = SnapshotWriter::id(memoryNode.nearestNumaNode);
+        record.memoryTier = memoryNode.memoryTier;
+        record.readBandwidth = memoryNode.readBandwidth;
+        record.writeBandwidth = memoryNode.writeBandwidth;
+        record.readLatency = memoryNode.readLatency;
+        record.writeLatency = memoryNode.writeLatency;
+        record.totalMemory = memoryNode.totalMemory;
+        record.availableMemory = memoryNode.availableMemory;
+        record.initiators = writer.list(memoryNode.initiators);
+        record.distances = writer.list(memoryNode.distances);
+        record.hugePages = { writer.entries[static_cast<size_t>(SnapshotSection::hugePages)].count, static_cast<uint32_t>(memoryNode.hugePages.size()) };
+        for (const auto& hugePage : memoryNode.hugePages) {
+            writer.add(SnapshotSection::hugePages, SnapshotHugePages{ hugePage.size, hugePage.total, hugePage.free });
+        }
+        writer.add(SnapshotSection::memoryNodes, record);
+    }
+
+    for (const auto& cache : cpu.caches) {
+        writer.add(SnapshotSection::systemCaches, SnapshotWriter::cache(cache));
+    }
+    writer.addAll(SnapshotSection::coreLatencies, Topology.coreLatencies);
+    writer.addAll(SnapshotSection::numaDistances, Topology.numaDistances);
+    writer.addAll(SnapshotSection::numaLatencies, Topology.numaLatencies);
+    writer.addAll(SnapshotSection::numaReadBandwidths, Topology.numaReadBandwidths);
+    writer.addAll(SnapshotSection::numaCopyBandwidths, Topology.numaCopyBandwidths);
+    writer.addAll(SnapshotSection::indices, writer.indices);
+
+    SnapshotHeader header;
+    header.fingerprint = cpu.fingerprint();
+    header.sockets = cpu.sockets;
+    header.processorGroups = cpu.processorGroups;
+    header.numaNodes = cpu.numaNodes;
+    header.physicalCores = cpu.physicalCores;
+    header.logicalProcessors = cpu.logicalProcessors;
+    header.complexGroups = cpu.complexGroups;
+    header.family = cpu.family;
+    header.model = cpu.model;
+    header.systemMemory = cpu.systemMemory;
+    std::memcpy(header.name, cpu.name.data(), std::min(cpu.name.size(), sizeof(header.name) - 1));
+    std::memcpy(header.vendor, cpu.vendor.data(), std::min(cpu.vendor.size(), sizeof(header.vendor) - 1));
+
+    // Lay the sections out behind the header.
+    auto offset = (sizeof(SnapshotHeader) + snapshotAlignment - 1) / snapshotAlignment * snapshotAlignment;
+    for (size_t i = 0; i < static_cast<size_t>(SnapshotSection::count); ++i) {
+        header.sections[i] = writer.entries[i];
+        header.sections[i].offset = offset;
+        offset += (writer.sections[i].size() + snapshotAlignment - 1) / snapshotAlignment * snapshotAlignment;
+    }
+    header.fileSize = offset;
+
+    std::vector<char> image(header.fileSize, 0);
+    std::memcpy(image.data(), &header, sizeof(header));
+    for (size_t i = 0; i < static_cast<size_t>(SnapshotSection::count); ++i) {
+        std::copy(writer.sections[i].cbegin(), writer.sections[i].cend(), image.begin() + header.sections[i].offset);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    auto temporary = path + ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(image.data(), image.size());
+        if (!file) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+
+bool TopologySnapshot::open(const std::string& path) {
+    close();
+
+#if defined(_WIN32)
+    auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize = {};
+    GetFileSizeEx(file, &fileSize);
+    auto mapping = fileSize.QuadPart ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+    auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) {
+        return false;
+    }
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status = {};
+    if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    auto view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(status.st_size);
+#endif
+
+    SnapshotHeader expected;
+    bool valid = size >= sizeof(SnapshotHeader);
+    if (valid) {
+        const auto& snapshot = header();
+        valid = std::memcmp(snapshot.magic, expected.magic, sizeof(expected.magic)) == 0 &&
+            snapshot.version == expected.version &&
+            snapshot.headerSize == expected.headerSize &&
+            snapshot.fileSize == size;
+        for (size_t i = 0; i < static_cast<size_t>(SnapshotSection::count); ++i) {
+            const auto& section = snapshot.sections[i];
+            valid = valid && section.offset % snapshotAlignment == 0 &&
+                (section.count == 0 || section.elementSize == sectionElementSize(static_cast<SnapshotSection>(i))) &&
+                section.offset + static_cast<uint64_t>(section.count) * section.elementSize <= size;
+        }
+    }
+    if (!valid) {
+        close();
+    }
+    return valid;
+}
+
+
+void TopologySnapshot::close() {
+    if (data) {
+#if defined(_WIN32)
+        UnmapViewOfFile(data);
+#else
+        munmap(const_cast<char*>(data), size);
+#endif
+    }
+    data = nullptr;
+    size = 0;
+}
+
+
+bool loadSnapshot(const TopologySnapshot& snapshot, CpuTopology& cpu) {
+    if (!snapshot.valid()) {
+        return false;
+    }
+    const auto& header = snapshot.header();
+    auto& Topology = cpu.Topology;
+
+    const auto cores = snapshot.count(SnapshotSection::cores);
+    const auto complexGroups = snapshot.count(SnapshotSection::complexGroups);
+    const auto numaNodes = snapshot.count(SnapshotSection::numaNodes);
+    const auto sockets = snapshot.count(SnapshotSection::sockets);
+    const auto indexCount = snapshot.count(SnapshotSection::indices);
+    const auto coreCacheCount = snapshot.count(SnapshotSection::coreCaches);
+    const auto socketProcessorCount = snapshot.count(SnapshotSection::socketProcessors);
+    const auto memoryNodes = snapshot.count(SnapshotSection::memoryNodes);
+    const auto hugePageCount = snapshot.count(SnapshotSection::hugePages);
+
+    auto coreRecords = snapshot.array<SnapshotCore>(SnapshotSection::cores);
+    auto complexGroupRecords = snapshot.array<SnapshotComplexGroup>(SnapshotSection::complexGroups);
+    auto numaNodeRecords = snapshot.array<SnapshotNumaNode>(SnapshotSection::numaNodes);
+    auto socketRecords = snapshot.array<SnapshotSocket>(SnapshotSection::sockets);
+    auto socketProcessors = snapshot.array<SnapshotSocketProcessors>(SnapshotSection::socketProcessors);
+    auto coreCaches = snapshot.array<SnapshotCache>(SnapshotSection::coreCaches);
+    auto memoryNodeRecords = snapshot.array<SnapshotMemoryNode>(SnapshotSection::memoryNodes);
+    auto hugePages = snapshot.array<SnapshotHugePages>(SnapshotSection::hugePages);
+    auto indices = snapshot.array<uint32_t>(SnapshotSection::indices);
+    if ((cores && !coreRecords) || (complexGroups && !complexGroupRecords) ||
+        (numaNodes && !numaNodeRecords) || (sockets && !socketRecords) || (memoryNodes && !memoryNodeRecords) ||
+        (socketProcessorCount && !socketProcessors) || (coreCacheCount && !coreCaches) ||
+        (hugePageCount && !hugePages) || (indexCount && !indices)) {
+        return false;
+    }
+
+    // Every list is checked before use, a corrupt file must not index out of the mapping.
+    bool valid = true;
+    auto inRange = [&](const SnapshotList& list, uint32_t count) {
+        valid = valid && static_cast<uint64_t>(list.offset) + list.count <= count;
+        return valid;
+    };
+    auto values = [&](const SnapshotList& list) {
+        std::vector<uint32_t> result;
+        if (inRange(list, indexCount) && list.count) {
+            result.assign(snapshot.list(list), snapshot.list(list) + list.count);
+        }
+        return result;
+    };
+    auto pointers = [&](const SnapshotList& list, auto& targets) {
+        std::vector<typename std::remove_reference_t<decltype(targets)>::value_type*> result;
+        for (auto id : values(list)) {
+            valid = valid && id < targets.size();
+            if (valid) {
+                result.push_back(&targets[id]);
+            }
+        }
+        return result;
+    };
+    auto pointer = [&](uint32_t id, auto& targets) {
+        valid = valid && (id == snapshotNone || id < targets.size());
+        return valid && id != snapshotNone ? &targets[id] : nullptr;
+    };
+    auto cache = [](const SnapshotCache& record) {
+        CpuTopology::CacheInfo info;
+        info.type = static_cast<CpuTopology::CacheType>(record.type);
+        info.level = record.level;
+        info.associativity = record.associativity;
+        info.size = record.size;
+        info.line = record.line;
+        info.shared = record.shared;
+        return info;
+    };
+
+    // Size every level first, the pointers below must not move.
+    Topology.cores.assign(cores, {});
+    Topology.complexGroups.assign(complexGroups, {});
+    Topology.numaNodes.assign(numaNodes, {});
+    Topology.sockets.assign(sockets, {});
+    Topology.memoryNodes.assign(memoryNodes, {});
+
+    for (uint32_t i = 0; i < cores; ++i) {
+        const auto& record = coreRecords[i];
+        auto& core = Topology.cores[i];
+        core.id = record.id;
+        core.complexGroup = pointer(record.complexGroup, Topology.complexGroups);
+        core.numaNode = pointer(record.numaNode, Topology.numaNodes);
+        core.socket = pointer(record.socket, Topology.sockets);
+        core.sysNumaNode = record.sysNumaNode;
+        core.sysProcessorGroup = record.sysProcessorGroup;
+        core.efficiencyClass = record.efficiencyClass;
+        core.schedulingClass = record.schedulingClass;
+        core.SMT = record.SMT != 0;
+        core.sysLogicalProcessors = values(record.sysLogicalProcessors);
+        if (inRange(record.caches, coreCacheCount)) {
+            for (uint32_t j = 0; j < record.caches.count; ++j) {
+                core.caches.push_back(cache(coreCaches[record.caches.offset + j]));
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < complexGroups; ++i) {
+        const auto& record = complexGroupRecords[i];
+        auto& complexGroup = Topology.complexGroups[i];
+        complexGroup.id = record.id;
+        complexGroup.numaNode = pointer(record.numaNode, Topology.numaNodes);
+        complexGroup.socket = pointer(record.socket, Topology.sockets);
+        complexGroup.sysNumaNode = record.sysNumaNode;
+        complexGroup.sysProcessorGroup = record.sysProcessorGroup;
+        complexGroup.sysLogicalProcessors = values(record.sysLogicalProcessors);
+        complexGroup.cores = pointers(record.cores, Topology.cores);
+    }
+
+    for (uint32_t i = 0; i < numaNodes; ++i) {
+        const auto& record = numaNodeRecords[i];
+        auto& numaNode = Topology.numaNodes[i];
+        numaNode.id = record.id;
+        numaNode.sysNumaNode = record.sysNumaNode;
+        numaNode.socket = pointer(record.socket, Topology.sockets);
+        numaNode.sysProcessorGroup = record.sysProcessorGroup;
+        numaNode.availableMemory = record.availableMemory;
+        numaNode.sysLogicalProcessors = values(record.sysLogicalProcessors);
+        numaNode.cores = pointers(record.cores, Topology.cores);
+        numaNode.complexGroups = pointers(record.complexGroups, Topology.complexGroups);
+    }
+
+    for (uint32_t i = 0; i < sockets; ++i) {
+        const auto& record = socketRecords[i];
+        auto& socket = Topology.sockets[i];
+        socket.id = record.id;
+        if (inRange(record.processorsStructs, socketProcessorCount)) {
+            for (uint32_t j = 0; j < record.processorsStructs.count; ++j) {
+                const auto& processors = socketProcessors[record.processorsStructs.offset + j];
+                CpuTopology::TopologyInfo::SocketInfo::SocketProcessors processorStruct;
+                processorStruct.sysProcessorGroup = processors.sysProcessorGroup;
+                processorStruct.sysLogicalProcessors = values(processors.sysLogicalProcessors);
+                socket.processorsStructs.push_back(std::move(processorStruct));
+            }
+        }
+        socket.cores = pointers(record.cores, Topology.cores);
+        socket.complexGroups = pointers(record.complexGroups, Topology.complexGroups);
+        socket.numaNodes = pointers(record.numaNodes, Topology.numaNodes);
+        socket.sysNumaNodes = values(record.sysNumaNodes);
+    }
+
+    for (uint32_t i = 0; i < memoryNodes; ++i) {
+        const auto& record = memoryNodeRecords[i];
+        auto& memoryNode = Topology.memoryNodes[i];
+        memoryNode.id = record.id;
+        memoryNode.sysNumaNode = record.sysNumaNode;
+        memoryNode.numaNode = pointer(record.numaNode, Topology.numaNodes);
+        memoryNode.nearestNumaNode = pointer(record.nearestNumaNode, Topology.numaNodes);
+        memoryNode.memoryTier = record.memoryTier;
+        memoryNode.readBandwidth = record.readBandwidth;
+        memoryNode.writeBandwidth = record.writeBandwidth;
+        memoryNode.readLatency = record.readLatency;
+        memoryNode.writeLatency = record.writeLatency;
+        memoryNode.totalMemory = record.totalMemory;
+        memoryNode.availableMemory = record.availableMemory;
+        memoryNode.initiators = values(record.initiators);
+        memoryNode.distances = values(record.distances);
+        if (inRange(record.hugePages, hugePageCount)) {
+            for (uint32_t j = 0; j < record.hugePages.count; ++j) {
+                const auto& pages = hugePages[record.hugePages.offset + j];
+                memoryNode.hugePages.push_back({ pages.size, pages.total, pages.free });
+            }
+        }
+    }
+
+    auto copy = [&](SnapshotSection section, auto& target) {
+        using T = typename std::remove_reference_t<decltype(target)>::value_type;
+        auto first = snapshot.array<T>(section);
+        target.assign(first, first ? first + snapshot.count(section) : first);
+    };
+    // Matrices are indexed by two ids, one of another size would be read out of bounds.
+    auto square = [&](const auto& matrix, uint64_t count) {
+        valid = valid && (matrix.empty() || matrix.size() == count * count);
+    };
+    copy(SnapshotSection::coreLatencies, Topology.coreLatencies);
+    copy(SnapshotSection::numaDistances, Topology.numaDistances);
+    copy(SnapshotSection::numaLatencies, Topology.numaLatencies);
+    copy(SnapshotSection::numaReadBandwidths, Topology.numaReadBandwidths);
+    copy(SnapshotSection::numaCopyBandwidths, Topology.numaCopyBandwidths);
+    square(Topology.coreLatencies, cores);
+    square(Topology.numaDistances, numaNodes);
+    square(Topology.numaLatencies, numaNodes);
+    square(Topology.numaReadBandwidths, numaNodes);
+    square(Topology.numaCopyBandwidths, numaNodes);
+
+    // A corrupt list leaves nothing behind, the caller falls back to discovery.
+    if (!valid) {
+        Topology = CpuTopology::TopologyInfo();
+        return false;
+    }
+
+    cpu.caches.clear();
+    if (auto systemCaches = snapshot.array<SnapshotCache>(SnapshotSection::systemCaches)) {
+        for (uint32_t i = 0; i < snapshot.count(SnapshotSection::systemCaches); ++i) {
+            cpu.caches.push_back(cache(systemCaches[i]));
+        }
+    }
+
+    // Counts follow the sections actually loaded, callers size their loops and matrix indexing by them.
+    cpu.sockets = sockets;
+    cpu.processorGroups = header.processorGroups;
+    cpu.numaNodes = numaNodes;
+    cpu.physicalCores = cores;
+    cpu.logicalProcessors = header.logicalProcessors;
+    cpu.complexGroups = complexGroups;
+    cpu.complexGroupSizes.clear();
+    for (const auto& complexGroup : Topology.complexGroups) {
+        cpu.complexGroupSizes.push_back(static_cast<uint32_t>(complexGroup.cores.size()));
+    }
+    cpu.systemMemory = header.systemMemory;
+    return true;
+}
+
+
+std::string snapshotCachePath(const CpuTopology& cpu) {
+    return measurementCachePath(cpu, "topology");
+}
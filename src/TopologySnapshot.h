@@ -0,0 +1,225 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "CpuTopology.h"
+
+
+/* Versioned binary image of a CpuTopology.
+   Every link is an index and every array is an offset from the start of the file, so a mapped snapshot
+   is deserialized with bounds checks and no text parsing; derived data such as FlatTopology is rebuilt.
+   The header carries CpuTopology::fingerprint() so a file from another host is rejected. */
+
+/* Array inside the snapshot. */
+struct SnapshotArray {
+    /* Byte offset from the start of the snapshot. */
+    uint64_t offset = 0;
+    uint32_t count = 0;
+    /* sizeof the element type, checked when the array is read. */
+    uint32_t elementSize = 0;
+};
+
+/* Range of the indices array. */
+struct SnapshotList {
+    uint32_t offset = 0;
+    uint32_t count = 0;
+};
+
+enum class SnapshotSection : uint32_t {
+    /* SnapshotCore per core. */
+    cores,
+    /* SnapshotComplexGroup per complex group. */
+    complexGroups,
+    /* SnapshotNumaNode per NUMA node. */
+    numaNodes,
+    /* SnapshotSocket per socket. */
+    sockets,
+    /* SnapshotSocketProcessors of every socket. */
+    socketProcessors,
+    /* uint32_t pool behind every SnapshotList. */
+    indices,
+    /* SnapshotCache of every core. */
+    coreCaches,
+    /* SnapshotCache of CpuTopology::caches. */
+    systemCaches,
+    /* float, TopologyInfo::coreLatencies. */
+    coreLatencies,
+    /* uint32_t, TopologyInfo::numaDistances. */
+    numaDistances,
+    /* float, TopologyInfo::numaLatencies. */
+    numaLatencies,
+    /* float, TopologyInfo::numaReadBandwidths. */
+    numaReadBandwidths,
+    /* float, TopologyInfo::numaCopyBandwidths. */
+    numaCopyBandwidths,
+    /* SnapshotMemoryNode per memory node. */
+    memoryNodes,
+    /* SnapshotHugePages of every memory node. */
+    hugePages,
+    count,
+};
+
+struct SnapshotCache {
+    uint32_t type = 0;
+    uint32_t level = 0;
+    uint32_t associativity = 0;
+    uint32_t size = 0;
+    uint32_t line = 0;
+    uint32_t shared = 0;
+};
+
+struct SnapshotCore {
+    uint32_t id = 0;
+    uint32_t complexGroup = 0;
+    uint32_t numaNode = 0;
+    uint32_t socket = 0;
+    uint32_t sysNumaNode = 0;
+    uint32_t sysProcessorGroup = 0;
+    uint32_t efficiencyClass = 0;
+    uint32_t schedulingClass = 0;
+    uint32_t SMT = 0;
+    SnapshotList sysLogicalProcessors;
+    /* Range of the coreCaches array. */
+    SnapshotList caches;
+};
+
+struct SnapshotComplexGroup {
+    uint32_t id = 0;
+    uint32_t numaNode = 0;
+    uint32_t socket = 0;
+    uint32_t sysNumaNode = 0;
+    uint32_t sysProcessorGroup = 0;
+    SnapshotList sysLogicalProcessors;
+    SnapshotList cores;
+};
+
+struct SnapshotNumaNode {
+    uint32_t id = 0;
+    uint32_t sysNumaNode = 0;
+    uint32_t socket = 0;
+    uint32_t sysProcessorGroup = 0;
+    uint64_t availableMemory = 0;
+    SnapshotList sysLogicalProcessors;
+    SnapshotList cores;
+    SnapshotList complexGroups;
+};
+
+struct SnapshotHugePages {
+    uint64_t size = 0;
+    uint64_t total = 0;
+    uint64_t free = 0;
+};
+
+struct SnapshotMemoryNode {
+    uint32_t id = 0;
+    uint32_t sysNumaNode = 0;
+    uint32_t numaNode = 0;
+    uint32_t nearestNumaNode = 0;
+    uint32_t memoryTier = 0;
+    uint32_t readBandwidth = 0;
+    uint32_t writeBandwidth = 0;
+    uint32_t readLatency = 0;
+    uint32_t writeLatency = 0;
+    uint32_t reserved = 0;
+    uint64_t totalMemory = 0;
+    uint64_t availableMemory = 0;
+    SnapshotList initiators;
+    SnapshotList distances;
+    /* Range of the hugePages array. */
+    SnapshotList hugePages;
+};
+
+struct SnapshotSocketProcessors {
+    uint32_t sysProcessorGroup = 0;
+    SnapshotList sysLogicalProcessors;
+};
+
+struct SnapshotSocket {
+    uint32_t id = 0;
+    /* Range of the socketProcessors array. */
+    SnapshotList processorsStructs;
+    SnapshotList cores;
+    SnapshotList complexGroups;
+    SnapshotList numaNodes;
+    SnapshotList sysNumaNodes;
+};
+
+struct SnapshotHeader {
+    static constexpr uint32_t currentVersion = 3;
+
+    char magic[8] = { 'C', 'P', 'U', 'T', 'O', 'P', 'O', '\0' };
+    uint32_t version = currentVersion;
+    uint32_t headerSize = sizeof(SnapshotHeader);
+    uint64_t fingerprint = 0;
+    uint64_t fileSize = 0;
+
+    uint32_t sockets = 0;
+    uint32_t processorGroups = 0;
+    uint32_t numaNodes = 0;
+    uint32_t physicalCores = 0;
+    uint32_t logicalProcessors = 0;
+    uint32_t complexGroups = 0;
+    int32_t family = 0;
+    int32_t model = 0;
+    uint64_t systemMemory = 0;
+    char name[64] = {};
+    char vendor[16] = {};
+
+    SnapshotArray sections[static_cast<size_t>(SnapshotSection::count)];
+};
+
+
+/* Read-only mapping of a snapshot file. */
+class TopologySnapshot {
+public:
+    TopologySnapshot() = default;
+    ~TopologySnapshot() { close(); }
+
+    TopologySnapshot(const TopologySnapshot&) = delete;
+    TopologySnapshot& operator = (const TopologySnapshot&) = delete;
+
+    /* Map a snapshot, fails on a bad magic, version, size, section bound or section element size. */
+    bool open(const std::string& path);
+    void close();
+
+    bool valid() const { return data != nullptr; }
+    const SnapshotHeader& header() const { return *reinterpret_cast<const SnapshotHeader*>(data); }
+
+    /* Number of elements of a section. */
+    uint32_t count(SnapshotSection section) const {
+        return header().sections[static_cast<size_t>(section)].count;
+    }
+
+    /* First element of a section, nullptr if it is empty or its element type differs. */
+    template <typename T>
+    const T* array(SnapshotSection section) const {
+        const auto& entry = header().sections[static_cast<size_t>(section)];
+        return entry.count && entry.elementSize == sizeof(T) ? reinterpret_cast<const T*>(data + entry.offset) : nullptr;
+    }
+
+    /* First index of a list, the list is list.count long. nullptr if the indices section is empty,
+       the caller checks the list against count(SnapshotSection::indices). */
+    const uint32_t* list(const SnapshotList& list) const {
+        auto indices = array<uint32_t>(SnapshotSection::indices);
+        return indices ? indices + list.offset : nullptr;
+    }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+
+/* Write cpu as a snapshot, through a temporary file and a rename so readers never see a partial file. */
+bool saveSnapshot(const std::string& path, const CpuTopology& cpu);
+
+/* Rebuild cpu from a snapshot, TopologyInfo pointers included.
+   CpuSets and FlatTopology are derived data and left to the caller, so is rereading free memory and
+   free huge pages, which are restored as they were when the snapshot was saved. */
+bool loadSnapshot(const TopologySnapshot& snapshot, CpuTopology& cpu);
+
+/* Default snapshot file in CpuTopology::cacheDirectory(). */
+std::string snapshotCachePath(const CpuTopology& cpu);
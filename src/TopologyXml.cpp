@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "TopologyXml.h"
+
+
+using CacheInfo = CpuTopology::CacheInfo;
+using CoreInfo = CpuTopology::TopologyInfo::CoreInfo;
+using ComplexGroupInfo = CpuTopology::TopologyInfo::ComplexGroupInfo;
+using NumaNodeInfo = CpuTopology::TopologyInfo::NumaNodeInfo;
+using MemoryNodeInfo = CpuTopology::TopologyInfo::MemoryNodeInfo;
+
+
+constexpr uint32_t unknown = std::numeric_limits<uint32_t>::max();
+
+
+// Output position, hwloc numbers every object in write order.
+struct XmlState {
+    TextWriter& out;
+    uint64_t gpIndex = 1;
+    uint32_t depth = 0;
+};
+
+
+static void indent(XmlState& state) {
+    for (uint32_t i = 0; i < state.depth; ++i) {
+        state.out << "  ";
+    }
+}
+
+
+// Attribute value with XML special characters escaped, cpuid names are padded with NULs.
+static void writeEscaped(TextWriter& out, const std::string& value) {
+    for (auto c : value) {
+        if (c == '\0') {
+            break;
+        }
+        switch (c) {
+        case '&': out << "&amp;"; break;
+        case '<': out << "&lt;"; break;
+        case '>': out << "&gt;"; break;
+        case '"': out << "&quot;"; break;
+        default:
+            if (static_cast<unsigned char>(c) >= 0x20) {
+                out << c;
+            }
+        }
+    }
+}
+
+
+static void writeInfo(XmlState& state, const char* name, const std::string& value) {
+    indent(state);
+    state.out << "<info name=\"" << name << "\" value=\"";
+    writeEscaped(state.out, value);
+    state.out << "\"/>\n";
+}
+
+
+static CpuSet nodeSet(uint32_t sysNumaNode) {
+    CpuSet set;
+    if (sysNumaNode != unknown) {
+        set.set(sysNumaNode);
+    }
+    return set;
+}
+
+
+// "<object type=... cpuset=..." up to the attributes of the type, closed by endObject.
+static void beginObject(XmlState& state, const char* type, uint32_t osIndex, const CpuSet& cpuSet, const CpuSet& nodes) {
+    auto& out = state.out;
+    indent(state);
+    out << "<object type=\"" << type << '"';
+    if (osIndex != unknown) {
+        out << " os_index=\"" << osIndex << '"';
+    }
+    out << " cpuset=\"";
+    writeCpuMask(out, cpuSet);
+    out << "\" complete_cpuset=\"";
+    writeCpuMask(out, cpuSet);
+    out << "\" nodeset=\"";
+    writeCpuMask(out, nodes);
+    out << "\" complete_nodeset=\"";
+    writeCpuMask(out, nodes);
+    out << '"';
+}
+
+
+// Closes the start tag, an object with children stays open until closeObject.
+static void endObject(XmlState& state, bool children) {
+    state.out << " gp_index=\"" << state.gpIndex++ << (children ? "\">\n" : "\"/>\n");
+    if (children) {
+        ++state.depth;
+    }
+}
+
+
+static void closeObject(XmlState& state) {
+    --state.depth;
+    indent(state);
+    state.out << "</object>\n";
+}
+
+
+static void writeCacheAttributes(XmlState& state, const CacheInfo& cache) {
+    // hwloc cache types: 0 unified, 1 data, 2 instruction. Windows reports fully associative caches as 0xFF ways.
+    auto type = cache.type == CpuTopology::CacheType::instruction ? 2 : (cache.type == CpuTopology::CacheType::data ? 1 : 0);
+    state.out << " cache_size=\"" << (cache.size != unknown ? cache.size : 0)
+        << "\" depth=\"" << cache.level
+        << "\" cache_linesize=\"" << (cache.line != unknown ? cache.line : 0)
+        << "\" cache_associativity=\"";
+    if (cache.associativity == 0xFF) {
+        state.out << "-1";
+    }
+    else {
+        state.out << (cache.associativity != unknown ? cache.associativity : 0);
+    }
+    state.out << "\" cache_type=\"" << type << '"';
+}
+
+
+static void beginCache(XmlState& state, const CacheInfo& cache, const CpuSet& cpuSet, const CpuSet& nodes) {
+    auto type = "L" + std::to_string(cache.level) + (cache.type == CpuTopology::CacheType::instruction ? "iCache" : "Cache");
+    beginObject(state, type.c_str(), unknown, cpuSet, nodes);
+    writeCacheAttributes(state, cache);
+    endObject(state, true);
+}
+
+
+// A NUMA node with processors passes its memory node, a CPU-less one only the memory node.
+static void writeNumaNode(XmlState& state, uint32_t sysNumaNode, const CpuSet& cpuSet, uint64_t localMemory,
+    const MemoryNodeInfo* memoryNode) {
+    beginObject(state, "NUMANode", sysNumaNode, cpuSet, nodeSet(sysNumaNode));
+    state.out << " local_memory=\"" << localMemory << '"';
+    auto children = memoryNode && (!memoryNode->hugePages.empty() || memoryNode->memoryTier != unknown);
+    endObject(state, children);
+    if (children) {
+        for (const auto& hugePage : memoryNode->hugePages) {
+            indent(state);
+            state.out << "<page_type size=\"" << hugePage.size << "\" count=\"" << hugePage.total << "\"/>\n";
+        }
+        // hwloc 2.10 names the kernel tier MemoryTier as well.
+        if (memoryNode->memoryTier != unknown) {
+            writeInfo(state, "MemoryTier", std::to_string(memoryNode->memoryTier));
+        }
+        closeObject(state);
+    }
+}
+
+
+static void writeNumaNode(XmlState& state, const CpuTopology& cpu, const NumaNodeInfo& numaNode) {
+    writeNumaNode(state, numaNode.sysNumaNode, numaNode.cpuSet, numaNode.availableMemory,
+        cpu.Topology.memoryNode(numaNode.sysNumaNode));
+}
+
+
+static void writeCore(XmlState& state, const CoreInfo& core) {
+    auto nodes = nodeSet(core.sysNumaNode);
+
+    // Private caches from the outermost in, the instruction cache of a level below its data cache.
+    std::vector<const CacheInfo*> caches;
+    for (const auto& cache : core.caches) {
+        if (cache.level < 3) {
+            caches.push_back(&cache);
+        }
+    }
+    std::stable_sort(caches.begin(), caches.end(), [](const CacheInfo* a, const CacheInfo* b) {
+        auto aInstruction = a->type == CpuTopology::CacheType::instruction;
+        auto bInstruction = b->type == CpuTopology::CacheType::instruction;
+        return a->level != b->level ? a->level > b->level : aInstruction < bInstruction;
+    });
+    for (auto cache : caches) {
+        beginCache(state, *cache, core.cpuSet, nodes);
+    }
+
+    beginObject(state, "Core", core.id, core.cpuSet, nodes);
+    endObject(state, true);
+    for (auto processor : core.sysLogicalProcessors) {
+        CpuSet pu;
+        pu.set(CpuSet::index(core.sysProcessorGroup, processor));
+        beginObject(state, "PU", CpuSet::index(core.sysProcessorGroup, processor), pu, nodes);
+        endObject(state, false);
+    }
+    closeObject(state);
+
+    for (size_t i = 0; i < caches.size(); ++i) {
+        closeObject(state);
+    }
+}
+
+
+static void writeComplexGroup(XmlState& state, const ComplexGroupInfo& complexGroup) {
+    const CacheInfo* l3 = nullptr;
+    if (!complexGroup.cores.empty()) {
+        for (const auto& cache : complexGroup.cores.front()->caches) {
+            if (cache.level == 3) {
+                l3 = &cache;
+            }
+        }
+    }
+    auto nodes = nodeSet(complexGroup.sysNumaNode);
+    if (l3) {
+        beginCache(state, *l3, complexGroup.cpuSet, nodes);
+    }
+    else {
+        beginObject(state, "Group", unknown, complexGroup.cpuSet, nodes);
+        endObject(state, true);
+    }
+    for (auto core : complexGroup.cores) {
+        writeCore(state, *core);
+    }
+    closeObject(state);
+}
+
+
+// One line of a distances2 array, hwloc writes 10 values per element and their text length.
+template <typename T>
+static void writeValues(XmlState& state, const char* tag, const std::vector<T>& values) {
+    for (size_t first = 0; first < values.size(); first += 10) {
+        std::string text;
+        for (size_t i = first; i < std::min(first + 10, values.size()); ++i) {
+            text += std::to_string(values[i]);
+            text += ' ';
+        }
+        indent(state);
+        state.out << '<' << tag << " length=\"" << text.size() << "\">" << text << "</" << tag << ">\n";
+    }
+}
+
+
+void writeTopologyXml(TextWriter& out, const CpuTopology& cpu) {
+    const auto& Topology = cpu.Topology;
+    XmlState state{ out };
+
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<!DOCTYPE topology SYSTEM \"hwloc2.dtd\">\n"
+        << "<topology version=\"2.0\">\n";
+    ++state.depth;
+
+    CpuSet machineNodes;
+    for (const auto& numaNode : Topology.numaNodes) {
+        machineNodes |= nodeSet(numaNode.sysNumaNode);
+    }
+    for (const auto& memoryNode : Topology.memoryNodes) {
+        machineNodes |= nodeSet(memoryNode.sysNumaNode);
+    }
+    beginObject(state, "Machine", 0, Topology.cpuSet, machineNodes);
+    endObject(state, true);
+    writeInfo(state, "Backend", "cpu_topology");
+
+    // NUMA nodes no socket claims and memory without processors hang off the machine.
+    for (const auto& numaNode : Topology.numaNodes) {
+        if (!numaNode.socket) {
+            writeNumaNode(state, cpu, numaNode);
+        }
+    }
+    for (const auto& memoryNode : Topology.memoryNodes) {
+        if (!memoryNode.numaNode) {
+            writeNumaNode(state, memoryNode.sysNumaNode, CpuSet(), memoryNode.totalMemory, &memoryNode);
+        }
+    }
+
+    for (const auto& socket : Topology.sockets) {
+        CpuSet socketNodes;
+        for (auto sysNumaNode : socket.sysNumaNodes) {
+            socketNodes.set(sysNumaNode);
+        }
+        beginObject(state, "Package", socket.id, socket.cpuSet, socketNodes);
+        endObject(state, true);
+        writeInfo(state, "CPUVendor", cpu.vendor);
+        writeInfo(state, "CPUModel", cpu.name);
+        writeInfo(state, "CPUFamilyNumber", std::to_string(cpu.family));
+        writeInfo(state, "CPUModelNumber", std::to_string(cpu.model));
+
+        if (socket.numaNodes.size() == 1) {
+            writeNumaNode(state, cpu, *socket.numaNodes.front());
+        }
+        for (auto numaNode : socket.numaNodes) {
+            if (socket.numaNodes.size() > 1) {
+                beginObject(state, "Group", unknown, numaNode->cpuSet, nodeSet(numaNode->sysNumaNode));
+                endObject(state, true);
+                writeNumaNode(state, cpu, *numaNode);
+            }
+            for (auto complexGroup : socket.complexGroups) {
+                if (complexGroup->numaNode == numaNode) {
+                    writeComplexGroup(state, *complexGroup);
+                }
+            }
+            if (socket.numaNodes.size() > 1) {
+                closeObject(state);
+            }
+        }
+        for (auto complexGroup : socket.complexGroups) {
+            if (!complexGroup->numaNode) {
+                writeComplexGroup(state, *complexGroup);
+            }
+        }
+        closeObject(state);
+    }
+    closeObject(state);
+
+    if (!Topology.numaDistances.empty()) {
+        std::vector<uint32_t> indexes;
+        for (const auto& numaNode : Topology.numaNodes) {
+            indexes.push_back(numaNode.sysNumaNode);
+        }
+        // kind 5: from the OS, means latency.
+        indent(state);
+        out << "<distances2 type=\"NUMANode\" nbobjs=\"" << indexes.size()
+            << "\" kind=\"5\" name=\"NUMALatency\" indexing=\"os\">\n";
+        ++state.depth;
+        writeValues(state, "indexes", indexes);
+        writeValues(state, "u64values", Topology.numaDistances);
+        --state.depth;
+        indent(state);
+        out << "</distances2>\n";
+    }
+    out << "</topology>\n";
+}
+
+
+void writeTopologyXml(std::ostream& out, const CpuTopology& cpu) {
+    TextWriter writer(out);
+    writeTopologyXml(writer, cpu);
+}
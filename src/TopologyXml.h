@@ -0,0 +1,16 @@
+#pragma once
+
+
+#include <ostream>
+
+#include "CpuTopology.h"
+#include "TextWriter.h"
+
+
+/* Write cpu in the hwloc 2 XML format, readable by lstopo -i and hwloc_topology_set_xml().
+   Machine > Package > Group per NUMA node when a socket has several > L3Cache per complex group
+   > L2Cache > L1Cache > L1iCache > Core > PU, NUMA nodes as memory children with their huge page pools,
+   CPU-less memory nodes under Machine, the SLIT distances as NUMALatency.
+   Caches below L3 are written per core, PU and cpuset indices are CpuSet indices. */
+void writeTopologyXml(TextWriter& out, const CpuTopology& cpu);
+void writeTopologyXml(std::ostream& out, const CpuTopology& cpu);
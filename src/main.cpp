@@ -1,161 +1,397 @@
-#include <codecvt>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
 
+#include "CacheProbe.h"
 #include "CpuTopology.h"
+#include "CpuidTopology.h"
+#include "TextWriter.h"
+#include "TopologyJson.h"
+#include "TopologyQuery.h"
+#include "TopologyXml.h"
 
 
 // Print the CPU topology information
 //
-// out - std::wostream interface which can be a std:fstream or std::out
-void printCpuTopology(std::wostream& out) {
-    decltype(auto) cpu = CpuTopology::get();
-    std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
-
-    out << L"Sockets: " << cpu.sockets << std::endl
-        << L"Processor groups: " << cpu.processorGroups << std::endl
-        << L"NUMA nodes: " << cpu.numaNodes << std::endl
-        << L"Cores: " << cpu.physicalCores << std::endl
-        << L"Processors: " << cpu.logicalProcessors << std::endl
-        << L"Complex groups: " << cpu.complexGroups << std::endl;
+// out - narrow writer over a file or stream
+// cpu - topology to print
+void printCpuTopology(TextWriter& out, const CpuTopology& cpu) {
+    out << "Sockets: " << cpu.sockets << '\n'
+        << "Processor groups: " << cpu.processorGroups << '\n'
+        << "NUMA nodes: " << cpu.numaNodes << '\n'
+        << "Cores: " << cpu.physicalCores << '\n'
+        << "Processors: " << cpu.logicalProcessors << '\n'
+        << "Complex groups: " << cpu.complexGroups << '\n';
     for (auto i : cpu.complexGroupSizes) {
-        out << L"    Complex size: " << i << std::endl;
+        out << "    Complex size: " << i << '\n';
     }
 
-    out << L"CPU family: " << cpu.family << std::endl
-        << L"CPU model: " << cpu.model << std::endl
-        << L"CPU name: " << converter.from_bytes(cpu.name) << std::endl
-        << L"CPU vendor: " << converter.from_bytes(cpu.vendor) << std::endl
-        << L"System memory: " << cpu.systemMemory / 1024 << L" MB" << std::endl;
-    out << L"--------------------------------------------------" << std::endl;
+    decltype(auto) process = CpuTopology::process();
+    out << "Process processors: " << process.logicalProcessors << '\n'
+        << "Process cores: " << process.physicalCores << '\n'
+        << "Effective parallelism: " << process.effectiveParallelism() << '\n';
+
+    out << "CPU family: " << cpu.family << '\n'
+        << "CPU model: " << cpu.model << '\n'
+        << "CPU name: " << cpu.name.c_str() << '\n'
+        << "CPU vendor: " << cpu.vendor.c_str() << '\n'
+        << "System memory: " << cpu.systemMemory / 1024 << " MB" << '\n';
+    out << "ISA:";
+    for (uint32_t i = 0; i < static_cast<uint32_t>(IsaFeature::count); ++i) {
+        if (cpu.isa.has(static_cast<IsaFeature>(i))) {
+            out << " " << isaFeatureName(static_cast<IsaFeature>(i));
+        }
+    }
+    out << '\n';
+    out << "--------------------------------------------------" << '\n';
 
     for (const auto& i : cpu.caches) {
         char type = i.type == CpuTopology::CacheType::instruction ? 'I' : (i.type == CpuTopology::CacheType::data ? 'D' : 'U');
-        out << L"Cache L" << i.level << type << std::endl
-            << L"    Size: " << i.size / 1024 << L"KB" << std::endl
-            << L"    Line: " << i.line << L'B' << std::endl
-            << L"    Associativity: " << i.associativity << L" ways" << std::endl;
+        out << "Cache L" << i.level << type << '\n'
+            << "    Size: " << i.size / 1024 << "KB" << '\n'
+            << "    Line: " << i.line << 'B' << '\n'
+            << "    Associativity: " << i.associativity << " ways" << '\n';
     }
-    out << L"--------------------------------------------------" << std::endl;
+    out << "--------------------------------------------------" << '\n';
 
     for (const auto& i : cpu.Topology.cores) {
-        out << L"Core: " << i.id << std::endl
-            << L"    Complex: " << i.complexGroup->id << std::endl
-            << L"    NUMA: " << i.numaNode->id << std::endl
-            << L"    System NUMA: " << i.sysNumaNode << std::endl
-            << L"    System processor group: " << i.sysProcessorGroup << std::endl
-            << L"    Socket: " << i.socket->id << std::endl
-            << L"    SMT enabled: " << i.SMT << std::endl
-            << L"    Efficiency: " << i.efficiencyClass << std::endl
-            << L"    Scheduling: " << i.schedulingClass << std::endl
-            << L"    Logical processors: ";
+        out << "Core: " << i.id << '\n'
+            << "    Complex: " << i.complexGroup->id << '\n'
+            << "    NUMA: " << i.numaNode->id << '\n'
+            << "    System NUMA: " << i.sysNumaNode << '\n'
+            << "    System processor group: " << i.sysProcessorGroup << '\n'
+            << "    Socket: " << i.socket->id << '\n'
+            << "    SMT enabled: " << i.SMT << '\n'
+            << "    Efficiency: " << i.efficiencyClass << '\n'
+            << "    Scheduling: " << i.schedulingClass << '\n'
+            << "    Logical processors: ";
 
         for (auto j : i.sysLogicalProcessors) {
-            out << j << L' ';
+            out << j << ' ';
         }
-        out << std::endl;
+        out << '\n';
 
         for (const auto& j : i.caches) {
             char type = j.type == CpuTopology::CacheType::instruction ? 'I' : (j.type == CpuTopology::CacheType::data ? 'D' : 'U');
-            out << L"    Cache L" << j.level << type << std::endl
-                << L"        Size: " << j.size / 1024 << L"KB" << std::endl
-                << L"        Line: " << j.line << L'B' << std::endl
-                << L"        Associativity: " << j.associativity << L" ways" << std::endl
-                << L"        Shared by: " << j.shared << L" logical processors" << std::endl;
+            out << "    Cache L" << j.level << type << '\n'
+                << "        Size: " << j.size / 1024 << "KB" << '\n'
+                << "        Line: " << j.line << 'B' << '\n'
+                << "        Associativity: " << j.associativity << " ways" << '\n'
+                << "        Shared by: " << j.shared << " logical processors" << '\n';
         }
-        out << L"**************************************************" << std::endl;
+        out << "**************************************************" << '\n';
     }
-    out << L"--------------------------------------------------" << std::endl;
+    out << "--------------------------------------------------" << '\n';
 
     for (const auto& i : cpu.Topology.complexGroups) {
-        out << L"Complex: " << i.id << std::endl
-            << L"    NUMA: " << i.numaNode->id << std::endl
-            << L"    System NUMA: " << i.sysNumaNode << std::endl
-            << L"    System processor group: " << i.sysProcessorGroup << std::endl
-            << L"    Socket: " << i.socket->id << std::endl
-            << L"    Logical processors: ";
+        out << "Complex: " << i.id << '\n'
+            << "    NUMA: " << i.numaNode->id << '\n'
+            << "    System NUMA: " << i.sysNumaNode << '\n'
+            << "    System processor group: " << i.sysProcessorGroup << '\n'
+            << "    Socket: " << i.socket->id << '\n'
+            << "    Logical processors: ";
 
         for (auto j : i.sysLogicalProcessors) {
-            out << j << L' ';
+            out << j << ' ';
         }
-        out << std::endl;
+        out << '\n';
 
-        out << L"    Cores: ";
+        out << "    Cores: ";
 
         for (auto j : i.cores) {
-            out << j->id << L' ';
+            out << j->id << ' ';
         }
-        out << std::endl << L"**************************************************" << std::endl;
+        out << '\n' << "**************************************************" << '\n';
     }
-    out << L"--------------------------------------------------" << std::endl;
+    out << "--------------------------------------------------" << '\n';
 
     for (const auto& i : cpu.Topology.numaNodes) {
-        out << L"NUMA: " << i.id << std::endl
-            << L"    System NUMA: " << i.sysNumaNode << std::endl
-            << L"    System processor group: " << i.sysProcessorGroup << std::endl
-            << L"    Socket: " << i.socket->id << std::endl
-            << L"    Memory: " << i.availableMemory / 1024 / 1024 << L"MB" << std::endl
-            << L"    Logical processors: ";
+        out << "NUMA: " << i.id << '\n'
+            << "    System NUMA: " << i.sysNumaNode << '\n'
+            << "    System processor group: " << i.sysProcessorGroup << '\n'
+            << "    Socket: " << i.socket->id << '\n'
+            << "    Memory: " << i.availableMemory / 1024 / 1024 << "MB" << '\n';
+
+        if (!cpu.Topology.numaDistances.empty()) {
+            out << "    Distances: ";
+            for (uint32_t j = 0; j < cpu.numaNodes; ++j) {
+                out << cpu.Topology.numaDistance(i.id, j) << ' ';
+            }
+            out << '\n';
+        }
+
+        if (!cpu.Topology.numaLatencies.empty()) {
+            out << "    Memory latency (ns) / read (GB/s) / copy (GB/s): ";
+            for (uint32_t j = 0; j < cpu.numaNodes; ++j) {
+                auto k = i.id * cpu.numaNodes + j;
+                out << static_cast<uint32_t>(cpu.Topology.numaLatencies[k]) << '/'
+                    << static_cast<uint32_t>(cpu.Topology.numaReadBandwidths[k]) << '/'
+                    << static_cast<uint32_t>(cpu.Topology.numaCopyBandwidths[k]) << ' ';
+            }
+            out << '\n';
+        }
+
+        out << "    Logical processors: ";
 
         for (auto j : i.sysLogicalProcessors) {
-            out << j << L' ';
+            out << j << ' ';
         }
-        out << std::endl;
+        out << '\n';
 
-        out << L"    Cores: ";
+        out << "    Cores: ";
 
         for (auto j : i.cores) {
-            out << j->id << L' ';
+            out << j->id << ' ';
         }
-        out << std::endl;
+        out << '\n';
 
-        out << L"    Complex groups: ";
+        out << "    Complex groups: ";
         for (auto j : i.complexGroups) {
-            out << j->id << L' ';
+            out << j->id << ' ';
         }
-        out << std::endl << L"**************************************************" << std::endl;
+        out << '\n' << "**************************************************" << '\n';
     }
-    out << L"--------------------------------------------------" << std::endl;
+    out << "--------------------------------------------------" << '\n';
 
     for (const auto& i : cpu.Topology.sockets) {
-        out << L"Socket: " << i.id << std::endl;
+        out << "Socket: " << i.id << '\n';
 
         for (auto j : i.processorsStructs) {
-            out << L"    System processor group: " << j.sysProcessorGroup << std::endl;
-            out << L"        Logical processors: ";
+            out << "    System processor group: " << j.sysProcessorGroup << '\n';
+            out << "        Logical processors: ";
             for (auto k : j.sysLogicalProcessors) {
-                out << k << L' ';
+                out << k << ' ';
             }
-            out << std::endl;
+            out << '\n';
         }
 
-        out << L"    Cores: ";
+        out << "    Cores: ";
         for (auto j : i.cores) {
-            out << j->id << L' ';
+            out << j->id << ' ';
         }
-        out << std::endl;
+        out << '\n';
 
-        out << L"    Complex groups: ";
+        out << "    Complex groups: ";
         for (auto j : i.complexGroups) {
-            out << j->id << L' ';
+            out << j->id << ' ';
         }
-        out << std::endl;
+        out << '\n';
 
-        out << L"    NUMAs: ";
+        out << "    NUMAs: ";
         for (auto j : i.numaNodes) {
-            out << j->id << L' ';
+            out << j->id << ' ';
         }
-        out << std::endl;
+        out << '\n';
 
-        out << L"    System NUMAs: ";
+        out << "    System NUMAs: ";
         for (auto j : i.sysNumaNodes) {
-            out << j << L' ';
+            out << j << ' ';
+        }
+        out << '\n' << "**************************************************" << '\n';
+    }
+    out << "--------------------------------------------------" << '\n';
+
+    for (const auto& i : cpu.Topology.memoryNodes) {
+        out << "Memory node: " << i.id << '\n'
+            << "    System NUMA: " << i.sysNumaNode << '\n'
+            << "    NUMA: ";
+        if (i.numaNode) {
+            out << i.numaNode->id;
+        }
+        else {
+            out << "none";
+        }
+        out << '\n' << "    Nearest NUMA: ";
+        if (i.nearestNumaNode) {
+            out << i.nearestNumaNode->id;
+        }
+        else {
+            out << "none";
+        }
+        out << '\n' << "    Memory tier: ";
+        if (i.memoryTier != std::numeric_limits<uint32_t>::max()) {
+            out << i.memoryTier;
         }
-        out << std::endl << L"**************************************************" << std::endl;
+        else {
+            out << "unknown";
+        }
+        out << '\n'
+            << "    Memory: " << i.totalMemory / 1024 / 1024 << "MB, " << i.availableMemory / 1024 / 1024 << "MB free" << '\n';
+
+        if (i.readLatency || i.readBandwidth) {
+            out << "    HMAT read/write latency (ns): " << i.readLatency << '/' << i.writeLatency
+                << ", bandwidth (MB/s): " << i.readBandwidth << '/' << i.writeBandwidth << '\n';
+        }
+
+        if (!i.distances.empty()) {
+            out << "    Distances: ";
+            for (auto j : i.distances) {
+                out << j << ' ';
+            }
+            out << '\n';
+        }
+
+        for (const auto& j : i.hugePages) {
+            out << "    Huge pages " << j.size / 1024 << "KB: " << j.free << '/' << j.total << " free" << '\n';
+        }
+        out << "**************************************************" << '\n';
     }
-    out << L"--------------------------------------------------" << std::endl;
+    out << "--------------------------------------------------" << '\n';
+
+    if (!cpu.Topology.coreLatencies.empty()) {
+        out << "Core to core latency (ns):" << '\n';
+        for (uint32_t i = 0; i < cpu.physicalCores; ++i) {
+            out << "    Core " << i << ": ";
+            for (uint32_t j = 0; j < cpu.physicalCores; ++j) {
+                out << static_cast<uint32_t>(cpu.Topology.coreLatency(i, j)) << ' ';
+            }
+            out << '\n';
+        }
+        out << "--------------------------------------------------" << '\n';
+    }
+}
+
+static void printUsage() {
+    std::fputs(
+        "usage: main [text | json | xml] [--process]\n"
+        "       main cpulist | cpumask | cores | count <scope>... [--no-smt] [--process]\n"
+        "       main --cpuid | --caches\n"
+        "scope: machine, socket:N, numa:N, complex:N, core:N, pu:N, device:X, latency-critical, background\n",
+        stderr);
 }
 
-int main(int /*argc*/, char* /*argv[]*/) {
-    printCpuTopology(std::wcout);
+
+// Print the processors of the union of scopes as a cpulist, a mask, core ids or a count.
+static int query(const CpuTopology& cpu, const std::string& format, const std::vector<std::string>& scopes, bool noSmt) {
+    CpuSet set;
+    for (const auto& scope : scopes) {
+        CpuSet scopeSet;
+        if (!scopeCpuSet(cpu, scope, scopeSet)) {
+            std::fprintf(stderr, "unknown scope %s\n", scope.c_str());
+            return 2;
+        }
+        set |= scopeSet;
+    }
+    if (noSmt) {
+        set &= cpu.Topology.primaryProcessors;
+    }
+
+    TextWriter out(stdout);
+    if (format == "cpulist") {
+        writeCpuList(out, set);
+    }
+    else if (format == "cpumask") {
+        writeCpuMask(out, set);
+    }
+    else if (format == "cores") {
+        const char* separator = "";
+        for (auto core : coresOf(cpu, set)) {
+            out << separator << core;
+            separator = ",";
+        }
+    }
+    else {
+        out << set.count();
+    }
+    out << '\n';
+    return 0;
+}
+
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "text";
+    // Options come after the command, any other leading option belongs to the default text command.
+    auto firstOption = 2;
+    if (command[0] == '-' && command != "--json" && command != "--cpuid" && command != "--caches") {
+        command = "text";
+        firstOption = 1;
+    }
+    // --json is the old spelling of json.
+    if (command == "--json") {
+        command = "json";
+    }
+    // --cpuid lists where cpuid and the OS disagree on the processors of the process.
+    if (command == "--cpuid") {
+        const CpuidTopology cpuid;
+        const CpuTopology cpuidTopology(cpuid);
+        auto differences = crossCheckTopology(cpuidTopology, CpuTopology::process());
+        for (const auto& difference : differences) {
+            std::cout << difference << std::endl;
+        }
+        std::cout << cpuid.processors.size() << " processors read, " << differences.size() << " differences" << std::endl;
+        return differences.empty() ? 0 : 1;
+    }
+    // --caches probes the cache hierarchy of one core per complex group and efficiency class
+    // and lists where it disagrees with the reported caches.
+    if (command == "--caches") {
+        CpuTopology cpu(CpuTopology::get(), CpuTopology::processLimits());
+        size_t differenceCount = 0;
+        for (const auto& result : probeCoreCaches(cpu)) {
+            std::cout << "Core " << result.core << ", line " << result.line << " B" << std::endl;
+            for (size_t i = 0; i < result.levels.size(); ++i) {
+                const auto& level = result.levels[i];
+                std::cout << "    Level " << i + 1 << ": " << level.effectiveSize / 1024 << " KB, "
+                    << level.latency << " ns, " << level.bandwidth << " GB/s" << std::endl;
+            }
+            std::cout << "    Memory: " << result.memoryLatency << " ns, " << result.memoryBandwidth << " GB/s" << std::endl;
+            for (const auto& difference : checkCacheProbe(cpu, result)) {
+                std::cout << "    " << difference << std::endl;
+                ++differenceCount;
+            }
+        }
+        return differenceCount ? 1 : 0;
+    }
+
+    // The remaining commands only read the topology, the snapshot serves them without discovery.
+    // --process restricts them to the processors the process may run on, ids are those of that view.
+    bool process = false;
+    bool noSmt = false;
+    std::vector<std::string> scopes;
+    for (int i = firstOption; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--process") == 0) {
+            process = true;
+        }
+        else if (std::strcmp(argv[i], "--no-smt") == 0) {
+            noSmt = true;
+        }
+        else if (argv[i][0] == '-') {
+            printUsage();
+            return 2;
+        }
+        else {
+            scopes.push_back(argv[i]);
+        }
+    }
+    const auto& cpu = process ? CpuTopology::process() : CpuTopology::get();
+
+    if (command == "cpulist" || command == "cpumask" || command == "cores" || command == "count") {
+        if (scopes.empty()) {
+            printUsage();
+            return 2;
+        }
+        return query(cpu, command, scopes, noSmt);
+    }
+    if (!scopes.empty() || noSmt) {
+        printUsage();
+        return 2;
+    }
+    TextWriter out(stdout);
+    if (command == "json") {
+        writeTopologyJson(out, cpu);
+    }
+    else if (command == "xml") {
+        writeTopologyXml(out, cpu);
+    }
+    else if (command == "text") {
+        printCpuTopology(out, cpu);
+    }
+    else {
+        out.flush();
+        printUsage();
+        return 2;
+    }
     return 0;
 }